@@ -0,0 +1,56 @@
+#ifndef CAN_TIMING_H
+#define CAN_TIMING_H
+
+#include <stdint.h>
+
+//Bit timing for the bxCAN peripheral
+//A bit is 1 sync quantum + BS1 + BS2 time quanta, sampled at the end of BS1
+struct CAN_BitTiming {
+  uint32_t prescaler;    //1-1024
+  uint32_t bs1;          //1-16 time quanta
+  uint32_t bs2;          //1-8 time quanta
+  uint32_t sjw;          //1-4 time quanta
+  uint32_t samplePoint;  //Per mille of the bit time
+  bool valid;
+};
+
+//Sample points outside this range are rejected (per mille)
+#define CAN_SAMPLE_POINT_MIN 750
+#define CAN_SAMPLE_POINT_MAX 900
+
+//Find the prescaler and segments for a bit rate, given the CAN kernel clock
+//The bit rate must be met exactly. Among the valid settings, the one whose sample point
+//is closest to samplePoint wins, and then the one with the most time quanta per bit.
+//Usable at compile time, e.g. static_assert(CAN_CalcBitTiming(80000000, 500000).valid, "")
+constexpr CAN_BitTiming CAN_CalcBitTiming(uint32_t clockHz, uint32_t bitrate, uint32_t samplePoint=875) {
+  CAN_BitTiming best = {0, 0, 0, 0, 0, false};
+  uint32_t bestError = 0xffffffff;
+
+  for (uint32_t quanta = 25; quanta >= 8; quanta--) {
+    if (bitrate == 0 || clockHz % (bitrate * quanta) != 0)
+      continue;
+    uint32_t prescaler = clockHz / (bitrate * quanta);
+    if (prescaler < 1 || prescaler > 1024)
+      continue;
+
+    //Sync quantum + BS1, rounded to the nearest quantum
+    uint32_t beforeSample = (quanta * samplePoint + 500) / 1000;
+    uint32_t bs1 = beforeSample - 1;
+    uint32_t bs2 = quanta - beforeSample;
+    if (bs1 < 1 || bs1 > 16 || bs2 < 1 || bs2 > 8)
+      continue;
+
+    uint32_t actual = beforeSample * 1000 / quanta;
+    if (actual < CAN_SAMPLE_POINT_MIN || actual > CAN_SAMPLE_POINT_MAX)
+      continue;
+
+    uint32_t error = actual > samplePoint ? actual - samplePoint : samplePoint - actual;
+    if (error < bestError) {
+      bestError = error;
+      best = {prescaler, bs1, bs2, bs2 < 4 ? bs2 : 4, actual, true};
+    }
+  }
+  return best;
+}
+
+#endif
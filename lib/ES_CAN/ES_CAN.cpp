@@ -3,17 +3,48 @@
 #include <stm32l4xx_hal_rcc.h>
 #include <stm32l4xx_hal_gpio.h>
 #include <stm32l4xx_hal_cortex.h>
+#include "ES_CAN.h"
 
 //Overwrite the weak default IRQ Handlers and callabcks
 extern "C" void CAN1_RX0_IRQHandler(void);
+extern "C" void CAN1_RX1_IRQHandler(void);
 extern "C" void CAN1_TX_IRQHandler(void);
+extern "C" void CAN1_SCE_IRQHandler(void);
 
 //Pointer to user ISRS
 void (*CAN_RX_ISR)() = NULL;
+void (*CAN_RX1_ISR)() = NULL;
 void (*CAN_TX_ISR)() = NULL;
 
+//Software transmit queue for CAN_TX_Async()
+//txHead is only advanced with the TX interrupt masked, txTail only by CAN_TX_Async()
+struct CAN_TxFrame {
+  uint32_t ID;
+  uint8_t data[8];
+};
+static CAN_TxFrame txQueue[CAN_TX_QUEUE_SIZE];
+static volatile uint32_t txHead = 0;       //Next message to load into a mailbox
+static volatile uint32_t txTail = 0;       //Next free slot
+static volatile uint32_t txFullCount = 0;  //Messages rejected because the queue was full
+
+//ID of the message in each TX mailbox, and of the one whose completion is being handled
+static volatile uint32_t txMailboxID[3] = {0, 0, 0};
+static volatile uint32_t txCompletedID = 0;
+
+//Receive FIFO overruns, counted from the overrun interrupts. The controller only flags an
+//overrun, so each one lost at least one message but may have lost more.
+static volatile uint32_t rxOverrunCount[2] = {0, 0};
+
+//Traffic and error counts for bus monitoring
+static volatile uint32_t txFrameCount = 0;  //Transmissions completed
+static volatile uint32_t rxFrameCount = 0;  //Messages read from the FIFOs
+static volatile uint32_t busOffCount = 0;
+
+static_assert(CAN_CalcBitTiming(CAN_CLOCK_HZ, CAN_BITRATE).valid,
+              "CAN_BITRATE cannot be generated from CAN_CLOCK_HZ with a valid sample point");
+
 //CAN handle struct with initialisation parameters
-//Timing from http://www.bittiming.can-wiki.info/ with bit rate = 125kHz and clock frequency = 80MHz
+//Timing is the 125kHz default at 80MHz and is replaced by CAN_Init() for the requested bit rate
 CAN_HandleTypeDef CAN_Handle = {
     CAN1,
     {
@@ -23,7 +54,7 @@ CAN_HandleTypeDef CAN_Handle = {
         CAN_BS1_13TQ, //TimeSeg1
         CAN_BS2_2TQ,  //TimeSeg2
         DISABLE,      //TimeTriggeredMode
-        DISABLE,      //AutoBusOff
+        ENABLE,       //AutoBusOff: leave bus-off by itself after 128 x 11 recessive bits
         ENABLE,       //AutoWakeUp
         ENABLE,       //AutoRetransmission
         DISABLE,      //ReceiveFifoLocked
@@ -64,14 +95,36 @@ void HAL_CAN_MspInit(CAN_HandleTypeDef* CAN_Handle) {
 }
 
 
-uint32_t CAN_Init(bool loopback=false) {
+uint32_t CAN_Init(bool loopback, uint32_t bitrate) {
   if (loopback)
     CAN_Handle.Init.Mode = CAN_MODE_LOOPBACK;
-  return (uint32_t) HAL_CAN_Init(&CAN_Handle);
+
+  //Set the bit timing for the requested bit rate
+  CAN_BitTiming timing = CAN_CalcBitTiming(HAL_RCC_GetPCLK1Freq(), bitrate);
+  if (!timing.valid)
+    return (uint32_t) HAL_ERROR;
+  CAN_Handle.Init.Prescaler = timing.prescaler;
+  CAN_Handle.Init.SyncJumpWidth = (timing.sjw - 1) << CAN_BTR_SJW_Pos;
+  CAN_Handle.Init.TimeSeg1 = (timing.bs1 - 1) << CAN_BTR_TS1_Pos;
+  CAN_Handle.Init.TimeSeg2 = (timing.bs2 - 1) << CAN_BTR_TS2_Pos;
+
+  uint32_t status = (uint32_t) HAL_CAN_Init(&CAN_Handle);
+
+  //The TX interrupt refills the mailboxes from the software queue, with or without a user ISR
+  HAL_CAN_ActivateNotification (&CAN_Handle, CAN_IT_TX_MAILBOX_EMPTY);
+  HAL_NVIC_SetPriority (CAN1_TX_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ (CAN1_TX_IRQn);
+
+  //Count bus-off events; the hardware recovers on its own (AutoBusOff)
+  HAL_CAN_ActivateNotification (&CAN_Handle, CAN_IT_BUSOFF | CAN_IT_ERROR);
+  HAL_NVIC_SetPriority (CAN1_SCE_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ (CAN1_SCE_IRQn);
+
+  return status;
 }
 
 
-uint32_t setCANFilter(uint32_t filterID, uint32_t maskID, uint32_t filterBank) {
+uint32_t setCANFilter(uint32_t filterID, uint32_t maskID, uint32_t filterBank, uint32_t fifo) {
 
   //Set up the filter definition
   CAN_FilterTypeDef filterInfo = {
@@ -79,7 +132,7 @@ uint32_t setCANFilter(uint32_t filterID, uint32_t maskID, uint32_t filterBank) {
     0,                          //Filter ID LSBs = 0
     (maskID << 5) & 0xffe0,     //Mask MSBs
     0,                          //Mask LSBs = 0
-    0,                          //FIFO selection
+    fifo & 1,                   //FIFO selection
     filterBank & 0xf,           //Filter bank selection
     CAN_FILTERMODE_IDMASK,      //Mask mode
     CAN_FILTERSCALE_32BIT,      //32 bit IDs
@@ -96,7 +149,8 @@ uint32_t CAN_Start() {
 }
 
 
-uint32_t CAN_TX(uint32_t ID, uint8_t data[8]) {
+//Load a message into a free mailbox and start the transmission
+static uint32_t addTxMessage(uint32_t ID, uint8_t data[8]) {
 
   //Set up the message header
   CAN_TxHeaderTypeDef txHeader = {
@@ -108,30 +162,122 @@ uint32_t CAN_TX(uint32_t ID, uint8_t data[8]) {
     DISABLE                     //No time triggered mode
   };
 
+  uint32_t mailbox = 0;
+  uint32_t status = (uint32_t) HAL_CAN_AddTxMessage(&CAN_Handle, &txHeader, data, &mailbox);
+  if (mailbox)
+    txMailboxID[__builtin_ctz(mailbox)] = ID;
+  return status;
+}
+
+
+//Move queued messages into free mailboxes
+//Called from the TX interrupt and from CAN_TX_Async() with interrupts masked
+static void loadTxMailboxes() {
+  while (txHead != txTail && HAL_CAN_GetTxMailboxesFreeLevel(&CAN_Handle)) {
+    CAN_TxFrame &frame = txQueue[txHead % CAN_TX_QUEUE_SIZE];
+    addTxMessage(frame.ID, frame.data);
+    txHead = txHead + 1;
+  }
+}
+
+
+uint32_t CAN_TX(uint32_t ID, uint8_t data[8]) {
+
   //Wait for free mailbox
   while (!HAL_CAN_GetTxMailboxesFreeLevel(&CAN_Handle));
 
   //Start the transmission
-  return (uint32_t) HAL_CAN_AddTxMessage(&CAN_Handle, &txHeader, data, NULL);
+  return addTxMessage(ID, data);
+}
+
+
+uint32_t CAN_TX_Async(uint32_t ID, uint8_t data[8]) {
+  uint32_t tail = txTail;
+
+  if (tail - txHead >= CAN_TX_QUEUE_SIZE) {
+    txFullCount = txFullCount + 1;
+    return CAN_TX_FULL;
+  }
+
+  //Store the message, then publish it by advancing the tail
+  CAN_TxFrame &frame = txQueue[tail % CAN_TX_QUEUE_SIZE];
+  frame.ID = ID;
+  for (int i = 0; i < 8; i++)
+    frame.data[i] = data[i];
+  txTail = tail + 1;
+
+  //Start the transmission now if a mailbox is free, otherwise the TX interrupt will
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  loadTxMailboxes();
+  __set_PRIMASK(primask);
+
+  return CAN_TX_QUEUED;
+}
+
+
+uint32_t CAN_TX_QueueLevel() {
+  return txTail - txHead;
+}
+
+
+uint32_t CAN_TX_FullCount() {
+  return txFullCount;
+}
+
+
+uint32_t CAN_TX_CompletedID() {
+  return txCompletedID;
+}
+
+
+CAN_ErrorStatus CAN_GetErrorStatus() {
+  uint32_t esr = CAN_Handle.Instance->ESR;
+  CAN_ErrorStatus status = {
+    (uint8_t) ((esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos),
+    (uint8_t) ((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos),
+    (uint8_t) ((esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos),
+    (esr & CAN_ESR_EWGF) != 0,
+    (esr & CAN_ESR_EPVF) != 0,
+    (esr & CAN_ESR_BOFF) != 0
+  };
+  return status;
+}
+
+
+uint32_t CAN_BusOffCount() {
+  return busOffCount;
 }
 
 
-uint32_t CAN_CheckRXLevel() {
-  return HAL_CAN_GetRxFifoFillLevel(&CAN_Handle, 0);
+uint32_t CAN_TXFrameCount() {
+  return txFrameCount;
 }
 
 
-uint32_t CAN_RX(uint32_t &ID, uint8_t data[8]) {
+uint32_t CAN_RXFrameCount() {
+  return rxFrameCount;
+}
+
+
+uint32_t CAN_CheckRXLevel(uint32_t fifo) {
+  return HAL_CAN_GetRxFifoFillLevel(&CAN_Handle, fifo);
+}
+
+
+uint32_t CAN_RX(uint32_t &ID, uint8_t data[8], uint32_t fifo) {
   CAN_RxHeaderTypeDef rxHeader;
 
   //Wait for message in FIFO
-  while (!HAL_CAN_GetRxFifoFillLevel(&CAN_Handle, 0));
+  while (!HAL_CAN_GetRxFifoFillLevel(&CAN_Handle, fifo));
   
   //Get the message from the FIFO
-  uint32_t result = (uint32_t) HAL_CAN_GetRxMessage(&CAN_Handle, 0, &rxHeader, data);
+  uint32_t result = (uint32_t) HAL_CAN_GetRxMessage(&CAN_Handle, fifo, &rxHeader, data);
 
   //Store the ID from the header
   ID = rxHeader.StdId;
+  if (result == HAL_OK)
+    rxFrameCount = rxFrameCount + 1;
 
   return result;
 }
@@ -141,8 +287,8 @@ uint32_t CAN_RegisterRX_ISR(void(& callback)()) {
   //Store pointer to user ISR
   CAN_RX_ISR = &callback;
 
-  //Enable message received interrupt in HAL
-  uint32_t status = (uint32_t) HAL_CAN_ActivateNotification (&CAN_Handle, CAN_IT_RX_FIFO0_MSG_PENDING);
+  //Enable message received and overrun interrupts in HAL
+  uint32_t status = (uint32_t) HAL_CAN_ActivateNotification (&CAN_Handle, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO0_OVERRUN);
 
   //Switch on the interrupt
   HAL_NVIC_SetPriority (CAN1_RX0_IRQn, 6, 0);
@@ -152,6 +298,26 @@ uint32_t CAN_RegisterRX_ISR(void(& callback)()) {
 }
 
 
+uint32_t CAN_RegisterRX1_ISR(void(& callback)()) {
+  //Store pointer to user ISR
+  CAN_RX1_ISR = &callback;
+
+  //Enable message received and overrun interrupts in HAL
+  uint32_t status = (uint32_t) HAL_CAN_ActivateNotification (&CAN_Handle, CAN_IT_RX_FIFO1_MSG_PENDING | CAN_IT_RX_FIFO1_OVERRUN);
+
+  //Switch on the interrupt
+  HAL_NVIC_SetPriority (CAN1_RX1_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ (CAN1_RX1_IRQn);
+
+  return status;
+}
+
+
+uint32_t CAN_RXOverrunCount(uint32_t fifo) {
+  return rxOverrunCount[fifo & 1];
+}
+
+
 uint32_t CAN_RegisterTX_ISR(void(& callback)()) {
   //Store pointer to user ISR
   CAN_TX_ISR = &callback;
@@ -175,9 +341,35 @@ void HAL_CAN_RxFifo0MsgPendingCallback (CAN_HandleTypeDef * hcan){
 }
 
 
-void HAL_CAN_TxMailbox0CompleteCallback (CAN_HandleTypeDef * hcan){
+void HAL_CAN_RxFifo1MsgPendingCallback (CAN_HandleTypeDef * hcan){
 
   //Call the user ISR if it has been registered
+  if (CAN_RX1_ISR)
+    CAN_RX1_ISR();
+}
+
+
+void HAL_CAN_ErrorCallback (CAN_HandleTypeDef * hcan){
+
+  //Count bus-off events; AutoBusOff takes the module back on the bus
+  if (hcan->ErrorCode & HAL_CAN_ERROR_BOF)
+    busOffCount = busOffCount + 1;
+
+  //Count overruns; the HAL has already cleared the overrun flags
+  if (hcan->ErrorCode & HAL_CAN_ERROR_RX_FOV0)
+    rxOverrunCount[0] = rxOverrunCount[0] + 1;
+  if (hcan->ErrorCode & HAL_CAN_ERROR_RX_FOV1)
+    rxOverrunCount[1] = rxOverrunCount[1] + 1;
+
+  HAL_CAN_ResetError(hcan);
+}
+
+
+void HAL_CAN_TxMailbox0CompleteCallback (CAN_HandleTypeDef * hcan){
+
+  //Call the user ISR if it has been registered, telling it which message has gone
+  txCompletedID = txMailboxID[0];
+  txFrameCount = txFrameCount + 1;
   if (CAN_TX_ISR)
     CAN_TX_ISR();
 }
@@ -185,7 +377,9 @@ void HAL_CAN_TxMailbox0CompleteCallback (CAN_HandleTypeDef * hcan){
 
 void HAL_CAN_TxMailbox1CompleteCallback (CAN_HandleTypeDef * hcan){
 
-  //Call the user ISR if it has been registered
+  //Call the user ISR if it has been registered, telling it which message has gone
+  txCompletedID = txMailboxID[1];
+  txFrameCount = txFrameCount + 1;
   if (CAN_TX_ISR)
     CAN_TX_ISR();
 }
@@ -193,7 +387,9 @@ void HAL_CAN_TxMailbox1CompleteCallback (CAN_HandleTypeDef * hcan){
 
 void HAL_CAN_TxMailbox2CompleteCallback (CAN_HandleTypeDef * hcan){
 
-  //Call the user ISR if it has been registered
+  //Call the user ISR if it has been registered, telling it which message has gone
+  txCompletedID = txMailboxID[2];
+  txFrameCount = txFrameCount + 1;
   if (CAN_TX_ISR)
     CAN_TX_ISR();
 }
@@ -207,9 +403,28 @@ void CAN1_RX0_IRQHandler(void){
 }
 
 
+//This is the base ISR at the interrupt vector
+void CAN1_RX1_IRQHandler(void){
+
+  //Use the HAL interrupt handler
+  HAL_CAN_IRQHandler(&CAN_Handle);
+}
+
+
+//This is the base ISR at the interrupt vector
+void CAN1_SCE_IRQHandler(void){
+
+  //Use the HAL interrupt handler
+  HAL_CAN_IRQHandler(&CAN_Handle);
+}
+
+
 //This is the base ISR at the interrupt vector
 void CAN1_TX_IRQHandler(void){
 
   //Use the HAL interrupt handler
   HAL_CAN_IRQHandler(&CAN_Handle);
+
+  //Refill the mailboxes that have just been freed
+  loadTxMailboxes();
 }
@@ -1,26 +1,91 @@
 #include <stm32l4xx_hal_cortex.h>
+#include "CAN_Timing.h"
+
+//CAN kernel clock (PCLK1) assumed for compile-time timing checks
+#ifndef CAN_CLOCK_HZ
+#define CAN_CLOCK_HZ 80000000
+#endif
+
+//Default bit rate for builds without -DCAN_BITRATE=...; the synth sets it in platformio.ini
+#ifndef CAN_BITRATE
+#define CAN_BITRATE 125000
+#endif
 
 //Initialise the CAN module
-uint32_t CAN_Init(bool loopback=false);
+//The bit timing is calculated from the actual PCLK1 frequency; returns HAL_ERROR if the
+//bit rate cannot be met exactly with a valid sample point
+uint32_t CAN_Init(bool loopback=false, uint32_t bitrate=CAN_BITRATE);
 
 //Enable the CAN module
 uint32_t CAN_Start();
 
 //Set up a recevie filter
-//Defaults to receive everything
-uint32_t setCANFilter(uint32_t filterID=0, uint32_t maskID=0, uint32_t filterBank=0);
+//Defaults to receive everything into FIFO 0
+uint32_t setCANFilter(uint32_t filterID=0, uint32_t maskID=0, uint32_t filterBank=0, uint32_t fifo=0);
 
 //Send a message
+//Waits for a free mailbox, so do not mix with CAN_TX_Async() if order matters
 uint32_t CAN_TX(uint32_t ID, uint8_t data[8]);
 
-//Get the number of received messages
-uint32_t CAN_CheckRXLevel();
+//Size of the software transmit queue used by CAN_TX_Async()
+#ifndef CAN_TX_QUEUE_SIZE
+#define CAN_TX_QUEUE_SIZE 32
+#endif
+
+//Results of CAN_TX_Async()
+#define CAN_TX_QUEUED 0  //Message accepted
+#define CAN_TX_FULL   1  //Queue full, try again after a transmission completes
+
+//Queue a message without waiting
+//Queued messages are loaded into free mailboxes from the TX interrupt, in order
+//Only one task may call this
+uint32_t CAN_TX_Async(uint32_t ID, uint8_t data[8]);
+
+//Get the number of messages waiting in the software transmit queue
+uint32_t CAN_TX_QueueLevel();
+
+//Get the number of messages rejected with CAN_TX_FULL
+uint32_t CAN_TX_FullCount();
+
+//Get the ID of the message that has just been sent
+//Only valid inside the TX ISR, e.g. to timestamp a particular message
+uint32_t CAN_TX_CompletedID();
 
-//Get a received message from the FIFO
-uint32_t CAN_RX(uint32_t &ID, uint8_t data[8]);
+//Get the number of received messages in a FIFO
+uint32_t CAN_CheckRXLevel(uint32_t fifo=0);
 
-//Set up an interrupt on received messages
+//Get a received message from a FIFO
+//Waits for a message, so check CAN_CheckRXLevel() first in an ISR
+uint32_t CAN_RX(uint32_t &ID, uint8_t data[8], uint32_t fifo=0);
+
+//Error state of the CAN module, from the error status register
+struct CAN_ErrorStatus {
+  uint8_t tec;        //Transmit error counter
+  uint8_t rec;        //Receive error counter
+  uint8_t lastError;  //Last error code: 0 none, 1 stuff, 2 form, 3 ack, 4 bit recessive, 5 bit dominant, 6 CRC
+  bool warning;       //A counter has reached 96
+  bool passive;       //A counter is above 127: errors are only signalled passively
+  bool busOff;        //TEC went above 255; the module rejoins the bus by itself
+};
+
+//Sample the error counters and state
+CAN_ErrorStatus CAN_GetErrorStatus();
+
+//Get the number of times the module has gone bus-off
+uint32_t CAN_BusOffCount();
+
+//Get the number of messages transmitted and received since CAN_Init()
+uint32_t CAN_TXFrameCount();
+uint32_t CAN_RXFrameCount();
+
+//Set up an interrupt on received messages in FIFO 0
 uint32_t CAN_RegisterRX_ISR(void(& callback)());
 
+//Set up an interrupt on received messages in FIFO 1
+uint32_t CAN_RegisterRX1_ISR(void(& callback)());
+
+//Get the number of times a FIFO overran; each lost at least one message
+uint32_t CAN_RXOverrunCount(uint32_t fifo);
+
 //Set up an interrupt on transmitted messages
 uint32_t CAN_RegisterTX_ISR(void(& callback)());
\ No newline at end of file
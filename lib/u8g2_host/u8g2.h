@@ -0,0 +1,61 @@
+#ifndef U8G2_H
+#define U8G2_H
+
+#include <stdint.h>
+
+// Host stand-in for the part of the U8g2 C API that src/widgets.cpp draws with, for the
+// native tests. It renders into a 128x32 frame in the U8g2 full-buffer layout (tile row y
+// starts at byte y * 128, one byte per column with the top pixel in bit 0), the same
+// frame TileDiff works on, so widgets can be compared with golden images on a PC.
+//
+// Clip windows, draw colours and the return value of u8g2_DrawStr() behave as in U8g2.
+// The target's fonts are not available here: text is drawn with u8g2_font_host_3x5.
+
+#define U8G2_HOST_WIDTH 128
+#define U8G2_HOST_HEIGHT 32
+
+typedef uint8_t u8g2_uint_t;
+
+typedef struct u8g2_struct {
+    uint8_t buffer[U8G2_HOST_WIDTH * U8G2_HOST_HEIGHT / 8];
+    uint8_t drawColor;      // 0 clears, 1 sets, 2 inverts
+    u8g2_uint_t clipX0;     // Pixels are drawn in [clipX0, clipX1) x [clipY0, clipY1)
+    u8g2_uint_t clipY0;
+    u8g2_uint_t clipX1;
+    u8g2_uint_t clipY1;
+    const uint8_t* font;
+} u8g2_t;
+
+// 3x5 capitals, digits and punctuation from ' ' to '_'. Lower-case letters are drawn with
+// the capitals and anything else as a filled box. The format is {glyph width, glyph height,
+// first char, last char}, then one byte per glyph row with the leftmost pixel in bit
+// (width - 1). The glyph height is the ascent; each glyph advances width + 1 pixels.
+extern const uint8_t u8g2_font_host_3x5[];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Clear the frame, draw colour 1, no clipping, host font
+void u8g2_SetupHost(u8g2_t* u8g2);
+uint8_t* u8g2_GetBufferPtr(u8g2_t* u8g2);
+void u8g2_ClearBuffer(u8g2_t* u8g2);
+
+void u8g2_SetDrawColor(u8g2_t* u8g2, uint8_t color);
+void u8g2_SetClipWindow(u8g2_t* u8g2, u8g2_uint_t x0, u8g2_uint_t y0, u8g2_uint_t x1, u8g2_uint_t y1);
+void u8g2_SetMaxClipWindow(u8g2_t* u8g2);
+
+void u8g2_DrawPixel(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y);
+void u8g2_DrawBox(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h);
+void u8g2_DrawFrame(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h);
+
+void u8g2_SetFont(u8g2_t* u8g2, const uint8_t* font);
+int8_t u8g2_GetAscent(u8g2_t* u8g2);
+// Draw with the baseline at y; returns the advance in pixels
+u8g2_uint_t u8g2_DrawStr(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y, const char* str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // U8G2_H
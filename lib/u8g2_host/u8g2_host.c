@@ -0,0 +1,128 @@
+#include "u8g2.h"
+#include <string.h>
+
+const uint8_t u8g2_font_host_3x5[] = {
+    3, 5, ' ', '_',
+    0x0, 0x0, 0x0, 0x0, 0x0, 0x2, 0x2, 0x2, 0x0, 0x2, 0x5, 0x5, 0x0, 0x0, 0x0, 0x5, 0x7, 0x5, 0x7, 0x5,  // ' ' '!' '"' '#'
+    0x3, 0x6, 0x2, 0x3, 0x6, 0x5, 0x1, 0x2, 0x4, 0x5, 0x2, 0x5, 0x2, 0x5, 0x3, 0x2, 0x2, 0x0, 0x0, 0x0,  // '$' '%' '&' '''
+    0x1, 0x2, 0x2, 0x2, 0x1, 0x4, 0x2, 0x2, 0x2, 0x4, 0x0, 0x5, 0x2, 0x5, 0x0, 0x0, 0x2, 0x7, 0x2, 0x0,  // '(' ')' '*' '+'
+    0x0, 0x0, 0x0, 0x2, 0x4, 0x0, 0x0, 0x7, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x2, 0x1, 0x1, 0x2, 0x4, 0x4,  // ',' '-' '.' '/'
+    0x7, 0x5, 0x5, 0x5, 0x7, 0x2, 0x6, 0x2, 0x2, 0x7, 0x7, 0x1, 0x7, 0x4, 0x7, 0x7, 0x1, 0x3, 0x1, 0x7,  // '0' '1' '2' '3'
+    0x5, 0x5, 0x7, 0x1, 0x1, 0x7, 0x4, 0x7, 0x1, 0x7, 0x7, 0x4, 0x7, 0x5, 0x7, 0x7, 0x1, 0x1, 0x1, 0x1,  // '4' '5' '6' '7'
+    0x7, 0x5, 0x7, 0x5, 0x7, 0x7, 0x5, 0x7, 0x1, 0x7, 0x0, 0x2, 0x0, 0x2, 0x0, 0x0, 0x2, 0x0, 0x2, 0x4,  // '8' '9' ':' ';'
+    0x1, 0x2, 0x4, 0x2, 0x1, 0x0, 0x7, 0x0, 0x7, 0x0, 0x4, 0x2, 0x1, 0x2, 0x4, 0x7, 0x1, 0x3, 0x0, 0x2,  // '<' '=' '>' '?'
+    0x7, 0x5, 0x7, 0x4, 0x7, 0x2, 0x5, 0x7, 0x5, 0x5, 0x6, 0x5, 0x6, 0x5, 0x6, 0x3, 0x4, 0x4, 0x4, 0x3,  // '@' 'A' 'B' 'C'
+    0x6, 0x5, 0x5, 0x5, 0x6, 0x7, 0x4, 0x6, 0x4, 0x7, 0x7, 0x4, 0x6, 0x4, 0x4, 0x3, 0x4, 0x5, 0x5, 0x3,  // 'D' 'E' 'F' 'G'
+    0x5, 0x5, 0x7, 0x5, 0x5, 0x7, 0x2, 0x2, 0x2, 0x7, 0x1, 0x1, 0x1, 0x5, 0x2, 0x5, 0x5, 0x6, 0x5, 0x5,  // 'H' 'I' 'J' 'K'
+    0x4, 0x4, 0x4, 0x4, 0x7, 0x5, 0x7, 0x7, 0x5, 0x5, 0x6, 0x5, 0x5, 0x5, 0x5, 0x2, 0x5, 0x5, 0x5, 0x2,  // 'L' 'M' 'N' 'O'
+    0x6, 0x5, 0x6, 0x4, 0x4, 0x2, 0x5, 0x5, 0x6, 0x3, 0x6, 0x5, 0x6, 0x5, 0x5, 0x3, 0x4, 0x2, 0x1, 0x6,  // 'P' 'Q' 'R' 'S'
+    0x7, 0x2, 0x2, 0x2, 0x2, 0x5, 0x5, 0x5, 0x5, 0x7, 0x5, 0x5, 0x5, 0x5, 0x2, 0x5, 0x5, 0x7, 0x7, 0x5,  // 'T' 'U' 'V' 'W'
+    0x5, 0x5, 0x2, 0x5, 0x5, 0x5, 0x5, 0x2, 0x2, 0x2, 0x7, 0x1, 0x2, 0x4, 0x7, 0x6, 0x4, 0x4, 0x4, 0x6,  // 'X' 'Y' 'Z' '['
+    0x4, 0x4, 0x2, 0x1, 0x1, 0x3, 0x1, 0x1, 0x1, 0x3, 0x2, 0x5, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x7,  // '\\' ']' '^' '_'
+};
+
+void u8g2_SetupHost(u8g2_t* u8g2) {
+    u8g2_ClearBuffer(u8g2);
+    u8g2->drawColor = 1;
+    u8g2->font = u8g2_font_host_3x5;
+    u8g2_SetMaxClipWindow(u8g2);
+}
+
+uint8_t* u8g2_GetBufferPtr(u8g2_t* u8g2) {
+    return u8g2->buffer;
+}
+
+void u8g2_ClearBuffer(u8g2_t* u8g2) {
+    memset(u8g2->buffer, 0, sizeof(u8g2->buffer));
+}
+
+void u8g2_SetDrawColor(u8g2_t* u8g2, uint8_t color) {
+    u8g2->drawColor = color;
+}
+
+void u8g2_SetClipWindow(u8g2_t* u8g2, u8g2_uint_t x0, u8g2_uint_t y0, u8g2_uint_t x1, u8g2_uint_t y1) {
+    u8g2->clipX0 = x0;
+    u8g2->clipY0 = y0;
+    u8g2->clipX1 = x1;
+    u8g2->clipY1 = y1;
+}
+
+void u8g2_SetMaxClipWindow(u8g2_t* u8g2) {
+    u8g2_SetClipWindow(u8g2, 0, 0, U8G2_HOST_WIDTH, U8G2_HOST_HEIGHT);
+}
+
+void u8g2_DrawPixel(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y) {
+    if (x < u8g2->clipX0 || x >= u8g2->clipX1 || y < u8g2->clipY0 || y >= u8g2->clipY1 ||
+        x >= U8G2_HOST_WIDTH || y >= U8G2_HOST_HEIGHT) {
+        return;
+    }
+    uint8_t* byte = &u8g2->buffer[(y / 8) * U8G2_HOST_WIDTH + x];
+    uint8_t bit = 1 << (y & 7);
+    if (u8g2->drawColor == 0) {
+        *byte &= ~bit;
+    } else if (u8g2->drawColor == 1) {
+        *byte |= bit;
+    } else {
+        *byte ^= bit;
+    }
+}
+
+void u8g2_DrawBox(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h) {
+    for (unsigned i = 0; i < w; i++) {
+        for (unsigned j = 0; j < h; j++) {
+            u8g2_DrawPixel(u8g2, x + i, y + j);
+        }
+    }
+}
+
+void u8g2_DrawFrame(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y, u8g2_uint_t w, u8g2_uint_t h) {
+    if (w == 0 || h == 0) {
+        return;
+    }
+    for (unsigned i = 0; i < w; i++) {
+        u8g2_DrawPixel(u8g2, x + i, y);
+        if (h > 1) u8g2_DrawPixel(u8g2, x + i, y + h - 1);
+    }
+    for (unsigned j = 1; j + 1 < h; j++) {
+        u8g2_DrawPixel(u8g2, x, y + j);
+        if (w > 1) u8g2_DrawPixel(u8g2, x + w - 1, y + j);
+    }
+}
+
+void u8g2_SetFont(u8g2_t* u8g2, const uint8_t* font) {
+    u8g2->font = font;
+}
+
+int8_t u8g2_GetAscent(u8g2_t* u8g2) {
+    return u8g2->font[1];
+}
+
+// Glyph rows for `c`, or NULL for a character the font does not have
+static const uint8_t* glyph(const uint8_t* font, char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = c - 'a' + 'A';
+    }
+    if ((uint8_t)c < font[2] || (uint8_t)c > font[3]) {
+        return NULL;
+    }
+    return font + 4 + ((uint8_t)c - font[2]) * font[1];
+}
+
+u8g2_uint_t u8g2_DrawStr(u8g2_t* u8g2, u8g2_uint_t x, u8g2_uint_t y, const char* str) {
+    const uint8_t* font = u8g2->font;
+    uint8_t width = font[0];
+    uint8_t height = font[1];
+    u8g2_uint_t start = x;
+    for (; *str; str++) {
+        const uint8_t* rows = glyph(font, *str);
+        for (uint8_t j = 0; j < height; j++) {
+            for (uint8_t i = 0; i < width; i++) {
+                if (!rows || (rows[j] >> (width - 1 - i)) & 1) {
+                    u8g2_DrawPixel(u8g2, x + i, y - height + j);
+                }
+            }
+        }
+        x += width + 1;
+    }
+    return x - start;
+}
@@ -1,38 +1,96 @@
 #include "audio.hpp"
 #include "system.hpp"
 #include "pindef.hpp"
-#include "system.hpp"
+#include "voice.hpp"
+#include "params.hpp"
+#include "joystick.hpp"
+#include "rtos_alloc.hpp"
 #include <Arduino.h>
 
 volatile uint32_t currentStepSize = 0;
-std::array<uint32_t, 12> stepSizes = getArray();
+
+// Double buffer: the ISR reads one half while audioRenderTask writes the other
+static uint8_t sampleBuffer0[AUDIO_BLOCK];
+static uint8_t sampleBuffer1[AUDIO_BLOCK];
+static volatile bool writeBuffer1 = false;
+static SemaphoreHandle_t sampleBufferSemaphore;
+static SemaphoreStorage sampleBufferSemaphoreStorage;
+static uint32_t renderSeq = 0;  // Odd while a block is being rendered
+static bool lastRenderedBuffer1 = false;
 
 std::array<uint32_t, 12> getArray() {
     std::array<uint32_t, 12> result = {0};
-    xSemaphoreTake(sysMutex, portMAX_DELAY);
-    int cur_octave = globalRXMessage[1] != 0 ? globalRXMessage[1] : 4;
-    xSemaphoreGive(sysMutex);
+    int cur_octave = params.get(PARAM_OCTAVE);
     double freq_factor = pow(2, 1.0/12.0);
     
     for (size_t i = 0; i < 12; i++) {
         double freq = (i >= 9) ? 440 * pow(freq_factor, i - 9) : 440 / pow(freq_factor, 9 - i);
-        result[i] = ((1 << (cur_octave - 4)) * (pow(2, 32) * freq)) / 22000;
+        result[i] = (pow(2, cur_octave - 4) * (pow(2, 32) * freq)) / SAMPLE_RATE;
     }
     return result;
 }
 
+void initAudio() {
+    memset(sampleBuffer0, 128, AUDIO_BLOCK);
+    memset(sampleBuffer1, 128, AUDIO_BLOCK);
+    analogWrite(OUTR_PIN, 128);  // The first call sets up the output, before the heap is locked
+    voiceInit();
+    sampleBufferSemaphore = sampleBufferSemaphoreStorage.createBinary();
+    xSemaphoreGive(sampleBufferSemaphore);  // Render the first block straight away
+}
+
+// Copy one sample to the output and swap buffer halves at the end of each block.
 void sampleISR() {
-    // Serial.print("sample ISR is running");
-    static uint32_t phaseAcc = 0;
-    uint32_t stepSize = __atomic_load_n(&currentStepSize, __ATOMIC_RELAXED);
-    phaseAcc += stepSize;
-    int32_t Vout = (phaseAcc >> 24) - 128;
-
-    // Get knob rotation atomically for volume control.
-    int knobRot = __atomic_load_n(&sysState.knob3Rotation, __ATOMIC_RELAXED);
-    knobRot = constrain(knobRot, 0, 8);
-    // Apply volume control using right shift.
-    Vout = Vout >> (8 - knobRot);
-
-    analogWrite(OUTR_PIN, Vout + 128);
-}
\ No newline at end of file
+    static uint32_t readCtr = 0;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (readCtr == AUDIO_BLOCK) {
+        readCtr = 0;
+        writeBuffer1 = !writeBuffer1;
+        xSemaphoreGiveFromISR(sampleBufferSemaphore, &xHigherPriorityTaskWoken);
+    }
+
+    if (writeBuffer1)
+        analogWrite(OUTR_PIN, sampleBuffer0[readCtr++]);
+    else
+        analogWrite(OUTR_PIN, sampleBuffer1[readCtr++]);
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+// Render one block per buffer swap. Parameters and the joystick are read once per block without locks.
+void audioRenderTask(void *pvParameters) {
+    ParamSnapshot snapshot;
+    params.snapshot(snapshot);
+
+    while (1) {
+        xSemaphoreTake(sampleBufferSemaphore, portMAX_DELAY);
+        params.trySnapshot(snapshot);  // Keeps the last block's values if a write is in progress
+        voiceProcessEvents();
+        JoystickState joystick = readJoystick();  // Latest DMA samples, no conversion wait
+        bool target1 = writeBuffer1;
+        __atomic_fetch_add(&renderSeq, 1, __ATOMIC_ACQ_REL);
+        voiceRender(target1 ? sampleBuffer1 : sampleBuffer0, AUDIO_BLOCK, snapshot, joystick);
+        lastRenderedBuffer1 = target1;
+        __atomic_fetch_add(&renderSeq, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Same idea as the parameter seqlock: the copy is only kept if no render started meanwhile.
+// The other half was rendered one block earlier.
+bool copyScopeSamples(uint8_t* out) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        uint32_t seq = __atomic_load_n(&renderSeq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+        bool newerIsBuffer1 = lastRenderedBuffer1;
+        memcpy(out, newerIsBuffer1 ? sampleBuffer0 : sampleBuffer1, AUDIO_BLOCK);
+        memcpy(out + AUDIO_BLOCK, newerIsBuffer1 ? sampleBuffer1 : sampleBuffer0, AUDIO_BLOCK);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&renderSeq, __ATOMIC_RELAXED) == seq) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -3,10 +3,19 @@
 
 #include <Arduino.h>
 
+#define SAMPLE_RATE 22000
+#define AUDIO_BLOCK 64  // Samples per render block, half of the double buffer
+#define SCOPE_SAMPLES (2 * AUDIO_BLOCK)  // Both halves of the double buffer
+
 extern volatile uint32_t currentStepSize;
-extern std::array<uint32_t, 12> stepSizes;
 
-std::array<uint32_t, 12> getArray();
+std::array<uint32_t, 12> getArray();  // Step sizes of the 12 notes in the local octave
+void initAudio();
 void sampleISR();
+void audioRenderTask(void *pvParameters);
+
+// Copy the last SCOPE_SAMPLES rendered samples, oldest first, without blocking the
+// render task. Returns false if it kept rendering over them on every attempt.
+bool copyScopeSamples(uint8_t* out);
 
 #endif // AUDIO_HPP
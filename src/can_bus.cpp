@@ -2,67 +2,136 @@
 #include "system.hpp"
 #include "audio.hpp"
 #include "config.hpp"
+#include "keys.hpp"
+#include "trace.hpp"
+#include "can_protocol.hpp"
+#include "params.hpp"
+#include "voice_alloc.hpp"
+#include "clock_sync.hpp"
 #include <ES_CAN.h>
 #include <Arduino.h>
 
-int counter = 0;
-float accumulator = 0;
+EventRing<KeyEvent, 64, 1> remoteKeyEvents;
+EventRing<HandshakeMessage, 8, 1> handshakeInbox;
+uint16_t departedModules = 0;
+EventRing<VoiceAssignment, 16, 1> voiceAssignments;
+EventRing<VoiceAssignment, 16, 1> localVoiceAssignments;
+VoiceAllocator voiceAllocator;
+ClockSync clockSync;
+static KeyStateTracker remoteKeys;
 
+// Timing is recorded with trace() (src/trace.hpp) rather than printed, so the
+// measurement does not add serial output to the interrupt or task being measured.
 
-// CAN RX ISR: Reads incoming CAN message and enqueues it.
-void CAN_RX_ISR(void) {
-    
-
-    uint8_t RX_Message_ISR[8];
-    uint32_t id;
+uint32_t canRxQueueDrops = 0;
 
-    Serial.println("Started");
-    float startTime = micros();
-    ///////////////////////////////////////
+// Move every frame waiting in a receive FIFO to msgInQ, so a burst costs one interrupt.
+static void drainRXFifo(uint32_t fifo) {
+    CANFrame frame;
+    uint32_t count = 0;
+    frame.time = micros();  // Taken first, as close to the end of the frame as we can get
 
-    CAN_RX(id, RX_Message_ISR);
-
-    //////////////////////////////////////
-        
-    float final_time = micros() - startTime;
-    accumulator += final_time;
-    counter += 1;
-    Serial.print("Worst Case Time for CAN_RX_ISR (ms): ");
-    Serial.println(accumulator/(counter * 1000));
-    Serial.println("Finished");
-    
+    trace(TRACE_CAN_RX_ISR_BEGIN, fifo);
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xQueueSendFromISR(msgInQ, RX_Message_ISR, &xHigherPriorityTaskWoken);
+    while (CAN_CheckRXLevel(fifo)) {
+        CAN_RX(frame.id, frame.data, fifo);
+        if (xQueueSendFromISR(msgInQ, &frame, &xHigherPriorityTaskWoken) != pdTRUE) {
+            canRxQueueDrops++;
+        }
+        count++;
+    }
+    trace(TRACE_CAN_RX_ISR_END, count);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
-    
+// CAN RX ISR: Note traffic (FIFO 0).
+void CAN_RX_ISR(void) {
+    drainRXFifo(0);
 }
 
-// CAN TX ISR: Releases a transmit mailbox slot.
-void CAN_TX_ISR(void) {
+// CAN RX1 ISR: Control and status messages (FIFO 1).
+void CAN_RX1_ISR(void) {
+    drainRXFifo(1);
+}
 
-    Serial.println("Started");
-    float startTime = micros();
-    ///////////////////////////////////////
+static TaskHandle_t canTxTask = NULL;
+static bool canTxWaiting = false;  // CAN_TX_Task has frames the transmit queue rejected
+static uint32_t clockSentUs = 0;    // When the last clock sync left, set by CAN_TX_ISR
+static bool clockSent = false;
+
+uint32_t syncedMicros() {
+    return clockSync.masterTime(micros());
+}
 
+// CAN TX ISR: A mailbox has been sent; ES_CAN refills it from its queue.
+// Wakes CAN_TX_Task if it is waiting for queue space.
+void CAN_TX_ISR(void) {
+    trace(TRACE_CAN_TX_ISR_BEGIN);
+    if (canIdMessage(CAN_TX_CompletedID()) == CAN_MSG_CLOCK) {
+        __atomic_store_n(&clockSentUs, micros(), __ATOMIC_RELAXED);
+        __atomic_store_n(&clockSent, true, __ATOMIC_RELEASE);
+    }
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xSemaphoreGiveFromISR(CAN_TX_Semaphore, &xHigherPriorityTaskWoken);
+    if (__atomic_exchange_n(&canTxWaiting, false, __ATOMIC_RELAXED) && canTxTask) {
+        vTaskNotifyGiveFromISR(canTxTask, &xHigherPriorityTaskWoken);
+    }
+    trace(TRACE_CAN_TX_ISR_END);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
-    //////////////////////////////////////
-        
-    float final_time = micros() - startTime;
-    accumulator += final_time;
-    counter += 1;
-    Serial.print("Worst Case Time for CAN_TX_ISR (ms): ");
-    Serial.println(accumulator/(counter * 1000));
-    Serial.println("Finished");
+// Forget a remote module and have the voice engine release every note it owned.
+static void departModule(uint8_t module) {
+    remoteKeys.forget(module);
+    __atomic_fetch_or(&departedModules, (uint16_t)(1 << module), __ATOMIC_RELEASE);
+}
+
+// Release the keys of every remote module. Module IDs are handshake positions,
+// so after a re-enumeration the old state belongs to modules that may have gone.
+// Called once the handshake has restarted, when our own position is not known, so the
+// tracker decides: it only holds state for modules we have received frames from, and
+// our own frames are never applied to it. Our local notes therefore stay held.
+static void releaseRemoteKeys() {
+    for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+        if (remoteKeys.seen(module)) {
+            departModule(module);
+        } else {
+            remoteKeys.forget(module);
+        }
+    }
+}
+
+// Our own frames come back in loopback. Before this module is placed, and while it is
+// placed again, its position is not yet its ID, so no frame is ours.
+static bool isOwnFrame(uint8_t module) {
+    return handshake.placed() && module == handshake.position();
+}
+
+// Follower side of the clock sync: each sync says when the master sent the previous one,
+// which we stamped when it arrived, so the two stamps describe the same instant.
+static void receiveClockSync(const CANFrame& rx) {
+    static ClockSyncFrame last = {};
+    static uint32_t lastRxUs = 0;
+    static bool haveLast = false;
 
+    ClockSyncFrame sync;
+    if (!decodeClockSync(rx.data, sync) || isOwnFrame(sync.position)) {
+        return;  // Our own sync in loopback
+    }
+    if (haveLast && sync.previousValid && sync.seq == (uint8_t)(last.seq + 1) &&
+        sync.position == last.position) {
+        clockSync.receive(sync.previousUs, lastRxUs);
+    }
+    last = sync;
+    lastRxUs = rx.time;
+    haveLast = true;
 }
 
 void CAN_RX_Task(void *pvParameters) {
-    uint8_t msgIn[8];
-    uint32_t id;
+    CANFrame rx;
+    uint8_t* msgIn = rx.data;
+    #ifndef TEST_CAN_RX
+    uint32_t epoch = handshake.epoch();
+    #endif
     
     #ifdef TEST_CAN_RX
     // In test mode, simulate receiving CAN messages
@@ -70,27 +139,72 @@ void CAN_RX_Task(void *pvParameters) {
     simulatedMessage[0] = 1;  // Example test data
     simulatedMessage[1] = 2;  // Example test data
     // You can fill the rest with any values to simulate a message.
+    rx.id = canId(CAN_MSG_KEYSTATE, 0);
     memcpy(msgIn, simulatedMessage, 8);  // Copy the simulated message
     #endif
     
     while (1) {
-
-
-        Serial.println("Started");
-        float startTime = micros();
-        ///////////////////////////////////////
-
         #ifndef TEST_CAN_RX
-        // In normal operation, receive a message from the CAN queue
-        xQueueReceive(msgInQ, msgIn, portMAX_DELAY);
+        // In normal operation, receive a message from the CAN queue. The timeout bounds
+        // how long notes of a silent module or a re-enumerated stack can keep sounding.
+        bool received = xQueueReceive(msgInQ, &rx, pdMS_TO_TICKS(KEYSTATE_REFRESH_MS)) == pdTRUE;
+        if (handshake.epoch() != epoch) {
+            epoch = handshake.epoch();
+            releaseRemoteKeys();
+            voiceAllocator.reset();  // Loads are indexed by the old positions
+            clockSync.reset();       // The master may have changed
+        }
+        int8_t silent;
+        while ((silent = remoteKeys.expired(micros(), KEYSTATE_TIMEOUT_MS * 1000)) >= 0) {
+            departModule(silent);
+        }
+        KeyEvent stale[KeyStateTracker::MAX_EVENTS];
+        uint8_t staleCount;
+        while ((staleCount = remoteKeys.expireOctave(micros(), KEYSTATE_TIMEOUT_MS * 1000, stale)) > 0) {
+            for (uint8_t i = 0; i < staleCount; i++) {
+                remoteKeyEvents.push(stale[i]);
+            }
+        }
+        if (!received) {
+            continue;
+        }
+        #endif
+        trace(TRACE_CAN_RX_TASK_BEGIN);
+        CanMessageType type = canIdMessage(rx.id);
+        #ifdef DISTRIBUTED_VOICES
+        VoiceAssignment assign;
+        if (type == CAN_MSG_VOICE && decodeVoiceAssignment(msgIn, assign)) {
+            if (!isOwnFrame(assign.origin)) {
+                voiceAllocator.assigned(assign.target);
+                if (assign.target == handshake.position()) {
+                    voiceAssignments.push(assign);
+                }
+            }
+            trace(TRACE_CAN_RX_TASK_END, msgIn[0]);
+            continue;
+        }
         #endif
-        noInterrupts();
-        memcpy(globalRXMessage, msgIn, 8);
-        interrupts();
-        xSemaphoreTake(sysMutex, portMAX_DELAY);
-        canRxSuccess = true;
-        stepSizes = getArray();
-        xSemaphoreGive(sysMutex);
+        if (type != CAN_MSG_KEYSTATE) {
+            HandshakeMessage hs;
+            if (type == CAN_MSG_HANDSHAKE && decodeHandshake(msgIn, hs)) {
+                handshakeInbox.push(hs);
+            } else if (type == CAN_MSG_CLOCK) {
+                receiveClockSync(rx);
+            }
+            trace(TRACE_CAN_RX_TASK_END, msgIn[0]);
+            continue;
+        }
+        // Key-state frames are diffed against the sender's previous state, and the voice
+        // engine merges the resulting events into its NoteMap with per-module ownership
+        KeyStateFrame frame;
+        if (decodeKeyState(msgIn, frame) && !isOwnFrame(frame.module)) {
+            KeyEvent events[KeyStateTracker::MAX_EVENTS];
+            uint8_t count = remoteKeys.apply(frame, micros(), events);
+            voiceAllocator.report(frame.module, frame.load);
+            for (uint8_t i = 0; i < count; i++) {
+                remoteKeyEvents.push(events[i]);
+            }
+        }
         
         #ifdef TEST_CAN_RX
         // // Optionally, print or log the message if in test mode
@@ -102,27 +216,78 @@ void CAN_RX_Task(void *pvParameters) {
         // Serial.println();
         #endif
 
-        //////////////////////////////////////
-        
-        float final_time = micros() - startTime;
-        accumulator += final_time;
-        counter += 1;
-        Serial.print("Worst Case Time for CAN_RX (ms): ");
-        Serial.println(accumulator/(counter * 1000));
-        Serial.println("Finished");
+        trace(TRACE_CAN_RX_TASK_END, msgIn[0]);
+    }
+}
+
+// Wake CAN_TX_Task after new key events have been published.
+void notifyCANTx() {
+    if (canTxTask) {
+        xTaskNotifyGive(canTxTask);
+    }
+}
+
+// Queue one frame without blocking. Returns false if the transmit queue is full;
+// CAN_TX_ISR then wakes the task again once a frame has gone out.
+static bool sendCANMessage(uint32_t id, uint8_t msgOut[8]) {
+    trace(TRACE_CAN_TX_BEGIN, msgOut[0]);
+    __atomic_store_n(&canTxWaiting, true, __ATOMIC_RELAXED);
+    uint32_t result = CAN_TX_Async(id, msgOut);
+    if (result == CAN_TX_QUEUED) {
+        __atomic_store_n(&canTxWaiting, false, __ATOMIC_RELAXED);
+    }
+    trace(TRACE_CAN_TX_END, result);
+    return result == CAN_TX_QUEUED;
+}
+
+#ifdef DISTRIBUTED_VOICES
+// Pick the module that renders a note just pressed here. Our own notes start straight
+// away; the others are queued behind the key-state frame that carries the press.
+static void assignVoice(uint8_t note) {
+    uint8_t position = handshake.position();
+    VoiceAssignment assign = {position, position, note};
+    if (handshake.state() == Handshake::COMPLETE) {
+        assign.target = voiceAllocator.choose(position, handshake.moduleCount());
+    }
+    voiceAllocator.assigned(assign.target);
+    if (assign.target == position) {
+        localVoiceAssignments.push(assign);
+    }
+    if (handshake.moduleCount() > 1) {
+        // Sent for our own notes too, so the others count the voice in our load
+        CANFrame tx = {canId(CAN_MSG_VOICE, position), {}};
+        encodeVoiceAssignment(assign, tx.data);
+        xQueueSend(msgOutQ, &tx, 0);
+    }
+}
+#endif
 
+// Octaves with held keys, or the current octave if none, so the module is heard at least
+// once per refresh even with no keys held
+static uint16_t keyStateOctaves(const uint16_t* octaveKeys) {
+    uint16_t octaves = 0;
+    for (uint8_t octave = 0; octave < KEYSTATE_OCTAVES; octave++) {
+        if (octaveKeys[octave]) {
+            octaves |= 1 << octave;
+        }
     }
+    uint8_t current = params.get(PARAM_OCTAVE);
+    return octaves ? octaves : 1 << (current < KEYSTATE_OCTAVES ? current : KEYSTATE_OCTAVES - 1);
 }
 
 // NOT SURE HOW TO TEST THIS FUNCTION
 void CAN_TX_Task(void *pvParameters) {
     uint8_t msgOut[8];
+    KeyStateFrame keyState = {0, 0, 0, 0, 0, 0};
+    uint16_t octaveKeys[KEYSTATE_OCTAVES] = {};  // Keys held in each octave
+    uint16_t pendingOctaves = 0;                 // Octaves whose state is still to be sent
+    bool refresh = true;
+    uint32_t keyStateEpoch = 0;
+    uint32_t clockSyncMs = 0;
+    uint8_t clockSeq = 0;
+    canTxTask = xTaskGetCurrentTaskHandle();
 
     while (1) {
-        Serial.println("Started");
-        float startTime = micros();
-        ///////////////////////////////////////
-
         #ifdef TEST_CAN_TX
         // In test mode, simulate a CAN message
         uint8_t simulatedMessage[8] = {0};  // Simulated CAN message
@@ -130,52 +295,108 @@ void CAN_TX_Task(void *pvParameters) {
         simulatedMessage[1] = 2;  // Example test data
         // Fill in the rest with values you want to test with
         memcpy(msgOut, simulatedMessage, 8);  // Copy simulated message into msgOut
+        sendCANMessage(canId(CAN_MSG_KEYSTATE, 0), msgOut);
         #else
-        // In normal operation, block until a message is available on the transmit queue
-        xQueueReceive(msgOutQ, msgOut, portMAX_DELAY);
+        // Block until scanKeysTask publishes key events, or resend the state periodically
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(KEYSTATE_REFRESH_MS)) == 0) {
+            refresh = true;
+        }
         #endif
 
-        // Wait for an available transmit mailbox (or simulate CAN transmission in test mode)
-        xSemaphoreTake(CAN_TX_Semaphore, portMAX_DELAY);
-
-        // #ifdef TEST_CAN_TX
-        // // In test mode, simulate the CAN transmission
-        // Serial.print("Simulated CAN TX Message: ");
-        // for (int i = 0; i < 8; i++) {
-        //     Serial.print(msgOut[i], HEX);
-        //     Serial.print(" ");
-        // }
-        // Serial.println();
-        // canTxSuccess = true;  // Message successfully "sent" in test mode
-        // #else
-        // In normal operation, send the CAN message
-        if (CAN_TX(0x123, msgOut) == 0) {
-            canTxSuccess = true;  // Message successfully sent
+        // Pending key events are folded into the bitmap of their octave. Live keys share
+        // one octave, but MIDI input and recorder playback can hold notes in several.
+        KeyEvent event;
+        while (keyEvents.pop(KEY_READER_CAN, event)) {
+            if (event.octave >= KEYSTATE_OCTAVES) {
+                continue;
+            }
+            uint16_t& keys = octaveKeys[event.octave];
+            if (event.pressed) {
+                #ifdef DISTRIBUTED_VOICES
+                if (!(keys & (1 << event.key))) {
+                    assignVoice(event.octave * 12 + event.key);
+                }
+                #endif
+                keys |= 1 << event.key;
+            } else {
+                keys &= ~(1 << event.key);
+            }
+            pendingOctaves |= 1 << event.octave;
+        }
+        // Key state is only sent once handshaking has given this module its ID
+        if (handshake.placed() && keyStateEpoch != handshake.epoch()) {
+            // Re-enumerated: new module ID, resend everything
+            keyStateEpoch = handshake.epoch();
+            refresh = true;
+        }
+        #ifdef DISTRIBUTED_VOICES
+        // The others balance new notes with the load in our key-state frames
+        uint8_t load = voiceAllocator.load(handshake.position());
+        if (load != keyState.load) {
+            keyState.load = load;
+            refresh = true;
+        }
+        #endif
+        if (refresh) {
+            pendingOctaves |= keyStateOctaves(octaveKeys);
+            refresh = false;
+        }
+        while (pendingOctaves && handshake.placed()) {
+            keyState.octave = __builtin_ctz(pendingOctaves);
+            keyState.keys = octaveKeys[keyState.octave];
+            keyState.module = handshake.position();
+            keyState.timeMs = micros() / 1000;
+            encodeKeyState(keyState, msgOut);
+            if (!sendCANMessage(canId(CAN_MSG_KEYSTATE, keyState.module), msgOut)) {
+                break;
+            }
+            keyState.seq++;
+            pendingOctaves &= pendingOctaves - 1;
         }
-        // #endif
 
-        //////////////////////////////////////
-        
-        float final_time = micros() - startTime;
-        accumulator += final_time;
-        counter += 1;
-        Serial.print("Worst Case Time for CAN_TX (ms): ");
-        Serial.println(accumulator/(counter * 1000));
-        Serial.println("Finished");
+        // The westmost module is the clock master once the stack is enumerated
+        bool clockMaster = handshake.state() == Handshake::COMPLETE && handshake.position() == 0 &&
+                           handshake.moduleCount() > 1;
+        if (clockMaster && millis() - clockSyncMs >= CLOCK_SYNC_MS) {
+            // Cleared before sending, so the flag can only be set again by this sync
+            bool previousValid = __atomic_exchange_n(&clockSent, false, __ATOMIC_ACQUIRE);
+            ClockSyncFrame sync = {0, clockSeq, previousValid, __atomic_load_n(&clockSentUs, __ATOMIC_RELAXED)};
+            encodeClockSync(sync, msgOut);
+            if (sendCANMessage(canId(CAN_MSG_CLOCK, 0), msgOut)) {
+                clockSeq++;
+                clockSyncMs = millis();
+            } else if (previousValid) {
+                __atomic_store_n(&clockSent, true, __ATOMIC_RELAXED);
+            }
+        }
 
+        // Any other frames queued for transmission; a rejected frame stays at the front
+        CANFrame tx;
+        while ((!pendingOctaves || !handshake.placed()) && xQueuePeek(msgOutQ, &tx, 0) == pdTRUE) {
+            if (!sendCANMessage(tx.id, tx.data)) {
+                break;
+            }
+            xQueueReceive(msgOutQ, &tx, 0);
+        }
     }
 }
 
 void initCAN() {
     #ifdef SINGLE_PIANO
-        CAN_Init(true);
+        CAN_Init(true, CAN_BITRATE);
     #endif
     #ifdef DUAL_PIANO
-        CAN_Init(false);
+        CAN_Init(false, CAN_BITRATE);
     #endif
-    setCANFilter(0, 0);
+    // One hardware filter per message type, from any module, into the FIFO of its route.
+    // Other IDs are rejected by the controller.
+    for (uint8_t bank = 0; bank < CAN_ROUTE_COUNT; bank++) {
+        const CanRoute& route = CAN_ROUTES[bank];
+        setCANFilter(canId(route.type, 0), CAN_ID_SOURCE_MASK, bank, route.fifo);
+    }
     #ifndef DISABLE_CAN_RX_ISR
     CAN_RegisterRX_ISR(CAN_RX_ISR);
+    CAN_RegisterRX1_ISR(CAN_RX1_ISR);
     #endif
     #ifndef DISABLE_CAN_TX_ISR
     CAN_RegisterTX_ISR(CAN_TX_ISR);
@@ -1,10 +1,35 @@
 #ifndef CAN_BUS_HPP
 #define CAN_BUS_HPP
 
+#include "keys.hpp"
+#include "handshake.hpp"
+#include "can_protocol.hpp"
+
 void CAN_TX_Task(void *pvParameters);
 void CAN_RX_Task(void *pvParameters);
 void CAN_TX_ISR();
 void CAN_RX_ISR();
+void CAN_RX1_ISR();
 void initCAN();  // Initialize CAN bus
+void notifyCANTx();  // Wake CAN_TX_Task to send pending key events
+
+// Received frames lost because msgInQ was full. Overruns of the hardware FIFOs are
+// counted by ES_CAN (CAN_RXOverrunCount).
+extern uint32_t canRxQueueDrops;
+
+// Key transitions of other modules, produced by CAN_RX_Task and read by the voice engine
+extern EventRing<KeyEvent, 64, 1> remoteKeyEvents;
+
+// Bit m set by CAN_RX_Task when module m has gone silent or been re-enumerated;
+// the voice engine clears it after releasing every note the module owned
+extern uint16_t departedModules;
+
+// Voices this module has to render (DISTRIBUTED_VOICES): assignments from other modules,
+// produced by CAN_RX_Task, and its own notes that it picked itself, produced by CAN_TX_Task
+extern EventRing<VoiceAssignment, 16, 1> voiceAssignments;
+extern EventRing<VoiceAssignment, 16, 1> localVoiceAssignments;
+
+// Handshake messages of other modules, produced by CAN_RX_Task and read by scanKeysTask
+extern EventRing<HandshakeMessage, 8, 1> handshakeInbox;
 
 #endif // CAN_BUS_HPP
@@ -0,0 +1,148 @@
+#include "can_protocol.hpp"
+
+void encodeKeyState(const KeyStateFrame& frame, uint8_t data[8]) {
+    data[0] = (CAN_PROTOCOL_VERSION << 4) | CAN_MSG_KEYSTATE;
+    data[1] = (frame.octave << 4) | (frame.module & 0xF);
+    data[2] = frame.keys & 0xFF;
+    data[3] = ((frame.keys >> 8) & 0x0F) | (frame.load > 15 ? 15 : frame.load) << 4;
+    data[4] = frame.seq;
+    data[5] = frame.timeMs & 0xFF;
+    data[6] = (frame.timeMs >> 8) & 0xFF;
+    data[7] = (frame.timeMs >> 16) & 0xFF;
+}
+
+bool decodeKeyState(const uint8_t data[8], KeyStateFrame& frame) {
+    if (data[0] != ((CAN_PROTOCOL_VERSION << 4) | CAN_MSG_KEYSTATE)) {
+        return false;
+    }
+    frame.module = data[1] & 0xF;
+    frame.octave = data[1] >> 4;
+    frame.keys = (data[2] | (data[3] << 8)) & 0xFFF;
+    frame.load = data[3] >> 4;
+    frame.seq = data[4];
+    frame.timeMs = data[5] | (data[6] << 8) | ((uint32_t)data[7] << 16);
+    return true;
+}
+
+void encodeHandshake(const HandshakeMessage& msg, uint8_t data[8]) {
+    data[0] = (CAN_PROTOCOL_VERSION << 4) | CAN_MSG_HANDSHAKE;
+    data[1] = msg.position;
+    data[2] = (msg.last ? 1 : 0) | (msg.kind << 1);
+    for (int i = 0; i < 4; i++) {
+        data[3 + i] = (msg.uid >> (8 * i)) & 0xFF;
+    }
+    data[7] = 0;
+}
+
+bool decodeHandshake(const uint8_t data[8], HandshakeMessage& msg) {
+    if (data[0] != ((CAN_PROTOCOL_VERSION << 4) | CAN_MSG_HANDSHAKE)) {
+        return false;
+    }
+    msg.position = data[1];
+    msg.last = data[2] & 1;
+    msg.kind = (HandshakeKind)((data[2] >> 1) & 0x3);
+    msg.uid = data[3] | (data[4] << 8) | (data[5] << 16) | ((uint32_t)data[6] << 24);
+    return true;
+}
+
+void encodeVoiceAssignment(const VoiceAssignment& assign, uint8_t data[8]) {
+    data[0] = (CAN_PROTOCOL_VERSION << 4) | CAN_MSG_VOICE;
+    data[1] = (assign.origin << 4) | (assign.target & 0xF);
+    data[2] = assign.note;
+    for (int i = 3; i < 8; i++) {
+        data[i] = 0;
+    }
+}
+
+bool decodeVoiceAssignment(const uint8_t data[8], VoiceAssignment& assign) {
+    if (data[0] != ((CAN_PROTOCOL_VERSION << 4) | CAN_MSG_VOICE)) {
+        return false;
+    }
+    assign.origin = data[1] >> 4;
+    assign.target = data[1] & 0xF;
+    assign.note = data[2];
+    return true;
+}
+
+void encodeClockSync(const ClockSyncFrame& sync, uint8_t data[8]) {
+    data[0] = (CAN_PROTOCOL_VERSION << 4) | CAN_MSG_CLOCK;
+    data[1] = sync.position;
+    data[2] = sync.seq;
+    data[3] = sync.previousValid ? 1 : 0;
+    for (int i = 0; i < 4; i++) {
+        data[4 + i] = (sync.previousUs >> (8 * i)) & 0xFF;
+    }
+}
+
+bool decodeClockSync(const uint8_t data[8], ClockSyncFrame& sync) {
+    if (data[0] != ((CAN_PROTOCOL_VERSION << 4) | CAN_MSG_CLOCK)) {
+        return false;
+    }
+    sync.position = data[1];
+    sync.seq = data[2];
+    sync.previousValid = data[3] & 1;
+    sync.previousUs = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+    return true;
+}
+
+uint8_t KeyStateTracker::apply(const KeyStateFrame& frame, uint32_t time, KeyEvent* out) {
+    ModuleState& module = state[frame.module & 0xF];
+    uint8_t count = 0;
+
+    if (module.seen) {
+        lost += (uint8_t)(frame.seq - module.seq - 1);
+    }
+    module.seq = frame.seq;
+    module.seen = true;
+    module.lastTime = time;
+    if (frame.octave >= KEYSTATE_OCTAVES) {
+        return 0;
+    }
+
+    uint16_t& keys = module.keys[frame.octave];
+    uint16_t released = keys & ~frame.keys;
+    uint16_t pressed = frame.keys & ~keys;
+    while (released) {
+        uint8_t key = __builtin_ctz(released);
+        released &= released - 1;
+        out[count++] = {time, frame.octave, key, 0, frame.module};
+    }
+    while (pressed) {
+        uint8_t key = __builtin_ctz(pressed);
+        pressed &= pressed - 1;
+        out[count++] = {time, frame.octave, key, 1, frame.module};
+    }
+    keys = frame.keys;
+    module.octaveTime[frame.octave] = time;
+    return count;
+}
+
+int8_t KeyStateTracker::expired(uint32_t time, uint32_t timeout) const {
+    for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+        if (state[module].seen && time - state[module].lastTime >= timeout) {
+            return module;
+        }
+    }
+    return -1;
+}
+
+uint8_t KeyStateTracker::expireOctave(uint32_t time, uint32_t timeout, KeyEvent* out) {
+    for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+        ModuleState& moduleState = state[module];
+        for (uint8_t octave = 0; octave < KEYSTATE_OCTAVES; octave++) {
+            uint16_t released = moduleState.keys[octave];
+            if (!released || time - moduleState.octaveTime[octave] < timeout) {
+                continue;
+            }
+            uint8_t count = 0;
+            while (released) {
+                uint8_t key = __builtin_ctz(released);
+                released &= released - 1;
+                out[count++] = {time, octave, key, 0, module};
+            }
+            moduleState.keys[octave] = 0;
+            return count;
+        }
+    }
+    return 0;
+}
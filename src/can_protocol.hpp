@@ -0,0 +1,193 @@
+#ifndef CAN_PROTOCOL_HPP
+#define CAN_PROTOCOL_HPP
+
+#include <cstdint>
+#include "keys.hpp"
+#include "handshake.hpp"
+
+// Key-state frames. Instead of one frame per key transition, a module sends the full
+// state of the 12 keys of one octave, so a chord is one frame and a lost frame is corrected
+// by the next. Notes held in several octaves at once, from MIDI or the recorder, take one
+// frame per octave.
+//
+//   byte 0     version << 4 | message type
+//   byte 1     octave << 4 | module id
+//   byte 2-3   key bitmap, bit k = key k (C to B), little endian; bits 12-15 = load,
+//              the number of voices the module is rendering (DISTRIBUTED_VOICES)
+//   byte 4     sequence number, +1 per frame from this module
+//   byte 5-7   timestamp in ms, little endian, wraps after about 4.6 hours
+
+#define CAN_PROTOCOL_VERSION 1
+#define CAN_MAX_MODULES 16
+#define KEYSTATE_REFRESH_MS 100  // Unchanged state is resent at this interval
+#define KEYSTATE_TIMEOUT_MS 350  // A module silent for this long has its notes released
+#define KEYSTATE_OCTAVES 9       // Octaves 0-8, the range of the NoteMap
+
+enum CanMessageType : uint8_t {
+    CAN_MSG_KEYSTATE = 1,
+    CAN_MSG_HANDSHAKE,
+    CAN_MSG_VOICE,
+    CAN_MSG_CLOCK,
+};
+
+// Standard IDs: the lowest ID wins arbitration, so the class in the top bits sets the
+// priority and the sending module in the bottom bits keeps the IDs of different modules
+// apart. Two modules never send the same ID, so they never collide in the data field.
+//
+//   bits 10-8  class, CAN_CLASS_*
+//   bits 7-4   message type within the class
+//   bits 3-0   source module (handshake position)
+enum CanClass : uint8_t {
+    CAN_CLASS_CLOCK = 0,    // Clock sync: rare, and its arrival time is the payload
+    CAN_CLASS_NOTE = 1,     // Key state and voice assignments
+    CAN_CLASS_CONTROL = 2,  // Handshake
+    CAN_CLASS_STATUS = 3,   // Reserved for periodic status
+    CAN_CLASS_BULK = 7,     // Reserved for parameter dumps and other long transfers
+};
+
+#define CAN_ID_CLASS_SHIFT 8
+#define CAN_ID_MESSAGE_SHIFT 4
+#define CAN_ID_MODULE_MASK 0x00F
+#define CAN_ID_SOURCE_MASK 0x7F0  // Filter mask: any module, one message type
+
+// The class and receive FIFO of every message type. IDs and hardware filters are both
+// derived from this table. Notes and their voice assignments share FIFO 0, so they are
+// read in the order they were sent; clock and control traffic use FIFO 1, so a burst of
+// notes cannot overrun them.
+struct CanRoute {
+    CanMessageType type;
+    CanClass cls;
+    uint8_t fifo;
+};
+
+static constexpr CanRoute CAN_ROUTES[] = {
+    {CAN_MSG_CLOCK, CAN_CLASS_CLOCK, 1},
+    {CAN_MSG_KEYSTATE, CAN_CLASS_NOTE, 0},
+    {CAN_MSG_VOICE, CAN_CLASS_NOTE, 0},  // Behind the key state, which has the lower ID
+    {CAN_MSG_HANDSHAKE, CAN_CLASS_CONTROL, 1},
+};
+static constexpr uint8_t CAN_ROUTE_COUNT = sizeof(CAN_ROUTES) / sizeof(CAN_ROUTES[0]);
+
+constexpr CanClass canClassOf(CanMessageType type) {
+    for (uint8_t i = 0; i < CAN_ROUTE_COUNT; i++) {
+        if (CAN_ROUTES[i].type == type) {
+            return CAN_ROUTES[i].cls;
+        }
+    }
+    return CAN_CLASS_BULK;
+}
+
+// ID of message `type` sent by `module`
+constexpr uint32_t canId(CanMessageType type, uint8_t module) {
+    return (uint32_t)canClassOf(type) << CAN_ID_CLASS_SHIFT | (uint32_t)type << CAN_ID_MESSAGE_SHIFT |
+           (module & CAN_ID_MODULE_MASK);
+}
+constexpr CanMessageType canIdMessage(uint32_t id) { return (CanMessageType)((id >> CAN_ID_MESSAGE_SHIFT) & 0xF); }
+constexpr uint8_t canIdModule(uint32_t id) { return id & CAN_ID_MODULE_MASK; }
+
+static_assert(canId(CAN_MSG_CLOCK, 15) < canId(CAN_MSG_KEYSTATE, 0), "Clock syncs must win over notes");
+static_assert(canId(CAN_MSG_KEYSTATE, 15) < canId(CAN_MSG_VOICE, 0), "Key state must win over voice assignments");
+static_assert(canId(CAN_MSG_VOICE, 15) < canId(CAN_MSG_HANDSHAKE, 0), "Notes must win over control traffic");
+
+struct KeyStateFrame {
+    uint8_t module;   // 0-15
+    uint8_t octave;   // 0-15
+    uint16_t keys;    // 12-bit bitmap
+    uint8_t load;     // 0-15 voices rendered
+    uint8_t seq;
+    uint32_t timeMs;  // 24 bits on the bus
+};
+
+// A frame as it is queued between the CAN ISRs and tasks
+struct CANFrame {
+    uint32_t id;
+    uint8_t data[8];
+    uint32_t time;  // micros() in the receive interrupt
+};
+
+void encodeKeyState(const KeyStateFrame& frame, uint8_t data[8]);
+// Returns false for other message types or protocol versions
+bool decodeKeyState(const uint8_t data[8], KeyStateFrame& frame);
+
+// Handshake announcements, heartbeats and restarts (src/handshake.hpp)
+//
+//   byte 0     version << 4 | message type
+//   byte 1     position
+//   byte 2     bit 0 = last module, bits 1-2 = HandshakeKind
+//   byte 3-6   module uid hash, little endian
+void encodeHandshake(const HandshakeMessage& msg, uint8_t data[8]);
+bool decodeHandshake(const uint8_t data[8], HandshakeMessage& msg);
+
+// Distributed polyphony: the module whose key started `note` has picked `target` to
+// render it (src/voice_alloc.hpp). Sent after the key-state frame with the press; the
+// transmit mailboxes are served in request order and the key state has the lower ID, so
+// every module sees the press first.
+//
+//   byte 0     version << 4 | message type
+//   byte 1     origin << 4 | target
+//   byte 2     note, octave * 12 + key
+struct VoiceAssignment {
+    uint8_t origin;
+    uint8_t target;
+    uint8_t note;
+};
+
+void encodeVoiceAssignment(const VoiceAssignment& assign, uint8_t data[8]);
+bool decodeVoiceAssignment(const uint8_t data[8], VoiceAssignment& assign);
+
+// Clock sync from the master (src/clock_sync.hpp). Each frame carries the time at which
+// the previous one finished transmitting, as seen by the master's transmit interrupt.
+//
+//   byte 0     version << 4 | message type
+//   byte 1     master position
+//   byte 2     sequence number, +1 per sync
+//   byte 3     bit 0 = previous time valid
+//   byte 4-7   master micros() when sync seq - 1 was sent, little endian
+struct ClockSyncFrame {
+    uint8_t position;
+    uint8_t seq;
+    bool previousValid;
+    uint32_t previousUs;
+};
+
+void encodeClockSync(const ClockSyncFrame& sync, uint8_t data[8]);
+bool decodeClockSync(const uint8_t data[8], ClockSyncFrame& sync);
+
+// Receiver side: remembers the last state of every octave of every module and turns each
+// new frame into key events by diffing the bitmaps of that octave. Sequence gaps are
+// counted but need no action, because every frame carries the complete state of its octave.
+class KeyStateTracker {
+public:
+    static const uint8_t MAX_EVENTS = 12;  // One octave changes at a time
+
+    // Returns the number of events written to `out`, stamped with `time`
+    uint8_t apply(const KeyStateFrame& frame, uint32_t time, KeyEvent* out);
+    uint16_t keys(uint8_t module, uint8_t octave) const {
+        return octave < KEYSTATE_OCTAVES ? state[module & 0xF].keys[octave] : 0;
+    }
+    uint32_t lostFrames() const { return lost; }
+    // True once a frame from `module` has been applied since it was last forgotten.
+    // Frames from this module are never applied, so a seen module is always a remote one.
+    bool seen(uint8_t module) const { return state[module & 0xF].seen; }
+    // First module whose last frame is at least `timeout` older than `time`, or -1
+    int8_t expired(uint32_t time, uint32_t timeout) const;
+    // Release the keys of one octave whose state has not been refreshed for `timeout`
+    // although its module is still sending, e.g. after its frame emptying the octave was
+    // lost. Returns the number of releases written to `out`, 0 once none are left.
+    uint8_t expireOctave(uint32_t time, uint32_t timeout, KeyEvent* out);
+    // Drop a module's state, e.g. when it has left the bus; its next frame starts afresh
+    void forget(uint8_t module) { state[module & 0xF] = {}; }
+
+private:
+    struct ModuleState {
+        uint16_t keys[KEYSTATE_OCTAVES];
+        uint32_t octaveTime[KEYSTATE_OCTAVES];  // Time of the last frame for each octave
+        uint8_t seq;
+        bool seen;
+        uint32_t lastTime;  // Time passed to apply() for the last frame
+    };
+    ModuleState state[CAN_MAX_MODULES] = {};
+    uint32_t lost = 0;
+};
+
+#endif // CAN_PROTOCOL_HPP
@@ -0,0 +1,115 @@
+#include "can_stats.hpp"
+#include "can_bus.hpp"
+#include "system.hpp"
+#include "config.hpp"
+#include <ES_CAN.h>
+#include <Arduino.h>
+#include <cstdio>
+
+void BusLoadMeter::sample(uint32_t txTotal, uint32_t rxTotal, uint32_t elapsedMs) {
+    // Replace the oldest sample with the frames counted since the last one
+    txSum -= tx[next];
+    rxSum -= rx[next];
+    msSum -= ms[next];
+    tx[next] = txTotal - lastTx;
+    rx[next] = rxTotal - lastRx;
+    ms[next] = elapsedMs;
+    txSum += tx[next];
+    rxSum += rx[next];
+    msSum += ms[next];
+    next = (next + 1) % CAN_STATS_WINDOW;
+    lastTx = txTotal;
+    lastRx = rxTotal;
+}
+
+uint16_t BusLoadMeter::perSecond(uint32_t frames) const {
+    return msSum ? (uint64_t)frames * 1000 / msSum : 0;
+}
+
+uint16_t BusLoadMeter::loadPermille(uint32_t bitrate, bool countRx) const {
+    if (!msSum || !bitrate) {
+        return 0;
+    }
+    uint64_t bits = (uint64_t)(txSum + (countRx ? rxSum : 0)) * CAN_FRAME_BITS;
+    uint64_t available = (uint64_t)bitrate * msSum / 1000;
+    return bits * 1000 / available;
+}
+
+static CanStats canStats = {};  // Protected by sysMutex
+
+void getCanStats(CanStats& out) {
+    xSemaphoreTake(sysMutex, portMAX_DELAY);
+    out = canStats;
+    xSemaphoreGive(sysMutex);
+}
+
+#if CAN_STATS_PRINT_MS > 0
+static const char* const BUS_STATE_NAMES[] = {"ok", "warning", "passive", "bus-off"};
+
+static void printCanStats(const CanStats& stats) {
+    char line[160];
+    snprintf(line, sizeof(line),
+             "CAN load %u.%u%% (peak %u.%u%%) tx %u/s rx %u/s TEC %u REC %u (peak %u/%u) %s "
+             "bus-off %lu lost %lu overruns %lu tx-full %lu",
+             stats.loadPermille / 10, stats.loadPermille % 10,
+             stats.peakLoadPermille / 10, stats.peakLoadPermille % 10,
+             stats.txPerSecond, stats.rxPerSecond, stats.tec, stats.rec, stats.tecPeak, stats.recPeak,
+             BUS_STATE_NAMES[stats.state], (unsigned long)stats.busOffs, (unsigned long)stats.lost,
+             (unsigned long)stats.overruns, (unsigned long)stats.txQueueFull);
+    Serial.println(line);
+}
+#endif
+
+void canStatsTask(void *pvParameters) {
+    static BusLoadMeter meter;
+    CanStats stats = {};
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t lastMs = millis();
+    #if CAN_STATS_PRINT_MS > 0
+    uint32_t lastPrintMs = lastMs;
+    #endif
+
+    while (1) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CAN_STATS_SAMPLE_MS));
+        uint32_t now = millis();
+
+        meter.sample(CAN_TXFrameCount(), CAN_RXFrameCount(), now - lastMs);
+        lastMs = now;
+        #ifdef SINGLE_PIANO
+        stats.loadPermille = meter.loadPermille(CAN_BITRATE, false);  // Loopback
+        #else
+        stats.loadPermille = meter.loadPermille(CAN_BITRATE);
+        #endif
+        if (stats.loadPermille > stats.peakLoadPermille) {
+            stats.peakLoadPermille = stats.loadPermille;
+        }
+        stats.txPerSecond = meter.txPerSecond();
+        stats.rxPerSecond = meter.rxPerSecond();
+        stats.txActive = meter.txActive();
+        stats.rxActive = meter.rxActive();
+
+        CAN_ErrorStatus error = CAN_GetErrorStatus();
+        stats.tec = error.tec;
+        stats.rec = error.rec;
+        stats.tecPeak = error.tec > stats.tecPeak ? error.tec : stats.tecPeak;
+        stats.recPeak = error.rec > stats.recPeak ? error.rec : stats.recPeak;
+        stats.lastError = error.lastError;
+        stats.state = error.busOff ? CAN_BUS_OFF : error.passive ? CAN_BUS_PASSIVE
+                    : error.warning ? CAN_BUS_WARNING : CAN_BUS_OK;
+        stats.busOffs = CAN_BusOffCount();
+        stats.lost = canRxQueueDrops;
+        stats.overruns = CAN_RXOverrunCount(0) + CAN_RXOverrunCount(1);
+        stats.txQueueFull = CAN_TX_FullCount();
+
+        xSemaphoreTake(sysMutex, portMAX_DELAY);
+        canStats = stats;
+        xSemaphoreGive(sysMutex);
+
+        #if CAN_STATS_PRINT_MS > 0
+        if (now - lastPrintMs >= CAN_STATS_PRINT_MS) {
+            lastPrintMs = now;
+            printCanStats(stats);
+        }
+        #endif
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef CAN_STATS_HPP
+#define CAN_STATS_HPP
+
+#include <cstdint>
+
+// Bus health, for sizing the traffic of large stacks. canStatsTask samples the ES_CAN
+// error and frame counters every CAN_STATS_SAMPLE_MS and keeps the last CAN_STATS_WINDOW
+// samples, so frame rates and bus load cover the last second.
+#define CAN_STATS_SAMPLE_MS 100
+#define CAN_STATS_WINDOW 10
+// Bus time per frame. Every frame is a standard data frame with 8 bytes: 111 bits with
+// the 3-bit intermission, plus up to 24 stuff bits. The worst case keeps the load on the
+// safe side.
+#define CAN_FRAME_BITS 135
+
+enum CanBusState : uint8_t {
+    CAN_BUS_OK,
+    CAN_BUS_WARNING,  // An error counter has reached 96
+    CAN_BUS_PASSIVE,  // An error counter is above 127
+    CAN_BUS_OFF       // Recovering on its own after 128 x 11 recessive bits
+};
+
+struct CanStats {
+    uint16_t loadPermille;      // Share of the bus time used over the window
+    uint16_t peakLoadPermille;  // Highest since start-up
+    uint16_t txPerSecond;
+    uint16_t rxPerSecond;
+    uint8_t tec;
+    uint8_t rec;
+    uint8_t tecPeak;
+    uint8_t recPeak;
+    uint8_t lastError;          // ES_CAN last error code
+    CanBusState state;
+    uint32_t busOffs;
+    uint32_t lost;              // Received frames lost because msgInQ was full
+    uint32_t overruns;          // Receive FIFO overruns, each losing one frame or more
+    uint32_t txQueueFull;       // CAN_TX_Async() calls rejected, retried later
+    bool txActive;              // A frame went out during the window
+    bool rxActive;              // A frame came in during the window
+};
+
+// Frame counts over the last CAN_STATS_WINDOW samples
+class BusLoadMeter {
+public:
+    // Totals of frames sent and received so far, `elapsedMs` after the previous sample
+    void sample(uint32_t txTotal, uint32_t rxTotal, uint32_t elapsedMs);
+    uint16_t txPerSecond() const { return perSecond(txSum); }
+    uint16_t rxPerSecond() const { return perSecond(rxSum); }
+    bool txActive() const { return txSum > 0; }
+    bool rxActive() const { return rxSum > 0; }
+    // Bus time taken by the frames in the window at `bitrate`, in per mille. In loopback
+    // the received frames are our own, so `countRx` leaves them out.
+    uint16_t loadPermille(uint32_t bitrate, bool countRx = true) const;
+
+private:
+    uint16_t perSecond(uint32_t frames) const;
+
+    uint32_t tx[CAN_STATS_WINDOW] = {};
+    uint32_t rx[CAN_STATS_WINDOW] = {};
+    uint32_t ms[CAN_STATS_WINDOW] = {};
+    uint32_t txSum = 0;
+    uint32_t rxSum = 0;
+    uint32_t msSum = 0;
+    uint32_t lastTx = 0;
+    uint32_t lastRx = 0;
+    uint8_t next = 0;
+};
+
+void canStatsTask(void *pvParameters);
+// Latest sample, for the display
+void getCanStats(CanStats& out);
+
+#endif // CAN_STATS_HPP
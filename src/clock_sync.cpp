@@ -0,0 +1,59 @@
+#include "clock_sync.hpp"
+
+static uint32_t magnitude(int32_t value) {
+    return value < 0 ? -(uint32_t)value : value;
+}
+
+// Master time extrapolated from the last sync with its rate estimate
+uint32_t ClockSync::project(const Estimate& estimate, uint32_t localUs) {
+    uint32_t elapsed = localUs - estimate.local;
+    return estimate.master + elapsed + (int32_t)((int64_t)elapsed * estimate.rate / 1000000000);
+}
+
+void ClockSync::publish(const Estimate& estimate) {
+    uint8_t next = active ^ 1;
+    estimates[next] = estimate;
+    __atomic_store_n(&active, next, __ATOMIC_RELEASE);
+}
+
+void ClockSync::receive(uint32_t masterUs, uint32_t localUs) {
+    Estimate estimate = estimates[active];
+    uint32_t elapsed = localUs - estimate.local;
+    int32_t error = estimate.valid ? (int32_t)(masterUs - project(estimate, localUs)) : 0;
+
+    if (!estimate.valid || elapsed >= CLOCK_SYNC_TIMEOUT_MS * 1000 || magnitude(error) > CLOCK_SYNC_STEP_US) {
+        // First sync, a long gap or a master that has jumped: take its time as it is
+        if (estimate.valid) {
+            __atomic_fetch_add(&stepCount, 1, __ATOMIC_RELAXED);
+        }
+        publish({localUs, masterUs, estimate.valid ? estimate.rate : 0, true});
+    } else if (elapsed >= CLOCK_SYNC_MS * 1000 / 4) {
+        // The error built up over `elapsed` is a frequency error of error / elapsed.
+        // Syncs much closer together than the interval are duplicates and skipped.
+        int64_t rate = estimate.rate + ((int64_t)error * 1000000000 / elapsed >> CLOCK_SYNC_KI_SHIFT);
+        if (rate > CLOCK_SYNC_MAX_PPB) rate = CLOCK_SYNC_MAX_PPB;
+        if (rate < -CLOCK_SYNC_MAX_PPB) rate = -CLOCK_SYNC_MAX_PPB;
+        publish({localUs, project(estimate, localUs) + (error >> CLOCK_SYNC_KP_SHIFT), (int32_t)rate, true});
+    }
+
+    int32_t average = __atomic_load_n(&errorAvgQ4, __ATOMIC_RELAXED);
+    average += ((int32_t)(magnitude(error) << 4) - average) >> 3;
+    __atomic_store_n(&errorAvgQ4, (uint32_t)average, __ATOMIC_RELAXED);
+    __atomic_store_n(&lastError, error, __ATOMIC_RELAXED);
+}
+
+uint32_t ClockSync::masterTime(uint32_t localUs) const {
+    Estimate estimate = current();
+    return estimate.valid ? project(estimate, localUs) : localUs;
+}
+
+bool ClockSync::locked(uint32_t localUs) const {
+    Estimate estimate = current();
+    return estimate.valid && localUs - estimate.local < CLOCK_SYNC_TIMEOUT_MS * 1000;
+}
+
+void ClockSync::reset() {
+    publish({0, 0, 0, false});
+    __atomic_store_n(&errorAvgQ4, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&lastError, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,64 @@
+#ifndef CLOCK_SYNC_HPP
+#define CLOCK_SYNC_HPP
+
+#include <cstdint>
+
+// Shared clock for tempo-locked features on separate modules. The westmost module is the
+// master and broadcasts a sync frame every CLOCK_SYNC_MS. Its transmit interrupt notes
+// when each sync has actually left, and the next sync carries that time, so queueing and
+// arbitration delays drop out. Every other module stamps the syncs in its receive
+// interrupt and runs a phase-locked loop against its own timer: each pair of stamps moves
+// the phase by 1/2^CLOCK_SYNC_KP_SHIFT of the error and the rate by 1/2^CLOCK_SYNC_KI_SHIFT
+// of the frequency error it implies, so interrupt latency jitter is averaged out while
+// the crystal drift between the modules is tracked.
+#define CLOCK_SYNC_MS 100            // Master sync interval
+#define CLOCK_SYNC_STEP_US 2000      // A larger error jumps to the master time instead of slewing
+#define CLOCK_SYNC_TIMEOUT_MS 1000   // Without a sync for this long, the follower unlocks
+#define CLOCK_SYNC_MAX_PPB 500000    // Rate correction limit, well beyond crystal tolerance
+#define CLOCK_SYNC_KP_SHIFT 2
+#define CLOCK_SYNC_KI_SHIFT 6
+
+class ClockSync {
+public:
+    // Follower: an event the master saw at its time `masterUs` and we saw at `localUs`
+    void receive(uint32_t masterUs, uint32_t localUs);
+    // Master time at local time `localUs`; the local time itself until locked.
+    // Safe to call from any task.
+    uint32_t masterTime(uint32_t localUs) const;
+    bool locked(uint32_t localUs) const;
+    void reset();
+
+    // Smoothed magnitude of the error seen at each sync, in us. It includes the latency
+    // jitter of the sync frames, so the clocks agree at least this well on average.
+    uint32_t errorUs() const { return __atomic_load_n(&errorAvgQ4, __ATOMIC_RELAXED) >> 4; }
+    int32_t lastErrorUs() const { return __atomic_load_n(&lastError, __ATOMIC_RELAXED); }
+    int32_t ratePpb() const { return current().rate; }
+    uint32_t steps() const { return __atomic_load_n(&stepCount, __ATOMIC_RELAXED); }
+
+private:
+    struct Estimate {
+        uint32_t local;   // Local time of the last sync
+        uint32_t master;  // Master time at that instant
+        int32_t rate;     // Master ticks per local tick - 1, in parts per billion
+        bool valid;
+    };
+    static uint32_t project(const Estimate& estimate, uint32_t localUs);
+    const Estimate& current() const { return estimates[__atomic_load_n(&active, __ATOMIC_ACQUIRE)]; }
+    void publish(const Estimate& estimate);
+
+    // receive() writes the inactive copy and then flips `active`, so readers in other
+    // tasks never see a half-written estimate and never wait
+    Estimate estimates[2] = {};
+    uint8_t active = 0;
+
+    uint32_t errorAvgQ4 = 0;   // Mean |error| in 1/16 us
+    int32_t lastError = 0;
+    uint32_t stepCount = 0;
+};
+
+extern ClockSync clockSync;  // Fed by CAN_RX_Task
+
+// Shared time base: micros() on the master, the master's micros() on a locked follower
+uint32_t syncedMicros();
+
+#endif // CLOCK_SYNC_HPP
@@ -4,8 +4,13 @@
 // Single Piano
 #define SINGLE_PIANO
 // #define DUAL_PIANO
-
-#define LEFT_PIANO
+// The CAN bit rate is CAN_BITRATE in the build_flags of platformio.ini, shared with ES_CAN
+#define BASE_OCTAVE 4  // Octave of the westmost module, found by handshaking; each module east is one higher
+                       // (a stack of more than 9 - BASE_OCTAVE modules starts lower, src/handshake.hpp)
+// Distributed polyphony: every module renders a share of the stack's notes on its own
+// speaker, instead of the westmost module playing the highest note alone
+// #define DISTRIBUTED_VOICES
+#define VOICES_PER_MODULE 4  // Notes rendered at once per module, at most 15
 // Uncomment to enable the test
 // #define TEST_DISPLAY
 // #define TEST_SCAN_KEYS
@@ -14,9 +19,39 @@
 // #define TEST_CAN_RX_ISR
 // #define TEST_CAN_TX
 // #define TEST_CAN_RX
+// #define TEST_FFT
+// #define TEST_CAN_THROUGHPUT
+
+// MIDI in and out on the serial port instead of text (src/midi.hpp). A serial-MIDI bridge
+// on the host connects it to other MIDI software at 115200 baud.
+// #define SERIAL_MIDI
+#define MIDI_CHANNEL 1  // Output channel, 1-16; notes are received on every channel
+
+// Bus load, error counters and bus-off count over serial (src/can_stats.hpp), 0 to disable
+#ifdef SERIAL_MIDI
+#define CAN_STATS_PRINT_MS 0  // The port carries MIDI
+#else
+#define CAN_STATS_PRINT_MS 1000
+#endif
+
+// Record CAN timing into the trace ring and print it from traceDrainTask (tools/trace_decode.cpp)
+// #define TRACE
+#if defined(TRACE) && defined(SERIAL_MIDI)
+#error "TRACE prints over the serial port, which carries MIDI with SERIAL_MIDI"
+#endif
+
+// Key scan timing: a switch must be stable for DEBOUNCE_MS before a change is reported
+#define SCAN_INTERVAL_MS 2
+#define DEBOUNCE_MS 10
+
+// StackSynth v2: read the knobs from the PCAL6408A on change instead of the key matrix
+// #define PCAL_KNOBS
+#define KNOB_POLL_MS 20  // Fallback read interval if a knob interrupt is missed
+
+// I2C bus clock: 400000 (Fast-mode) or 1000000 (Fast-mode Plus, if the display module allows it)
+#define I2C_CLOCK_HZ 400000
 
 // Uncomment to disable the feature
-#define RIGHT_PIANO
 // #define DISABLE_THREADS  // Define it here so it's included in all files
 // #define DISABLE_SAMPLE_ISR  // Define it here so it's included in all files
 // #define DISABLE_CAN_TX_ISR
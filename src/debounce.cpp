@@ -0,0 +1,37 @@
+#include "debounce.hpp"
+
+Debouncer::Debouncer(uint8_t stableSamples, uint32_t mask, uint32_t initial)
+    : plane{0, 0, 0, 0}, debounced(initial & mask), mask(mask), threshold(1) {
+    setStableSamples(stableSamples);
+}
+
+void Debouncer::setStableSamples(uint8_t stableSamples) {
+    if (stableSamples < 1) stableSamples = 1;
+    if (stableSamples > MAX_SAMPLES) stableSamples = MAX_SAMPLES;
+    threshold = stableSamples;
+    for (int p = 0; p < 4; p++) plane[p] = 0;
+}
+
+uint32_t Debouncer::update(uint32_t raw) {
+    // Inputs that currently disagree with their debounced state
+    uint32_t delta = (raw ^ debounced) & mask;
+
+    // Inputs that agree reset their counter, the rest count up by one (ripple carry)
+    uint32_t carry = delta;
+    for (int p = 0; p < 4; p++) {
+        plane[p] &= delta;
+        uint32_t nextCarry = plane[p] & carry;
+        plane[p] ^= carry;
+        carry = nextCarry;
+    }
+
+    // Inputs whose counter has reached the threshold flip state and restart
+    uint32_t toggled = delta;
+    for (int p = 0; p < 4; p++) {
+        toggled &= ((threshold >> p) & 1) ? plane[p] : ~plane[p];
+    }
+    debounced ^= toggled;
+    for (int p = 0; p < 4; p++) plane[p] &= ~toggled;
+
+    return toggled;
+}
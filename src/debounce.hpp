@@ -0,0 +1,35 @@
+#ifndef DEBOUNCE_HPP
+#define DEBOUNCE_HPP
+
+#include <cstdint>
+
+// Bit-parallel debouncer for up to 32 inputs using vertical counters.
+// Each input has a 4-bit counter spread across four bit planes, so all inputs
+// are filtered with a handful of word-wide logic ops instead of a per-key loop.
+// An input only changes its debounced state after it has disagreed with that
+// state for `stableSamples` consecutive calls to update().
+class Debouncer {
+public:
+    static const uint8_t MAX_SAMPLES = 15;  // Largest count a 4-plane counter can hold
+
+    explicit Debouncer(uint8_t stableSamples, uint32_t mask = 0xFFFFFFFF, uint32_t initial = 0);
+
+    // Feed one raw sample. Returns the bits whose debounced state toggled.
+    uint32_t update(uint32_t raw);
+
+    // Current debounced state (only bits within the mask are meaningful).
+    uint32_t state() const { return debounced; }
+
+    // Replace the raw bits outside the mask with the debounced ones inside it.
+    uint32_t merge(uint32_t raw) const { return (raw & ~mask) | debounced; }
+
+    void setStableSamples(uint8_t stableSamples);
+
+private:
+    uint32_t plane[4];   // Counter bit planes, plane[0] is the LSB
+    uint32_t debounced;
+    uint32_t mask;
+    uint8_t threshold;
+};
+
+#endif // DEBOUNCE_HPP
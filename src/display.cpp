@@ -1,38 +1,240 @@
 #include "config.hpp"
 #include "display.hpp"
 #include "system.hpp"
+#include "params.hpp"
+#include "tile_diff.hpp"
+#include "i2c_dma.hpp"
+#include "audio.hpp"
+#include "fft.hpp"
+#include "widgets.hpp"
+#include "clock_sync.hpp"
+#include "can_stats.hpp"
 #include <Arduino.h>
 #include <bitset>
-#include <string>
+#include <cstdio>
 
-U8G2_SSD1305_128X32_ADAFRUIT_F_HW_I2C u8g2(U8G2_R0);
+U8G2 u8g2;  // SSD1305 128x32, set up in displayUpdateTask with the DMA byte callback
 
 bool waiting_for_user = false;
 bool playing_music = false;
 bool correct_guess = false;
-std::string correct_answer = "";
-
-void displayCurrentNote(const std::bitset<12>& keyStates) {
-    const char* noteNames[12] = {
-        "C ", "C#", "D ", "D#", "E ", "F ",
-        "F#", "G ", "G#", "A ", "A#", "B "
-    };
-    u8g2.setCursor(60, 30);
-    bool foundNote = false;
-    for (int i = 0; i < 12; i++) {
-        if (keyStates[i]) {
-            u8g2.print(noteNames[i]);
-            foundNote = true;
+const char* volatile correct_answer = "";
+
+// The bottom line shows whichever parameter was changed last (volume at start-up)
+static uint8_t shownParam = PARAM_VOLUME;
+
+static void onParamChange(ParamId id, int32_t value, void* context) {
+    __atomic_store_n(&shownParam, id, __ATOMIC_RELAXED);
+}
+
+// Last rendered audio as a waveform, one sample per pixel column
+static void drawScope(const uint8_t* samples) {
+    uint8_t previous = 31 - (samples[0] >> 3);
+    for (uint8_t x = 1; x < SCOPE_SAMPLES; x++) {
+        uint8_t y = 31 - (samples[x] >> 3);
+        u8g2.drawLine(x - 1, previous, x, y);
+        previous = y;
+    }
+}
+
+// Hann-windowed FFT of the last rendered audio, one 2 px bar per bin on a log scale
+static void drawSpectrum(const uint8_t* samples) {
+    static int16_t re[SCOPE_SAMPLES];
+    static int16_t im[SCOPE_SAMPLES];
+    const uint8_t log2n = 31 - __builtin_clz(SCOPE_SAMPLES);
+    for (uint8_t i = 0; i < SCOPE_SAMPLES; i++) {
+        re[i] = ((int16_t)samples[i] - 128) << 7;
+        im[i] = 0;
+    }
+    fftWindow(re, log2n);
+    fft(re, im, log2n);
+
+    const uint8_t bins = SCOPE_SAMPLES / 2;
+    const uint8_t barWidth = 128 / bins;
+    for (uint8_t k = 1; k < bins; k++) {
+        uint16_t magnitude = fftMagnitude(re[k], im[k]);
+        // 2.5 px per octave of magnitude: full scale is about 2^13
+        uint8_t height = (32 - __builtin_clz((uint32_t)magnitude | 1)) * 5 / 2;
+        if (height > 32) height = 32;
+        if (height > 0) {
+            u8g2.drawBox(k * barWidth, 32 - height, barWidth, height);
         }
     }
-    if (!foundNote) {
-        u8g2.print("No Note");
+}
+
+#define FONT u8g2_font_ncenB08_tr
+
+// Status screen, laid out on the three 10 px text rows
+static Label keysTitle({2, 2, 56, 10}, FONT, "Keys:");
+static Label keysHex({2, 12, 56, 10}, FONT);
+static Label paramLabel({2, 22, 44, 10}, FONT);
+static Meter paramMeter({46, 24, 12, 6});
+static NoteList noteList({60, 22, 68, 10}, FONT);
+static Label txLabel({70, 2, 58, 10}, FONT);
+static Label rxLabel({70, 12, 58, 10}, FONT);
+static Screen statusScreen;
+
+// Hidden game screen: three lines of text
+static Label gameLines[3] = {
+    Label({4, 2, 124, 10}, FONT),
+    Label({4, 12, 124, 10}, FONT),
+    Label({4, 22, 124, 10}, FONT),
+};
+static Screen gameScreen;
+
+// CAN bus health: load, frame rates and losses, error counters
+static Label canLines[3] = {
+    Label({2, 2, 126, 10}, FONT),
+    Label({2, 12, 126, 10}, FONT),
+    Label({2, 22, 126, 10}, FONT),
+};
+static Screen canScreen;
+
+static Screen* activeScreen = nullptr;  // Null while a full-redraw view is shown
+
+static void initScreens() {
+    static bool initialised = false;  // TEST_DISPLAY enters the task repeatedly
+    if (initialised) {
+        return;
+    }
+    initialised = true;
+    Widget* status[] = {&keysTitle, &keysHex, &paramLabel, &paramMeter, &noteList, &txLabel, &rxLabel};
+    for (Widget* widget : status) {
+        statusScreen.add(*widget);
+    }
+    for (Label& line : gameLines) {
+        gameScreen.add(line);
+    }
+    for (Label& line : canLines) {
+        canScreen.add(line);
     }
 }
 
+// Switching screens starts from an empty buffer with every widget dirty
+static void showScreen(Screen* screen) {
+    if (screen != activeScreen) {
+        u8g2.clearBuffer();
+        if (screen) {
+            screen->invalidate();
+        }
+        activeScreen = screen;
+    }
+}
+
+static void updateStatusScreen(const std::bitset<12>& keys, ParamId param, int32_t value) {
+    char text[Label::MAX_TEXT];
+    snprintf(text, sizeof(text), "%lX", keys.to_ulong());
+    keysHex.setText(text);
+    noteList.setKeys(keys.to_ulong());
+
+    const ParamInfo& info = ParamRegistry::info(param);
+    snprintf(text, sizeof(text), "%s:%ld", info.name, (long)value);
+    paramLabel.setText(text);
+    paramMeter.setValue(value - info.min, info.max - info.min);
+
+    // Traffic in the last second, not just since start-up
+    CanStats stats;
+    getCanStats(stats);
+    txLabel.setText(stats.state == CAN_BUS_OFF ? "TX: Off" : stats.txActive ? "TX: OK" : "TX: Fail");
+    if (clockSync.locked(micros())) {
+        snprintf(text, sizeof(text), "RX: %luus", (unsigned long)clockSync.errorUs());  // Clock sync error
+        rxLabel.setText(text);
+    } else {
+        rxLabel.setText(stats.rxActive ? "RX: OK" : "RX: Fail");
+    }
+}
+
+// A counter in at most 4 characters: 9999, then 12k, 345M, 4G
+static void formatCount(uint32_t count, char (&out)[5]) {
+    static const char SUFFIXES[] = " kMG";
+    uint8_t scale = 0;
+    if (count >= 10000) {
+        while (count >= 1000) {
+            count /= 1000;
+            scale++;
+        }
+    }
+    char digits[4];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + count % 10;
+        count /= 10;
+    } while (count);
+    uint8_t length = 0;
+    while (n) {
+        out[length++] = digits[--n];
+    }
+    if (scale) {
+        out[length++] = SUFFIXES[scale];
+    }
+    out[length] = '\0';
+}
+
+// Every line fits in a Label at any count, so nothing is cut off as the counters grow
+static void updateCanScreen() {
+    static const char* const STATE_NAMES[] = {"OK", "Warn", "Pass", "Off"};
+    CanStats stats;
+    getCanStats(stats);
+    char text[Label::MAX_TEXT];
+    char tx[5], rx[5], dropped[5], busOffs[5];
+    snprintf(text, sizeof(text), "Load %u.%u%% pk %u.%u%%", stats.loadPermille / 10, stats.loadPermille % 10,
+             stats.peakLoadPermille / 10, stats.peakLoadPermille % 10);
+    canLines[0].setText(text);
+    formatCount(stats.txPerSecond, tx);
+    formatCount(stats.rxPerSecond, rx);
+    snprintf(text, sizeof(text), "TX %s RX %s/s %s", tx, rx, STATE_NAMES[stats.state]);
+    canLines[1].setText(text);
+    // Frames lost to a full msgInQ and FIFO overruns together; serial has them apart
+    uint32_t lost = stats.lost + stats.overruns;
+    formatCount(lost < stats.lost ? UINT32_MAX : lost, dropped);
+    formatCount(stats.busOffs, busOffs);
+    snprintf(text, sizeof(text), "E%u/%u dr%s bo%s", stats.tec, stats.rec, dropped, busOffs);
+    canLines[2].setText(text);
+}
+
+static void setGameLines(const char* first, const char* second = "", const char* third = "") {
+    gameLines[0].setText(first);
+    gameLines[1].setText(second);
+    gameLines[2].setText(third);
+}
+
+static void updateGameScreen() {
+    if (waiting_for_user) {
+        setGameLines("Please make ", "your guess");
+    } else if (playing_music) {
+        setGameLines("Playing music");
+    } else if (correct_answer[0] == '\0') {
+        setGameLines("Welcome to our", "Hidden Game!");  // No round has finished yet
+    } else if (correct_guess) {
+        setGameLines("Correct Guess");
+    } else {
+        setGameLines("Wrong Guess", "Correct Guess was", correct_answer);
+    }
+}
+
+volatile uint32_t displayBytesLast = 0;
+static TileDiff tileDiff;
+
+// Send only the 8x8 tiles that changed since the last frame. Each I2C transaction
+// takes the bus on its own, so the knob expander waits for at most one transaction.
+static void sendFrame() {
+    TileRun runs[TileDiff::MAX_RUNS];
+    uint8_t count = tileDiff.diff(u8g2.getBufferPtr(), runs);
+    for (uint8_t i = 0; i < count; i++) {
+        u8g2.updateDisplayArea(runs[i].x, runs[i].y, runs[i].width, 1);
+    }
+    displayBytesLast = TileDiff::transferBytes(runs, count);
+}
+
 void displayUpdateTask(void *pvParameters) {
+    u8g2_Setup_ssd1305_i2c_128x32_adafruit_f(u8g2.getU8g2(), U8G2_R0,
+                                             u8x8_byte_stm32_dma_i2c, u8x8_gpio_and_delay_arduino);
     u8g2.begin();
+    tileDiff.invalidate();  // begin() clears the panel, so the first frame is sent in full
     delayMicroseconds(10);
+    fftInit();
+    initScreens();
+    params.addListener(onParamChange);
     const TickType_t xFrequency = 30 / portTICK_PERIOD_MS;
     TickType_t xLastWakeTime = xTaskGetTickCount();
     
@@ -44,82 +246,39 @@ void displayUpdateTask(void *pvParameters) {
         xSemaphoreTake(sysState.mutex, portMAX_DELAY);
         std::bitset<12> localKeys = sysState.keyStates;
         bool isGame = sysState.areAllKnobSPressed;
-        int localKnob = sysState.knob3Rotation;
-        bool gameOverride = sysState.gameActiveOverride;
+        uint8_t view = sysState.displayView;
         xSemaphoreGive(sysState.mutex);
+        ParamId localParam = (ParamId)__atomic_load_n(&shownParam, __ATOMIC_RELAXED);
+        int32_t localValue = params.get(localParam);
         
-        u8g2.clearBuffer();
-
-        if (!isGame){
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(2, 10, "Keys:");
-            u8g2.setCursor(2, 20);
-            u8g2.print(localKeys.to_ulong(), HEX);
-            displayCurrentNote(localKeys);
-            
-            // Display knob rotation
-            u8g2.setCursor(2, 30);
-            u8g2.print("Knob:");
-            u8g2.print(localKnob);
-            
-            // Display CAN status
-            u8g2.setCursor(70, 10);
-            u8g2.print("TX: ");
-            u8g2.print(canTxSuccess ? "OK" : "Fail");
-
-            u8g2.setCursor(70, 20);
-            u8g2.print("RX: ");
-            u8g2.print(canRxSuccess ? "OK" : "Fail");
-
-            u8g2.sendBuffer();
-        
-            digitalToggle(LED_BUILTIN);
-
-        } else if (!isGame) {
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(4, 10, "Welcome to our");
-            u8g2.drawStr(4, 20, "Hidden Game!");
-            u8g2.sendBuffer();
-
-            digitalToggle(LED_BUILTIN);
-        } else if (waiting_for_user){
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(4, 10, "Please make ");
-            u8g2.drawStr(4, 20, "your guess");
-            u8g2.sendBuffer();
-
-            digitalToggle(LED_BUILTIN);
-        } else if (playing_music){
-            u8g2.clearBuffer();
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(4, 10, "Playing music");
-            u8g2.sendBuffer();
-
-            digitalToggle(LED_BUILTIN);
-        } else if (correct_guess) {
-            u8g2.clearBuffer();
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(4, 10, "Correct Guess");
-            u8g2.sendBuffer();
-
-            digitalToggle(LED_BUILTIN);
-        } else if (!correct_guess){
-            u8g2.clearBuffer();
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(4, 10, "Wrong Guess");
-            u8g2.drawStr(4, 20, "Correct Guess was");
-            u8g2.drawStr(4, 30, correct_answer.c_str());
-            u8g2.sendBuffer();
-
-            digitalToggle(LED_BUILTIN);
+        if (isGame) {
+            showScreen(&gameScreen);
+            updateGameScreen();
+            gameScreen.render(u8g2.getU8g2());
+        } else if (view == VIEW_STATUS) {
+            showScreen(&statusScreen);
+            updateStatusScreen(localKeys, localParam, localValue);
+            statusScreen.render(u8g2.getU8g2());
+        } else if (view == VIEW_CAN) {
+            showScreen(&canScreen);
+            updateCanScreen();
+            canScreen.render(u8g2.getU8g2());
         } else {
-            u8g2.clearBuffer();
-            u8g2.setFont(u8g2_font_ncenB08_tr);
-            u8g2.drawStr(4, 10, "how are you here");
-            u8g2.sendBuffer();
-
-            digitalToggle(LED_BUILTIN);
+            // The scope and spectrum change every frame, so they are redrawn in full
+            uint8_t samples[SCOPE_SAMPLES];
+            showScreen(nullptr);
+            if (copyScopeSamples(samples)) {
+                u8g2.clearBuffer();
+                if (view == VIEW_SCOPE) {
+                    drawScope(samples);
+                } else {
+                    drawSpectrum(samples);
+                }
+            }
         }
+        sendFrame();  // Sends nothing if no tile changed
+
+        digitalToggle(LED_BUILTIN);
 
         #ifdef TEST_DISPLAY
         break;
@@ -1,11 +1,14 @@
 #ifndef DISPLAY_HPP
 #define DISPLAY_HPP
-#include <string>
+#include <cstdint>
+
+enum DisplayView : uint8_t { VIEW_STATUS, VIEW_SCOPE, VIEW_SPECTRUM, VIEW_CAN, VIEW_COUNT };
 
 void displayUpdateTask(void *pvParameters);
 extern bool waiting_for_user;
 extern bool playing_music;
 extern bool correct_guess;
-extern std::string correct_answer; 
+extern const char* volatile correct_answer;  // Name of the last note to guess, "" before the first round
+extern volatile uint32_t displayBytesLast;  // I2C bytes sent for the last frame
 
 #endif // DISPLAY_HPP
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef EVENT_RING_HPP
+#define EVENT_RING_HPP
+
+#include <cstdint>
+
+// Lock-free ring buffer with one producer and a fixed number of independent readers.
+// Every reader sees every item, so one stream can feed several consumers without copies.
+// The producer never overwrites an item that any reader has not yet consumed; push()
+// fails instead and the drop is counted. Safe to use between tasks and ISRs as long as
+// there is only one producer and each reader index is used by only one consumer.
+template <typename T, uint32_t SIZE, uint32_t READERS>
+class EventRing {
+    static_assert(SIZE && (SIZE & (SIZE - 1)) == 0, "EventRing size must be a power of two");
+
+public:
+    bool push(const T& item) {
+        uint32_t head = __atomic_load_n(&writeIdx, __ATOMIC_RELAXED);
+        for (uint32_t r = 0; r < READERS; r++) {
+            if (head - __atomic_load_n(&readIdx[r], __ATOMIC_ACQUIRE) >= SIZE) {
+                __atomic_fetch_add(&dropCount, 1, __ATOMIC_RELAXED);
+                return false;
+            }
+        }
+        buffer[head & (SIZE - 1)] = item;
+        __atomic_store_n(&writeIdx, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool pop(uint32_t reader, T& item) {
+        uint32_t tail = __atomic_load_n(&readIdx[reader], __ATOMIC_RELAXED);
+        if (tail == __atomic_load_n(&writeIdx, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        item = buffer[tail & (SIZE - 1)];
+        __atomic_store_n(&readIdx[reader], tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool empty(uint32_t reader) const {
+        return __atomic_load_n(&readIdx[reader], __ATOMIC_RELAXED) ==
+               __atomic_load_n(&writeIdx, __ATOMIC_ACQUIRE);
+    }
+
+    uint32_t dropped() const { return __atomic_load_n(&dropCount, __ATOMIC_RELAXED); }
+
+private:
+    T buffer[SIZE];
+    uint32_t writeIdx = 0;
+    uint32_t readIdx[READERS] = {};
+    uint32_t dropCount = 0;
+};
+
+#endif // EVENT_RING_HPP
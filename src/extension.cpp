@@ -3,34 +3,42 @@
 #include "audio.hpp"
 #include "system.hpp"
 #include "display.hpp"
+#include "notes.hpp"
+#include "config.hpp"
 #include <STM32FreeRTOS.h>
-#include <random>
 #include <cmath>
-#include <string>
 #include <array>
-#include <cstdlib>
 #include <utility>
-#include <vector>
 
-std::pair<int, size_t> getRandomNote() {
-    static bool seeded = false;
-    if (!seeded) {
-        srand(analogRead(A0));  // Seed using an unconnected analog pin for randomness
-        seeded = true;
+// Game progress over serial, unless the port carries MIDI
+static void gameMessage(const char* text) {
+    #ifndef SERIAL_MIDI
+    Serial.println(text);
+    #endif
+}
+
+// xorshift32 instead of rand(): newlib-nano allocates the rand() state on first use,
+// which is after lockHeap() in the static build
+static uint32_t randomState = 0;
+
+static uint32_t nextRandom() {
+    if (!randomState) {
+        randomState = micros() | 1;  // Seed from the time of the first game, A0 now belongs to the joystick ADC
     }
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
 
+std::pair<int, size_t> getRandomNote() {
     std::array<uint32_t, 12> randomNotes = getArray();
     // if (randomNotes.empty()) return -1;  // Handle edge case
 
-    size_t randomIndex = rand() % randomNotes.size();  // Generate a random index
+    size_t randomIndex = nextRandom() % randomNotes.size();  // Generate a random index
     return {randomNotes[randomIndex], randomIndex};
 }
 
-std::string indexToNoteName(size_t index) {
-    std::vector<std::string> noteNames = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
-    return noteNames[index];
-}
-
 void gameTask(void *pvParameters) {
     std::array<uint32_t, 12> randomNotes = getArray();
 
@@ -45,11 +53,10 @@ void gameTask(void *pvParameters) {
 
         while (gameActive) {
             if (firstRun) {
-                Serial.println("Game started!");
+                gameMessage("Game started!");
                 std::pair<int, size_t> randomNoteResult = getRandomNote();
                 randomNote = randomNoteResult.first;
                 noteIndex = randomNoteResult.second;
-                // std::string noteName = frequencyToNoteName(randomNote);
                 // noteIndex = noteNameToIndex(noteName);
                 xSemaphoreTake(sysState.mutex, portMAX_DELAY);
                 sysState.gameActiveOverride = true;
@@ -76,7 +83,7 @@ void gameTask(void *pvParameters) {
             xSemaphoreGive(sysState.mutex);
 
             while (userKeys.none() and gameActive) {  // .none() returns true if all bits are 0 (i.e., no key is pressed)
-                Serial.println("Waiting for key press...");
+                gameMessage("Waiting for key press...");
                 waiting_for_user = true;
                 xSemaphoreTake(sysState.mutex, portMAX_DELAY);
                 userKeys = sysState.keyStates;  // Refresh the key states
@@ -90,17 +97,17 @@ void gameTask(void *pvParameters) {
                 waiting_for_user = false;
                 if (userKeys[noteIndex] == 1) {  // Check if the key is pressed
                     correct_guess = true;
-                    Serial.println("Correct key pressed!");
+                    gameMessage("Correct key pressed!");
                 } else {
                     correct_guess = false;
-                    Serial.println("Wrong key pressed!");
+                    gameMessage("Wrong key pressed!");
                 }
-                correct_answer = indexToNoteName(noteIndex);
+                correct_answer = noteName(noteIndex);  // Pointer store, read by the display task
                 firstRun = true;  // Reset the game for the next round
             }
 
             // **Prepare for the next round**
-            Serial.println("Next round starting...");
+            gameMessage("Next round starting...");
             vTaskDelay(pdMS_TO_TICKS(3000));  // Allow a small delay before the next round starts
 
              // **Check if the user pressed all knobs to exit game**
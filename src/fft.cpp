@@ -0,0 +1,61 @@
+#include "fft.hpp"
+#include <cmath>
+
+static const uint16_t FFT_MAX_N = 1 << FFT_MAX_LOG2;
+
+static int16_t sineTable[FFT_MAX_N * 3 / 4];  // sin(2 pi k / N) in Q15, cos(x) = sin(x + N/4)
+static int16_t hannTable[FFT_MAX_N];
+
+void fftInit() {
+    for (uint16_t k = 0; k < FFT_MAX_N * 3 / 4; k++) {
+        sineTable[k] = (int16_t)lround(32767.0 * sin(2.0 * M_PI * k / FFT_MAX_N));
+    }
+    for (uint16_t k = 0; k < FFT_MAX_N; k++) {
+        hannTable[k] = (int16_t)lround(32767.0 * (0.5 - 0.5 * cos(2.0 * M_PI * k / FFT_MAX_N)));
+    }
+}
+
+void fftWindow(int16_t* re, uint8_t log2n) {
+    uint8_t stride = FFT_MAX_LOG2 - log2n;
+    for (uint16_t i = 0; i < (1u << log2n); i++) {
+        re[i] = ((int32_t)re[i] * hannTable[i << stride]) >> 15;
+    }
+}
+
+void fft(int16_t* re, int16_t* im, uint8_t log2n) {
+    uint16_t n = 1 << log2n;
+
+    // Bit-reversed reordering
+    for (uint16_t i = 1, j = 0; i < n; i++) {
+        uint16_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            int16_t t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    // Butterflies, with a shift of one bit per stage
+    for (uint8_t stage = 1; stage <= log2n; stage++) {
+        uint16_t half = 1 << (stage - 1);
+        uint16_t step = FFT_MAX_N >> stage;  // Twiddle index stride
+        for (uint16_t k = 0; k < half; k++) {
+            int32_t wr = sineTable[k * step + FFT_MAX_N / 4];  // cos
+            int32_t wi = -sineTable[k * step];                 // -sin
+            for (uint16_t i = k; i < n; i += 2 * half) {
+                uint16_t j = i + half;
+                int32_t tr = (wr * re[j] - wi * im[j]) >> 15;
+                int32_t ti = (wr * im[j] + wi * re[j]) >> 15;
+                int32_t ur = re[i];
+                int32_t ui = im[i];
+                re[i] = (ur + tr) >> 1;
+                im[i] = (ui + ti) >> 1;
+                re[j] = (ur - tr) >> 1;
+                im[j] = (ui - ti) >> 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <cstdint>
+
+#define FFT_MAX_LOG2 8  // Up to 256 points, 128 bins
+
+// Fixed-point radix-2 FFT for the spectrum view. Samples are Q15; every stage halves
+// the values so the output is the DFT divided by the size and can never overflow.
+void fftInit();  // Build the twiddle and window tables
+
+// Multiply real samples by a Hann window of size 2^log2n
+void fftWindow(int16_t* re, uint8_t log2n);
+
+// In-place decimation-in-time transform of 2^log2n complex Q15 values
+void fft(int16_t* re, int16_t* im, uint8_t log2n);
+
+// Approximate |re + j*im| (max + min / 2 is within 12%, without a square root)
+inline uint16_t fftMagnitude(int16_t re, int16_t im) {
+    uint16_t a = re < 0 ? -re : re;
+    uint16_t b = im < 0 ? -im : im;
+    return a > b ? a + (b >> 1) : b + (a >> 1);
+}
+
+#endif // FFT_HPP
@@ -0,0 +1,33 @@
+#ifndef FIXED_POINT_HPP
+#define FIXED_POINT_HPP
+
+#include <cstdint>
+
+// 2^(k/32) in Q16 for k = 0..32
+static const uint32_t EXP2_TABLE_Q16[33] = {
+    65536, 66971, 68438, 69936, 71468, 73032, 74632, 76266,
+    77936, 79642, 81386, 83169, 84990, 86851, 88752, 90696,
+    92682, 94711, 96785, 98905, 101070, 103283, 105545, 107856,
+    110218, 112631, 115098, 117618, 120194, 122825, 125515, 128263,
+    131072,
+};
+
+// 2^x for x in Q16 octaves, returned in Q16. Table lookup with linear interpolation,
+// accurate to about 0.2 cent. Valid for -16 < x < 15.
+inline uint32_t exp2Q16(int32_t x) {
+    int32_t whole = x >> 16;                  // Floor, so the fraction is always positive
+    uint32_t frac = (uint32_t)x & 0xFFFF;
+    uint32_t index = frac >> 11;              // 32 segments
+    uint32_t weight = frac & 0x7FF;           // Position within the segment, Q11
+    uint32_t low = EXP2_TABLE_Q16[index];
+    uint32_t high = EXP2_TABLE_Q16[index + 1];
+    uint32_t result = low + (((high - low) * weight) >> 11);
+    return whole >= 0 ? result << whole : result >> -whole;
+}
+
+// Frequency ratio for a pitch offset in cents, in Q16
+inline uint32_t centsToRatioQ16(int32_t cents) {
+    return exp2Q16(cents * 65536 / 1200);
+}
+
+#endif // FIXED_POINT_HPP
@@ -0,0 +1,203 @@
+#include "handshake.hpp"
+#include <cstring>
+#include "can_protocol.hpp"
+#include "config.hpp"
+
+// FNV-1a over the 12 bytes of the device ID
+uint32_t Handshake::hashUid(uint32_t w0, uint32_t w1, uint32_t w2) {
+    const uint32_t words[3] = {w0, w1, w2};
+    uint32_t hash = 2166136261u;
+    for (int w = 0; w < 3; w++) {
+        for (int b = 0; b < 4; b++) {
+            hash ^= (words[w] >> (8 * b)) & 0xFF;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+uint8_t Handshake::octaveAt(uint8_t position, uint8_t modules) {
+    uint8_t base = modules + BASE_OCTAVE > KEYSTATE_OCTAVES
+        ? (modules < KEYSTATE_OCTAVES ? KEYSTATE_OCTAVES - modules : 0)
+        : BASE_OCTAVE;
+    return (base + position) % KEYSTATE_OCTAVES;
+}
+
+void Handshake::begin(uint32_t id, uint32_t nowMs, uint32_t settleMs) {
+    memset(uids, 0, sizeof(uids));
+    uid = id;
+    startMs = nowMs;
+    settleTime = settleMs;
+    pos = 0;
+    nextPos = 0;
+    releasing = false;
+    mismatch = false;
+    restartRequested = false;
+    __atomic_store_n(&count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&eastOut, true, __ATOMIC_RELAXED);
+    __atomic_store_n(&mode, SETTLING, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&restarts, 1, __ATOMIC_RELEASE);
+}
+
+void Handshake::place(uint8_t position, bool last, uint32_t nowMs, HandshakeMessage& out) {
+    __atomic_store_n(&pos, position, __ATOMIC_RELAXED);
+    uids[position % MAX_MODULES] = uid;
+    nextPos = position + 1;
+    out = {uid, position, last, HANDSHAKE_ANNOUNCE};
+    if (last) {
+        complete(position + 1, nowMs);
+    } else {
+        // Give the announcement time to reach every module before the neighbour moves on
+        releasing = true;
+        releaseMs = nowMs + HANDSHAKE_RELEASE_MS;
+        placedMs = nowMs;
+        __atomic_store_n(&mode, PLACED, __ATOMIC_RELEASE);
+    }
+}
+
+// Every position is known: hold both outputs on again so the neighbours can see us,
+// and start the presence checks from now
+void Handshake::complete(uint8_t modules, uint32_t nowMs) {
+    releasing = false;
+    mismatch = false;
+    for (uint8_t i = 0; i < MAX_MODULES; i++) {
+        lastSeenMs[i] = nowMs;
+    }
+    heartbeatMs = nowMs;
+    __atomic_store_n(&count, modules, __ATOMIC_RELAXED);
+    __atomic_store_n(&eastOut, true, __ATOMIC_RELAXED);
+    __atomic_store_n(&mode, COMPLETE, __ATOMIC_RELEASE);
+}
+
+bool Handshake::topologyChanged(uint32_t nowMs, bool westIn, bool eastIn) {
+    // A neighbour has been plugged in or pulled out
+    bool expectedWest = pos > 0;
+    bool expectedEast = pos + 1 < count;
+    if (westIn != expectedWest || eastIn != expectedEast) {
+        if (!mismatch) {
+            mismatch = true;
+            mismatchMs = nowMs;
+        }
+        if (nowMs - mismatchMs >= HOTPLUG_DEBOUNCE_MS) {
+            return true;
+        }
+    } else {
+        mismatch = false;
+    }
+
+    // A module has stopped sending heartbeats
+    for (uint8_t i = 0; i < count; i++) {
+        if (i != pos && nowMs - lastSeenMs[i] >= HEARTBEAT_TIMEOUT_MS) {
+            return true;
+        }
+    }
+    return restartRequested;
+}
+
+void Handshake::restart(uint32_t nowMs, HandshakeMessage& out) {
+    out = {uid, pos, false, HANDSHAKE_RESTART};
+    begin(uid, nowMs, HANDSHAKE_RESTART_SETTLE_MS);
+}
+
+bool Handshake::update(uint32_t nowMs, bool westIn, bool eastIn, HandshakeMessage& out) {
+    if (releasing && (int32_t)(nowMs - releaseMs) >= 0) {
+        releasing = false;
+        __atomic_store_n(&eastOut, false, __ATOMIC_RELAXED);
+    }
+
+    switch (mode) {
+        case SETTLING:
+            if (nowMs - startMs < settleTime) {
+                return false;
+            }
+            if (!westIn) {
+                // Westmost, unless the token already reached this module while it was booting
+                place(nextPos, !eastIn, nowMs, out);
+                return true;
+            }
+            __atomic_store_n(&mode, WAITING, __ATOMIC_RELEASE);
+            return false;
+
+        case WAITING:
+            // The west neighbour has announced itself and switched its east output off
+            if (!westIn && nextPos > 0) {
+                place(nextPos, !eastIn, nowMs, out);
+                return true;
+            }
+            // Nobody is detecting: this module was swapped in between two enumerated ones,
+            // whose inputs did not change
+            if (nowMs - startMs >= settleTime + HANDSHAKE_PLACED_TIMEOUT_MS) {
+                restart(nowMs, out);
+                return true;
+            }
+            return false;
+
+        case PLACED:
+            // The last announcement was lost and no heartbeat of the eastmost module has
+            // made up for it, or that module never announced
+            if (nowMs - placedMs >= HANDSHAKE_PLACED_TIMEOUT_MS) {
+                restart(nowMs, out);
+                return true;
+            }
+            return false;
+
+        case COMPLETE:
+            if (topologyChanged(nowMs, westIn, eastIn)) {
+                restart(nowMs, out);
+                return true;
+            }
+            if ((int32_t)(nowMs - heartbeatMs) >= 0) {
+                heartbeatMs = nowMs + HEARTBEAT_MS;
+                out = {uid, pos, pos + 1 == count, HANDSHAKE_HEARTBEAT};
+                return true;
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+void Handshake::receive(const HandshakeMessage& msg, uint32_t nowMs) {
+    if (msg.uid == uid || msg.position >= MAX_MODULES) {
+        return;  // Own message in loopback, or out of range
+    }
+
+    switch (msg.kind) {
+        case HANDSHAKE_ANNOUNCE:
+            uids[msg.position] = msg.uid;
+            if (msg.position + 1 > nextPos) {
+                nextPos = msg.position + 1;
+            }
+            if (msg.last && mode == PLACED) {
+                complete(msg.position + 1, nowMs);
+            }
+            break;
+
+        case HANDSHAKE_HEARTBEAT:
+            if (mode == PLACED && msg.last && msg.position > pos) {
+                // The others completed without us: the eastmost heartbeat carries the count
+                uids[msg.position] = msg.uid;
+                complete(msg.position + 1, nowMs);
+                lastSeenMs[msg.position] = nowMs;
+                break;
+            }
+            if (mode != COMPLETE) {
+                break;
+            }
+            // A module we did not enumerate, or one that has moved, means the topology changed
+            if (msg.position >= count || uids[msg.position] != msg.uid) {
+                restartRequested = true;
+            } else {
+                lastSeenMs[msg.position] = nowMs;
+            }
+            break;
+
+        case HANDSHAKE_RESTART:
+            // Several modules may notice the same change; one restart is enough
+            if (mode != SETTLING || settleTime != HANDSHAKE_RESTART_SETTLE_MS) {
+                begin(uid, nowMs, HANDSHAKE_RESTART_SETTLE_MS);
+            }
+            break;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef HANDSHAKE_HPP
+#define HANDSHAKE_HPP
+
+#include <cstdint>
+
+// Module position detection with the east/west handshake signals (doc/handshaking.md).
+// Every module starts with both outputs on. After HANDSHAKE_SETTLE_MS the module with no
+// west input takes position 0, announces itself on CAN and then switches its east output
+// off. That clears the west input of its neighbour, which takes the next position and
+// passes the token on, until the module with no east input announces the last position.
+//
+// Once complete, every module switches its outputs back on and keeps watching its inputs
+// and the presence heartbeats of the others. A neighbour appearing or disappearing, or a
+// module going silent, makes the module that notices broadcast a restart, and every
+// module runs the detection again with the shorter HANDSHAKE_RESTART_SETTLE_MS.
+#define HANDSHAKE_SETTLE_MS 1000        // Time for every module to boot and switch its outputs on
+#define HANDSHAKE_RESTART_SETTLE_MS 200 // Settle time when re-enumerating at runtime
+#define HANDSHAKE_RELEASE_MS 10         // Delay between an announcement and passing the token east
+#define HOTPLUG_DEBOUNCE_MS 50          // A handshake input must disagree this long to count
+#define HEARTBEAT_MS 250                // Presence heartbeat interval
+#define HEARTBEAT_TIMEOUT_MS 800        // A module not heard from for this long has gone
+#define HANDSHAKE_PLACED_TIMEOUT_MS 2000 // Waiting or placed without completing: detect again
+
+enum HandshakeKind : uint8_t {
+    HANDSHAKE_ANNOUNCE = 0,  // Position taken during detection
+    HANDSHAKE_HEARTBEAT,     // Presence, sent every HEARTBEAT_MS once complete
+    HANDSHAKE_RESTART        // Topology changed: every module detects its position again
+};
+
+struct HandshakeMessage {
+    uint32_t uid;      // Hash of the 96-bit device ID
+    uint8_t position;  // 0 is the westmost module
+    bool last;         // Sent by the eastmost module: detection is complete
+    HandshakeKind kind;
+};
+
+class Handshake {
+public:
+    static const uint8_t MAX_MODULES = 16;  // The module ID is 4 bits in key-state frames
+
+    enum State : uint8_t {
+        SETTLING,  // Waiting for the other modules to start
+        WAITING,   // Waiting for the west neighbour to pass the token
+        PLACED,    // Position known, waiting for the eastmost announcement or heartbeat
+        COMPLETE
+    };
+
+    void begin(uint32_t uid, uint32_t nowMs, uint32_t settleMs = HANDSHAKE_SETTLE_MS);
+    // Call every scan with the handshake inputs (true while the neighbour's output is on).
+    // Returns true and fills `out` when a message must be broadcast.
+    bool update(uint32_t nowMs, bool westIn, bool eastIn, HandshakeMessage& out);
+    // Messages from the other modules, in the same task as update()
+    void receive(const HandshakeMessage& msg, uint32_t nowMs);
+
+    // Safe to read from other tasks
+    State state() const { return __atomic_load_n(&mode, __ATOMIC_ACQUIRE); }
+    bool placed() const { return state() >= PLACED; }
+    uint8_t position() const { return __atomic_load_n(&pos, __ATOMIC_RELAXED); }
+    uint8_t moduleCount() const { return __atomic_load_n(&count, __ATOMIC_RELAXED); }  // 0 until complete
+    bool isReceiver() const { return placed() && position() == 0; }  // The westmost module plays every note
+    // Incremented at every (re)start, so other tasks can drop state tied to the old positions
+    uint32_t epoch() const { return __atomic_load_n(&restarts, __ATOMIC_ACQUIRE); }
+
+    bool westOutput() const { return true; }
+    bool eastOutput() const { return __atomic_load_n(&eastOut, __ATOMIC_RELAXED); }
+    uint32_t moduleUid(uint8_t position) const { return uids[position % MAX_MODULES]; }
+    // Octave of the local keys, once complete
+    uint8_t octave() const { return octaveAt(position(), moduleCount()); }
+
+    static uint32_t hashUid(uint32_t w0, uint32_t w1, uint32_t w2);
+    // Octave of `position` in a stack of `modules`. The westmost module plays BASE_OCTAVE
+    // and each module east of it one octave higher, but the whole stack moves down when
+    // it would run past octave 8, the top of the NoteMap. A stack of up to 9 modules
+    // therefore always gets consecutive octaves. In a longer stack, the modules from
+    // position 9 on repeat the octaves from 0.
+    static uint8_t octaveAt(uint8_t position, uint8_t modules);
+
+private:
+    void place(uint8_t position, bool last, uint32_t nowMs, HandshakeMessage& out);
+    void complete(uint8_t modules, uint32_t nowMs);
+    bool topologyChanged(uint32_t nowMs, bool westIn, bool eastIn);
+    void restart(uint32_t nowMs, HandshakeMessage& out);
+
+    uint32_t uids[MAX_MODULES] = {};
+    uint32_t lastSeenMs[MAX_MODULES] = {};  // Last heartbeat from each position
+    uint32_t uid = 0;
+    uint32_t startMs = 0;
+    uint32_t settleTime = HANDSHAKE_SETTLE_MS;
+    uint32_t releaseMs = 0;    // When the east output goes off
+    uint32_t placedMs = 0;     // When this module took its position
+    uint32_t heartbeatMs = 0;  // When our next heartbeat is due
+    uint32_t mismatchMs = 0;   // Since when the inputs have disagreed with the topology
+    uint32_t restarts = 0;
+    uint8_t pos = 0;
+    uint8_t nextPos = 0;       // One past the highest position announced so far
+    uint8_t count = 0;
+    bool eastOut = true;
+    bool releasing = false;
+    bool mismatch = false;
+    bool restartRequested = false;
+    State mode = SETTLING;
+};
+
+extern Handshake handshake;  // Driven by scanKeysTask
+
+#endif // HANDSHAKE_HPP
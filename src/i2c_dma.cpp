@@ -0,0 +1,192 @@
+#include "i2c_dma.hpp"
+#include "system.hpp"
+#include "config.hpp"
+#include "rtos_alloc.hpp"
+#include <Arduino.h>
+#include <STM32FreeRTOS.h>
+#include <cstring>
+
+// TIMINGR values for an 80 MHz PCLK1, from the reference manual timing tool
+#if I2C_CLOCK_HZ == 1000000
+static const uint32_t I2C_TIMING = 0x00300F38;
+#else
+static const uint32_t I2C_TIMING = 0x00702991;
+#endif
+
+static SemaphoreHandle_t i2cDoneSemaphore;
+static SemaphoreStorage i2cDoneSemaphoreStorage;
+static volatile bool i2cDmaError = false;
+
+// The Wire library owns the I2C1 event interrupts, so completion is signalled by the DMA
+// channels instead. Only the last byte or two are left on the wire when they fire.
+static void dmaDoneISR(bool error) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    i2cDmaError = error;
+    xSemaphoreGiveFromISR(i2cDoneSemaphore, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+extern "C" void DMA1_Channel6_IRQHandler() {
+    bool error = DMA1->ISR & DMA_ISR_TEIF6;
+    DMA1->IFCR = DMA_IFCR_CGIF6;
+    dmaDoneISR(error);
+}
+
+extern "C" void DMA1_Channel7_IRQHandler() {
+    bool error = DMA1->ISR & DMA_ISR_TEIF7;
+    DMA1->IFCR = DMA_IFCR_CGIF7;
+    dmaDoneISR(error);
+}
+
+void initI2C() {
+    i2cDoneSemaphore = i2cDoneSemaphoreStorage.createBinary();
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_I2C1_CONFIG(RCC_I2C1CLKSOURCE_PCLK1);
+    __HAL_RCC_I2C1_CLK_ENABLE();
+
+    GPIO_InitTypeDef pins = {};
+    pins.Pin = GPIO_PIN_6 | GPIO_PIN_7;
+    pins.Mode = GPIO_MODE_AF_OD;
+    pins.Pull = GPIO_PULLUP;
+    pins.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    pins.Alternate = GPIO_AF4_I2C1;
+    HAL_GPIO_Init(GPIOB, &pins);
+
+    I2C1->CR1 = 0;
+    I2C1->TIMINGR = I2C_TIMING;
+    #if I2C_CLOCK_HZ == 1000000
+    HAL_I2CEx_EnableFastModePlus(I2C_FASTMODEPLUS_I2C1);
+    #endif
+    I2C1->CR1 = I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN | I2C_CR1_PE;
+
+    // I2C1_TX is DMA1 channel 6 and I2C1_RX is channel 7, both on request 3
+    DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~(DMA_CSELR_C6S | DMA_CSELR_C7S)) |
+                        (3 << DMA_CSELR_C6S_Pos) | (3 << DMA_CSELR_C7S_Pos);
+    DMA1_Channel6->CPAR = (uint32_t)&I2C1->TXDR;
+    DMA1_Channel6->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_TEIE;
+    DMA1_Channel7->CPAR = (uint32_t)&I2C1->RXDR;
+    DMA1_Channel7->CCR = DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_TEIE;
+
+    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+}
+
+static void startDma(DMA_Channel_TypeDef* channel, const uint8_t* data, uint8_t length) {
+    channel->CCR &= ~DMA_CCR_EN;
+    channel->CMAR = (uint32_t)data;
+    channel->CNDTR = length;
+    channel->CCR |= DMA_CCR_EN;
+}
+
+static void startTransfer(uint8_t address, uint8_t length, uint32_t flags) {
+    I2C1->CR2 = ((uint32_t)address << 1) | ((uint32_t)length << I2C_CR2_NBYTES_Pos) |
+                flags | I2C_CR2_START;
+}
+
+// Sleep until the DMA channel is done, then wait out the last bytes for `flag`
+static bool waitTransfer(uint32_t flag) {
+    if (xSemaphoreTake(i2cDoneSemaphore, pdMS_TO_TICKS(I2C_TIMEOUT_MS)) != pdTRUE || i2cDmaError) {
+        return false;
+    }
+    uint32_t start = micros();
+    while (!(I2C1->ISR & (flag | I2C_ISR_NACKF))) {
+        if (micros() - start > I2C_TIMEOUT_MS * 1000) {
+            return false;
+        }
+    }
+    return !(I2C1->ISR & I2C_ISR_NACKF);
+}
+
+// After a NACK or timeout: stop both channels and reset the peripheral state machine
+static void recover() {
+    DMA1_Channel6->CCR &= ~DMA_CCR_EN;
+    DMA1_Channel7->CCR &= ~DMA_CCR_EN;
+    I2C1->CR1 &= ~I2C_CR1_PE;
+    for (int i = 0; i < 3; i++) {
+        (void)I2C1->CR1;  // PE must stay low for three APB cycles
+    }
+    I2C1->CR1 |= I2C_CR1_PE;
+    xSemaphoreTake(i2cDoneSemaphore, 0);  // Drop a late completion
+}
+
+bool i2cWrite(uint8_t address, const uint8_t* data, uint8_t length) {
+    if (length == 0) {
+        return false;
+    }
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+    I2C1->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    startDma(DMA1_Channel6, data, length);
+    startTransfer(address, length, I2C_CR2_AUTOEND);
+    bool ok = waitTransfer(I2C_ISR_STOPF);
+    if (!ok) {
+        recover();
+    }
+    I2C1->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    xSemaphoreGive(i2cMutex);
+    return ok;
+}
+
+bool i2cWriteRead(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) {
+    if (length == 0) {
+        return false;
+    }
+    xSemaphoreTake(i2cMutex, portMAX_DELAY);
+    I2C1->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    // Register address without a stop, then a repeated start for the read
+    startDma(DMA1_Channel6, &reg, 1);
+    startTransfer(address, 1, 0);
+    bool ok = waitTransfer(I2C_ISR_TC);
+    if (ok) {
+        startDma(DMA1_Channel7, data, length);
+        startTransfer(address, length, I2C_CR2_RD_WRN | I2C_CR2_AUTOEND);
+        ok = waitTransfer(I2C_ISR_STOPF);
+    }
+    if (!ok) {
+        recover();
+    }
+    I2C1->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+    xSemaphoreGive(i2cMutex);
+    return ok;
+}
+
+extern "C" uint8_t u8x8_byte_stm32_dma_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr) {
+    static uint8_t buffer[I2C_BUFFER_BYTES];
+    static uint8_t length = 0;
+
+    switch (msg) {
+        case U8X8_MSG_BYTE_SEND: {
+            const uint8_t* data = (const uint8_t*)arg_ptr;
+            while (arg_int > 0) {
+                if (length == I2C_BUFFER_BYTES) {
+                    // Too long for one transaction: send what there is and carry on in a new
+                    // one. buffer[0] is still the SSD1306 control byte, so the next chunk
+                    // continues the same command or data stream.
+                    i2cWrite(u8x8_GetI2CAddress(u8x8) >> 1, buffer, length);
+                    length = 1;
+                }
+                uint8_t chunk = I2C_BUFFER_BYTES - length < arg_int ? I2C_BUFFER_BYTES - length : arg_int;
+                memcpy(buffer + length, data, chunk);
+                length += chunk;
+                data += chunk;
+                arg_int -= chunk;
+            }
+            break;
+        }
+        case U8X8_MSG_BYTE_START_TRANSFER:
+            length = 0;
+            break;
+        case U8X8_MSG_BYTE_END_TRANSFER:
+            i2cWrite(u8x8_GetI2CAddress(u8x8) >> 1, buffer, length);
+            break;
+        case U8X8_MSG_BYTE_INIT:     // The bus is set up by initI2C()
+        case U8X8_MSG_BYTE_SET_DC:   // Not used on I2C
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
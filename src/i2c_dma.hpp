@@ -0,0 +1,23 @@
+#ifndef I2C_DMA_HPP
+#define I2C_DMA_HPP
+
+#include <cstdint>
+#include <U8g2lib.h>
+
+#define I2C_BUFFER_BYTES 160  // Largest display transfer: one 16-tile row plus its control byte
+#define I2C_TIMEOUT_MS 10
+
+// I2C1 (PB6 SCL, PB7 SDA) driven by DMA. A transfer starts the DMA channel and the
+// calling task sleeps until the completion interrupt, instead of spinning on Wire.
+void initI2C();
+
+// Bus arbiter: each call holds i2cMutex for one transaction only, so transactions
+// from the display and the knob expander interleave. Lengths are 1 to 255 bytes.
+bool i2cWrite(uint8_t address, const uint8_t* data, uint8_t length);
+bool i2cWriteRead(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length);
+
+// U8g2 byte callback: collects a transfer and sends it with i2cWrite(). A transfer longer
+// than I2C_BUFFER_BYTES is split into several, each starting with its control byte.
+extern "C" uint8_t u8x8_byte_stm32_dma_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+
+#endif // I2C_DMA_HPP
@@ -0,0 +1,83 @@
+#include "joystick.hpp"
+#include <Arduino.h>
+#include <stm32l4xx_hal.h>
+
+static ADC_HandleTypeDef joystickADC;
+static DMA_HandleTypeDef joystickDMA;
+static volatile uint16_t joystickRaw[2] = {2048, 2048};  // {X, Y}, written by the DMA
+
+static JoystickAxis axisX;
+static JoystickAxis axisY;
+
+void initJoystick() {
+    // PA1 (JOYX_PIN) is ADC1_IN6, PA0 (JOYY_PIN) is ADC1_IN5
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    GPIO_InitTypeDef pins = {};
+    pins.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+    pins.Mode = GPIO_MODE_ANALOG_ADC_CONTROL;
+    pins.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &pins);
+
+    __HAL_RCC_ADC_CLK_ENABLE();
+    __HAL_RCC_ADC_CONFIG(RCC_ADCCLKSOURCE_SYSCLK);
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    // Circular transfer of the two results, with no interrupts: the CPU just reads the array
+    joystickDMA.Instance = DMA1_Channel1;
+    joystickDMA.Init.Request = DMA_REQUEST_0;  // ADC1
+    joystickDMA.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    joystickDMA.Init.PeriphInc = DMA_PINC_DISABLE;
+    joystickDMA.Init.MemInc = DMA_MINC_ENABLE;
+    joystickDMA.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    joystickDMA.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    joystickDMA.Init.Mode = DMA_CIRCULAR;
+    joystickDMA.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&joystickDMA);
+    __HAL_LINKDMA(&joystickADC, DMA_Handle, joystickDMA);
+
+    // Continuous scan of both channels. 20 MHz ADC clock and the longest sampling time
+    // give a pair of conversions every ~65 us, which is plenty for a joystick.
+    joystickADC.Instance = ADC1;
+    joystickADC.Init.ClockPrescaler = ADC_CLOCK_ASYNC_DIV4;
+    joystickADC.Init.Resolution = ADC_RESOLUTION_12B;
+    joystickADC.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    joystickADC.Init.ScanConvMode = ADC_SCAN_ENABLE;
+    joystickADC.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+    joystickADC.Init.LowPowerAutoWait = DISABLE;
+    joystickADC.Init.ContinuousConvMode = ENABLE;
+    joystickADC.Init.NbrOfConversion = 2;
+    joystickADC.Init.DiscontinuousConvMode = DISABLE;
+    joystickADC.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+    joystickADC.Init.DMAContinuousRequests = ENABLE;
+    joystickADC.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+    joystickADC.Init.OversamplingMode = DISABLE;
+    HAL_ADC_Init(&joystickADC);
+
+    ADC_ChannelConfTypeDef channel = {};
+    channel.SamplingTime = ADC_SAMPLETIME_640CYCLES_5;
+    channel.SingleDiff = ADC_SINGLE_ENDED;
+    channel.OffsetNumber = ADC_OFFSET_NONE;
+    channel.Channel = ADC_CHANNEL_6;
+    channel.Rank = ADC_REGULAR_RANK_1;
+    HAL_ADC_ConfigChannel(&joystickADC, &channel);
+    channel.Channel = ADC_CHANNEL_5;
+    channel.Rank = ADC_REGULAR_RANK_2;
+    HAL_ADC_ConfigChannel(&joystickADC, &channel);
+
+    HAL_ADCEx_Calibration_Start(&joystickADC, ADC_SINGLE_ENDED);
+    HAL_ADC_Start_DMA(&joystickADC, (uint32_t*)joystickRaw, 2);
+
+    // The stick is assumed to be at rest at power-up
+    delayMicroseconds(200);
+    axisX.calibrate(joystickRaw[0]);
+    axisY.calibrate(joystickRaw[1]);
+}
+
+JoystickState readJoystick() {
+    int32_t x = axisX.update(joystickRaw[0]);
+    int32_t y = axisY.update(joystickRaw[1]);
+    JoystickState state;
+    state.bendCents = x * JOY_BEND_CENTS / JoystickAxis::FULL_SCALE;
+    state.modDepth = (y < 0 ? -y : y) * JOY_MOD_MAX / JoystickAxis::FULL_SCALE;
+    return state;
+}
@@ -0,0 +1,51 @@
+#ifndef JOYSTICK_HPP
+#define JOYSTICK_HPP
+
+#include <cstdint>
+
+#define JOY_FILTER_SHIFT 2   // Low-pass time constant in render blocks (2^n)
+#define JOY_DEADZONE 80      // ADC counts either side of the centre
+#define JOY_BEND_CENTS 200   // Full X deflection, +-2 semitones
+#define JOY_MOD_MAX 127      // Full Y deflection
+
+// One joystick axis: fixed-point low-pass, centre calibration and a deadzone.
+class JoystickAxis {
+public:
+    static const int32_t FULL_SCALE = 1000;
+
+    void calibrate(uint16_t raw) {
+        centre = raw;
+        filtered = (int32_t)raw << 4;
+    }
+
+    // Feed a 12-bit sample; returns the deflection from -FULL_SCALE to FULL_SCALE
+    int32_t update(uint16_t raw) {
+        filtered += (((int32_t)raw << 4) - filtered) >> JOY_FILTER_SHIFT;  // Q4
+        int32_t offset = (filtered >> 4) - centre;
+        int32_t magnitude = offset < 0 ? -offset : offset;
+        if (magnitude <= JOY_DEADZONE) {
+            return 0;
+        }
+        int32_t span = (offset < 0 ? centre : 4095 - centre) - JOY_DEADZONE;
+        if (span <= 0) {
+            return 0;
+        }
+        int32_t scaled = (magnitude - JOY_DEADZONE) * FULL_SCALE / span;
+        if (scaled > FULL_SCALE) scaled = FULL_SCALE;
+        return offset < 0 ? -scaled : scaled;
+    }
+
+private:
+    int32_t filtered = 2048 << 4;
+    int32_t centre = 2048;
+};
+
+struct JoystickState {
+    int32_t bendCents;  // X: -JOY_BEND_CENTS to JOY_BEND_CENTS
+    int32_t modDepth;   // Y: 0 to JOY_MOD_MAX, either direction
+};
+
+void initJoystick();  // Start continuous ADC conversion of both axes into RAM by DMA
+JoystickState readJoystick();  // Filter the latest samples, once per render block
+
+#endif // JOYSTICK_HPP
@@ -1,95 +1,271 @@
 #include "keys.hpp"
 #include "system.hpp"
-#include "audio.hpp"
 #include "knob.hpp"
 #include "config.hpp"
+#include "pindef.hpp"
+#include "debounce.hpp"
+#include "can_bus.hpp"
+#include "recorder.hpp"
+#include "params.hpp"
+#include "display.hpp"
+#include "handshake.hpp"
+#include "can_protocol.hpp"
+#include "midi.hpp"
 
 #include <Arduino.h>
 #include <bitset>
 
-std::bitset<12> scanKeys() {
-    std::bitset<12> allKeys;
-    // Scan rows 0 to 2 (3 rows x 4 cols = 12 keys)
-    for (uint8_t row = 0; row < 3; row++) {
+EventRing<KeyEvent, 64, KEY_READER_COUNT> keyEvents;
+volatile uint32_t scanKeysWorstTime = 0;
+volatile uint32_t scanKeysLastTime = 0;
+Recorder recorder;
+Handshake handshake;
+
+#ifdef SERIAL_MIDI
+static MidiParser midiIn;
+static MidiWriter midiOut(MIDI_CHANNEL);
+
+// Send a key event of this module as MIDI, unless it would block the scan: a message that
+// does not fit in the serial transmit buffer is dropped.
+static void sendMidi(const KeyEvent& event) {
+    uint8_t bytes[3];
+    uint8_t length = midiOut.encode(event, bytes);
+    if (length && Serial.availableForWrite() >= length) {
+        Serial.write(bytes, length);
+    } else if (length) {
+        midiOut.reset();
+    }
+}
+
+// Turn the MIDI received since the last scan into key events of this module. They take
+// the same path as the local keys: voice engine, CAN and recorder.
+static bool updateMidi(uint32_t now) {
+    bool published = false;
+    KeyEvent event;
+    while (Serial.available() > 0) {
+        if (midiIn.feed(Serial.read(), now, event)) {
+            keyEvents.push(event);
+            recorder.capture(event);
+            published = true;
+        }
+    }
+    return published;
+}
+#endif
+
+// Value latched into the row's DFF by OUT_PIN (doc/handshaking.md)
+static uint8_t rowOutput(uint8_t row) {
+    switch (row) {
+        #ifdef PCAL_KNOBS
+        case 2: return LOW;  // KNOB_MODE low so the knobs are read by the PCAL6408A instead
+        #endif
+        case HKOW_BIT: return handshake.westOutput() ? HIGH : LOW;
+        case HKOE_BIT: return handshake.eastOutput() ? HIGH : LOW;
+        default: return HIGH;  // OLED power and reset stay high
+    }
+}
+
+uint32_t scanInputs() {
+    uint32_t inputs = 0;
+    // Scan rows 0 to 6 (keys, knob quadrature, knob/joystick buttons, handshake inputs)
+    for (uint8_t row = 0; row < INPUT_ROWS; row++) {
+        digitalWrite(OUT_PIN, rowOutput(row));
         setRow(row);
         delayMicroseconds(3);
-        std::bitset<4> cols = readCols();
-        for (uint8_t col = 0; col < 4; col++) {
-            allKeys[row * 4 + col] = cols[col];
-        }
+        inputs |= readCols().to_ulong() << (row * 4);
     }
     // In worst-case testing mode, generate a press for every key (regardless of physical state)
     #ifdef TEST_SCAN_KEYS
-    for (int i = 0; i < 12; i++) {
-        allKeys[i] = 1;  // Force all keys to be "pressed" in test mode
-    }
+    inputs |= KEYS_MASK;  // Force all keys to be "pressed" in test mode
     #endif
-    return allKeys;
+    return inputs;
+}
+
+// Number of consecutive scans a switch must agree on before it is debounced
+static uint8_t debounceSamples() {
+    uint32_t samples = (DEBOUNCE_MS + SCAN_INTERVAL_MS - 1) / SCAN_INTERVAL_MS;
+    if (samples < 2) samples = 2;
+    if (samples > Debouncer::MAX_SAMPLES) samples = Debouncer::MAX_SAMPLES;
+    return samples;
+}
+
+// Parameter controlled by each knob, and its acceleration for fast turns
+static const ParamId knobParams[4] = {PARAM_OCTAVE, PARAM_WAVEFORM, PARAM_CUTOFF, PARAM_VOLUME};
+static const uint8_t knobAcceleration[4] = {1, 1, 8, 1};
+
+// Knob bounds come from the parameter each one controls
+static Knob makeKnob(int k) {
+    const ParamInfo& info = ParamRegistry::info(knobParams[k]);
+    return Knob(info.min, info.max, info.initial, knobAcceleration[k]);
+}
+static Knob knobs[4] = {makeKnob(0), makeKnob(1), makeKnob(2), makeKnob(3)};
+
+void updateKnobs(uint8_t knobStates, uint32_t now) {
+    for (int k = 0; k < 4; k++) {
+        // The registry holds the value, so changes made elsewhere are picked up here
+        knobs[k].setValue(params.get(knobParams[k]));
+        if (knobs[k].update((knobStates >> (2 * k)) & 0b11, now)) {  // {B,A}
+            params.set(knobParams[k], knobs[k].value());
+        }
+    }
+}
+
+// Toggle the game on a press of all four knob buttons.
+static void updateKnobButtons(uint32_t changed, uint32_t inputs) {
+    static bool previouslyPressed = false;
+    const uint32_t allKnobsPressed = (1UL << KNOB0_S_BIT) | (1UL << KNOB1_S_BIT)
+                                   | (1UL << KNOB2_S_BIT) | (1UL << KNOB3_S_BIT);
+    bool pressed = (inputs & allKnobsPressed) == allKnobsPressed;
+
+    if (pressed && !previouslyPressed) {
+        xSemaphoreTake(sysState.mutex, portMAX_DELAY);
+        sysState.areAllKnobSPressed = !sysState.areAllKnobSPressed;
+        xSemaphoreGive(sysState.mutex);
+    }
+    previouslyPressed = pressed;
+
+    // Knob 3 pressed on its own cycles the display view
+    if ((changed & inputs & (1UL << KNOB3_S_BIT)) && (inputs & allKnobsPressed) == (1UL << KNOB3_S_BIT)) {
+        xSemaphoreTake(sysState.mutex, portMAX_DELAY);
+        sysState.displayView = (sysState.displayView + 1) % VIEW_COUNT;
+        xSemaphoreGive(sysState.mutex);
+    }
+}
+
+// Gather the {B,A} pairs of the four knobs from the matrix into the PCAL6408A bit layout.
+static uint8_t matrixKnobStates(uint32_t inputs) {
+    const uint8_t knobBits[4] = {KNOB0_A_BIT, KNOB1_A_BIT, KNOB2_A_BIT, KNOB3_A_BIT};
+    uint8_t knobStates = 0;
+    for (int k = 0; k < 4; k++) {
+        knobStates |= ((inputs >> knobBits[k]) & 0b11) << (2 * k);
+    }
+    return knobStates;
+}
+
+// Run position detection: apply announcements from CAN, broadcast our own, and take the
+// octave for our position once the size of the stack is known.
+static bool updateHandshake(uint32_t inputs, uint32_t nowMs) {
+    static uint32_t octaveEpoch = UINT32_MAX;  // Enumeration whose octave has been taken
+    HandshakeMessage msg;
+    while (handshakeInbox.pop(0, msg)) {
+        handshake.receive(msg, nowMs);
+    }
+    bool sent = handshake.update(nowMs, inputs & (1UL << HSW_BIT), inputs & (1UL << HSE_BIT), msg);
+    if (handshake.state() == Handshake::COMPLETE && handshake.epoch() != octaveEpoch) {
+        octaveEpoch = handshake.epoch();
+        params.set(PARAM_OCTAVE, handshake.octave());
+    }
+    if (!sent) {
+        return false;
+    }
+    CANFrame frame;
+    frame.id = canId(CAN_MSG_HANDSHAKE, msg.position);
+    encodeHandshake(msg, frame.data);
+    xQueueSend(msgOutQ, &frame, 0);
+    return true;
+}
+
+// The joystick button drives the recorder: a short press steps record -> play -> overdub -> play,
+// holding it for a second stops. Due playback events are published like live keys.
+static bool updateRecorder(uint32_t changed, uint32_t inputs, uint32_t now) {
+    static uint32_t pressTime = 0;
+    KeyEvent events[8];
+    uint8_t count = 0;
+
+    if (changed & (1UL << JOYS_BIT)) {
+        if (inputs & (1UL << JOYS_BIT)) {
+            pressTime = now;
+        } else if (now - pressTime >= 1000000) {
+            count = recorder.stop(now, events, 8);
+        } else if (recorder.state() == Recorder::IDLE) {
+            recorder.record(now);
+        } else if (recorder.state() == Recorder::PLAYING) {
+            recorder.overdub();
+        } else {
+            recorder.play(now);
+        }
+    }
+    count += recorder.poll(now, events + count, 8 - count);
+
+    for (uint8_t i = 0; i < count; i++) {
+        keyEvents.push(events[i]);
+        #ifdef SERIAL_MIDI
+        sendMidi(events[i]);
+        #endif
+    }
+    return count > 0;
 }
 
 void scanKeysTask(void *pvParameters) {
     #ifndef TEST_SCAN_KEYS
-    const TickType_t xFrequency = 50 / portTICK_PERIOD_MS;
+    const TickType_t xFrequency = SCAN_INTERVAL_MS / portTICK_PERIOD_MS;
     TickType_t xLastWakeTime = xTaskGetTickCount();
     #endif
-    static std::bitset<12> previousKeys;  // To detect transitions
+    static Debouncer debouncer(debounceSamples(), DEBOUNCE_MASK);
+    static uint8_t pressOctave[12] = {};  // Octave each key was last pressed in
+    static bool started = false;
+    if (!started) {
+        handshake.begin(Handshake::hashUid(HAL_GetUIDw0(), HAL_GetUIDw1(), HAL_GetUIDw2()), millis());
+        started = true;
+    }
 
     while (1) {
         #ifndef TEST_SCAN_KEYS
         vTaskDelayUntil(&xLastWakeTime, xFrequency);
         #endif
-        std::bitset<12> localKeys = scanKeys();
-        decodeKnob();
+        uint32_t startTime = micros();
+        uint32_t rawInputs = scanInputs();
+        uint32_t changed = debouncer.update(rawInputs);
+        uint32_t inputs = debouncer.merge(rawInputs);
+        std::bitset<12> localKeys(inputs & KEYS_MASK);
+        #ifndef PCAL_KNOBS
+        updateKnobs(matrixKnobStates(inputs), startTime);
+        #endif
+        updateKnobButtons(changed, inputs);
         
-        // Detect key state changes and send a CAN message for each transition.
-        for (int i = 0; i < 12; i++) {
-            if (localKeys[i] != previousKeys[i]) {
-                uint8_t TX_Message[8] = {0};
-                // Use 'P' for press, 'R' for release.
-                TX_Message[0] = localKeys[i] ? 'P' : 'R';
-                #ifdef LEFT_PIANO
-                TX_Message[1] = 4;  // Example octave number; adjust as needed.
-                #endif
-                #ifdef RIGHT_PIANO
-                TX_Message[1] = 5;  // Example octave number; adjust as needed.
-                #endif
-                TX_Message[2] = i;  // Note number.
-                // Place message on the transmit queue.
-                xQueueSend(msgOutQ, TX_Message, portMAX_DELAY);
+        bool published = updateRecorder(changed, inputs, startTime);
+        published |= updateHandshake(inputs, millis());
+        #ifdef SERIAL_MIDI
+        published |= updateMidi(startTime);
+        #endif
+
+        // Publish only the debounced key transitions, stamped with the scan time. A release
+        // carries the octave of its press, so turning the octave knob or re-placing the
+        // module while a key is held cannot leave the pressed note sounding.
+        uint32_t keyChanges = changed & KEYS_MASK;
+        uint8_t octave = params.get(PARAM_OCTAVE);
+        while (keyChanges) {
+            uint8_t i = __builtin_ctz(keyChanges);
+            keyChanges &= keyChanges - 1;
+            if (localKeys[i]) {
+                pressOctave[i] = octave;
             }
+            KeyEvent event = {startTime, pressOctave[i], i, localKeys[i], 0};
+            keyEvents.push(event);
+            recorder.capture(event);
+            #ifdef SERIAL_MIDI
+            sendMidi(event);
+            #endif
+            published = true;
+        }
+        if (published) {
+            notifyCANTx();
         }
-        previousKeys = localKeys;
 
-        // Update shared key states and step size.
+        // Update shared input state.
         xSemaphoreTake(sysState.mutex, portMAX_DELAY);
+        sysState.inputs = inputs;
         sysState.keyStates = localKeys;
         xSemaphoreGive(sysState.mutex);
-        updateStepSizeFromKeys(localKeys);
+
+        uint32_t elapsed = micros() - startTime;
+        scanKeysLastTime = elapsed;
+        if (elapsed > scanKeysWorstTime) {
+            scanKeysWorstTime = elapsed;
+        }
 
         #ifdef TEST_SCAN_KEYS
         break;
         #endif
     }
 }
-
-void updateStepSizeFromKeys(const std::bitset<12>& keyStates) {
-    uint32_t localStepSize = 0;
-
-    xSemaphoreTake(sysState.mutex, portMAX_DELAY);
-    bool gameOverride = sysState.gameActiveOverride;  // Check if game is active
-    xSemaphoreGive(sysState.mutex);
-
-    if (gameOverride) {
-        return;
-    }
-
-    xSemaphoreTake(sysMutex, portMAX_DELAY);
-    for (int i = 0; i < 12; i++) {
-        if (keyStates[i]) {
-            localStepSize = stepSizes[i];
-        }
-    }
-    xSemaphoreGive(sysMutex);
-
-    __atomic_store_n(&currentStepSize, localStepSize, __ATOMIC_RELAXED);
-}
\ No newline at end of file
@@ -2,9 +2,34 @@
 #define KEYS_HPP
 
 #include <bitset>
+#include <cstdint>
+#include "event_ring.hpp"
 
-std::bitset<12> scanKeys();
-void updateStepSizeFromKeys(const std::bitset<12>& keyStates);
+// A single debounced key transition, timestamped with micros() at the scan that saw it
+struct KeyEvent {
+    uint32_t time;
+    uint8_t octave;
+    uint8_t key;      // 0-11, C to B
+    uint8_t pressed;  // 1 for press, 0 for release
+    uint8_t module;   // Source module, 0 for local keys
+};
+
+// Readers of the key event stream
+enum KeyEventReader : uint32_t {
+    KEY_READER_VOICE = 0,  // Voice engine, drained by audioRenderTask
+    KEY_READER_CAN,        // CAN_TX_Task
+    KEY_READER_COUNT
+};
+
+extern EventRing<KeyEvent, 64, KEY_READER_COUNT> keyEvents;
+
+// Per-tick cost of scanKeysTask in microseconds
+extern volatile uint32_t scanKeysWorstTime;
+extern volatile uint32_t scanKeysLastTime;
+
+uint32_t scanInputs();
+// Decode the knobs from their {B,A} pairs, knob k in bits 2k (A) and 2k+1 (B)
+void updateKnobs(uint8_t knobStates, uint32_t now);
 void scanKeysTask(void *pvParameters);
 
 #endif // KEYS_HPP
@@ -1,49 +1,50 @@
 #include "knob.hpp"
-#include "system.hpp"
-#include "extension.hpp"
-#include <STM32FreeRTOS.h>
-
-#include <bitset>
-#include <Arduino.h>
-
-void decodeKnob() {
-    static bool previouslyPressed = false;
-    
-    // First Check if there is rotation in the knob3 
-    setRow(3);
-    delayMicroseconds(3);
-    std::bitset<4> cols = readCols();
-    // Columns: 0 is A, 1 is B.
-    uint8_t currentState = (cols[1] << 1) | cols[0];
-    
-    int rotation = 0;
-    if ((prevKnobState == 0b00 && currentState == 0b01) ||
-        (prevKnobState == 0b01 && currentState == 0b11) ||
-        (prevKnobState == 0b11 && currentState == 0b10) ||
-        (prevKnobState == 0b10 && currentState == 0b00)) {
-        rotation = +1;
-    } else if ((prevKnobState == 0b00 && currentState == 0b10) ||
-               (prevKnobState == 0b10 && currentState == 0b11) ||
-               (prevKnobState == 0b11 && currentState == 0b01) ||
-               (prevKnobState == 0b01 && currentState == 0b00)) {
-        rotation = -1;
+
+// Indexed by (previous {B,A} << 2) | current {B,A}
+const int8_t Knob::TRANSITIONS[16] = {
+     0, +1, -1, IMPOSSIBLE,   // From 00
+    -1,  0, IMPOSSIBLE, +1,   // From 01
+    +1, IMPOSSIBLE,  0, -1,   // From 10
+    IMPOSSIBLE, -1, +1,  0    // From 11
+};
+
+Knob::Knob(int32_t lower, int32_t upper, int32_t initial, uint8_t acceleration)
+    : current(initial), minValue(lower), maxValue(upper), accel(acceleration ? acceleration : 1) {
+    setValue(initial);
+}
+
+void Knob::setValue(int32_t value) {
+    current = value < minValue ? minValue : (value > maxValue ? maxValue : value);
+}
+
+void Knob::setLimits(int32_t lower, int32_t upper) {
+    minValue = lower;
+    maxValue = upper;
+    setValue(current);
+}
+
+int32_t Knob::update(uint8_t state, uint32_t nowUs) {
+    int32_t step = transition(prevState, state);
+    prevState = state & 3;
+
+    if (step == 0) {
+        return 0;
+    }
+    if (step == IMPOSSIBLE) {
+        // A sample was missed: assume two steps in the direction of the last legal transition
+        step = 2 * lastDirection;
+    } else {
+        lastDirection = step;
     }
 
-    // Second Check if all 4 of the knobs are being pressed
-    setRow(5);
-    delayMicroseconds(3);
-    std::bitset<4> row5Cols = readCols(); // Read the column states
-    setRow(6);
-    delayMicroseconds(3);
-    std::bitset<4> row6Cols = readCols(); // Read the column states
-    
-    xSemaphoreTake(sysState.mutex, portMAX_DELAY);
-    if (row5Cols[0] && row5Cols[1] && row6Cols[0] && row6Cols[1] && !previouslyPressed) {
-        sysState.areAllKnobSPressed = !sysState.areAllKnobSPressed;
+    // Scale fast turns linearly, from 1x at the window edge up to `accel` x for back-to-back steps
+    uint32_t interval = nowUs - lastStepUs;
+    lastStepUs = nowUs;
+    if (accel > 1 && interval < ACCEL_WINDOW_US) {
+        step *= 1 + (int32_t)((accel - 1) * (ACCEL_WINDOW_US - interval) / ACCEL_WINDOW_US);
     }
-    sysState.knob3Rotation = constrain(sysState.knob3Rotation + rotation, 0, 8);
-    xSemaphoreGive(sysState.mutex);
 
-    prevKnobState = currentState;
-    previouslyPressed = row5Cols[0] && row5Cols[1] && row6Cols[0] && row6Cols[1];
+    int32_t previous = current;
+    setValue(current + step);
+    return current - previous;
 }
@@ -1,6 +1,40 @@
 #ifndef KNOB_HPP
 #define KNOB_HPP
 
-void decodeKnob();
+#include <cstdint>
 
-#endif // KNOB_HPP
\ No newline at end of file
+// Quadrature decoder for one knob, with limits and velocity-based acceleration.
+// Pure logic: feed it the {B,A} state from the key matrix (or the PCAL6408A) and a
+// micros() timestamp, and it keeps the bounded rotation value.
+class Knob {
+public:
+    // Steps closer together than this are accelerated, up to `acceleration` times
+    static const uint32_t ACCEL_WINDOW_US = 40000;
+
+    Knob(int32_t lower, int32_t upper, int32_t initial, uint8_t acceleration = 1);
+
+    // Decode a new {B,A} sample. Returns the change applied to the value.
+    int32_t update(uint8_t state, uint32_t nowUs);
+
+    int32_t value() const { return current; }
+    void setValue(int32_t value);
+    void setLimits(int32_t lower, int32_t upper);
+    void setAcceleration(uint8_t acceleration) { accel = acceleration ? acceleration : 1; }
+
+    // Raw step for a {prev,curr} transition: +1, -1, 0, or IMPOSSIBLE when both bits changed
+    static const int8_t IMPOSSIBLE = 2;
+    static int8_t transition(uint8_t prev, uint8_t curr) { return TRANSITIONS[((prev & 3) << 2) | (curr & 3)]; }
+
+private:
+    static const int8_t TRANSITIONS[16];
+
+    int32_t current;
+    int32_t minValue;
+    int32_t maxValue;
+    uint32_t lastStepUs = 0;
+    uint8_t prevState = 0;
+    int8_t lastDirection = 0;
+    uint8_t accel;
+};
+
+#endif // KNOB_HPP
@@ -0,0 +1,58 @@
+#include "knob_expander.hpp"
+#include "pcal6408a.hpp"
+#include "keys.hpp"
+#include "system.hpp"
+#include "pindef.hpp"
+#include "config.hpp"
+#include "i2c_dma.hpp"
+#include "rtos_alloc.hpp"
+#include <Arduino.h>
+#include <STM32FreeRTOS.h>
+
+// Register access through the DMA bus arbiter, shared with the display
+class DmaI2CBus : public I2CBus {
+public:
+    bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) override {
+        uint8_t data[2] = {reg, value};
+        return i2cWrite(address, data, 2);
+    }
+
+    bool readRegister(uint8_t address, uint8_t reg, uint8_t& value) override {
+        return i2cWriteRead(address, reg, &value, 1);
+    }
+};
+
+static DmaI2CBus i2cBus;
+static PCAL6408A expander(i2cBus);
+static SemaphoreHandle_t knobIntSemaphore;
+static SemaphoreStorage knobIntSemaphoreStorage;
+
+// INT# falls when a latched input changes; the read happens in knobExpanderTask
+static void knobIntISR() {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(knobIntSemaphore, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void initKnobExpander() {
+    knobIntSemaphore = knobIntSemaphoreStorage.createBinary();
+    pinMode(KNOB_INT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(KNOB_INT_PIN), knobIntISR, FALLING);
+}
+
+void knobExpanderTask(void *pvParameters) {
+    expander.begin();
+
+    uint8_t knobStates;
+    while (1) {
+        // Wait for the semaphore before the bus mutex. The timeout catches an edge that
+        // was missed while INT# was still asserted.
+        bool signalled = xSemaphoreTake(knobIntSemaphore, pdMS_TO_TICKS(KNOB_POLL_MS)) == pdTRUE;
+        if (!signalled && digitalRead(KNOB_INT_PIN) == HIGH) {
+            continue;
+        }
+        if (expander.readInputs(knobStates)) {
+            updateKnobs(knobStates, micros());
+        }
+    }
+}
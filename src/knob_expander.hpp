@@ -0,0 +1,7 @@
+#ifndef KNOB_EXPANDER_HPP
+#define KNOB_EXPANDER_HPP
+
+void initKnobExpander();  // Attach the knob change interrupt
+void knobExpanderTask(void *pvParameters);
+
+#endif // KNOB_EXPANDER_HPP
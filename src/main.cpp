@@ -13,16 +13,48 @@
 #include "knob.hpp"
 #include "config.hpp"
 #include "extension.hpp"
+#include "knob_expander.hpp"
+#include "joystick.hpp"
+#include "i2c_dma.hpp"
+#include "fft.hpp"
+#include "rtos_alloc.hpp"
+#include "trace.hpp"
+#include "can_stats.hpp"
 
 HardwareTimer sampleTimer(TIM1);
 
+#ifndef DISABLE_THREADS
+static TaskStorage<256> audioRenderStorage;
+static TaskStorage<256> scanKeysStorage;
+static TaskStorage<256> displayUpdateStorage;
+static TaskStorage<128> canTxStorage;
+static TaskStorage<128> canRxStorage;
+static TaskStorage<2048> gameStorage;
+static TaskStorage<256> canStatsStorage;
+#ifdef PCAL_KNOBS
+static TaskStorage<128> knobExpanderStorage;
+#endif
+#ifdef TRACE
+static TaskStorage<192> traceDrainStorage;
+#endif
+#endif
+
 void setup() {
     Serial.begin(115200);
+    #ifndef SERIAL_MIDI
     Serial.println("Initialising System...");
+    #endif
+    initTrace();
     initSystem();
     initCAN();
+    initI2C();
+    initJoystick();
+    #ifdef PCAL_KNOBS
+    initKnobExpander();
+    #endif
     
-    sampleTimer.setOverflow(22000, HERTZ_FORMAT);
+    initAudio();
+    sampleTimer.setOverflow(SAMPLE_RATE, HERTZ_FORMAT);
     #ifndef DISABLE_SAMPLE_ISR
     sampleTimer.attachInterrupt(sampleISR);
     #endif
@@ -38,6 +70,8 @@ void setup() {
     float final_time = micros() - startTime;  // Calculate total time
     Serial.print("Worst Case Time for Display Update (ms): ");
     Serial.println(final_time / 32000);  // Print the average time per update
+    Serial.print("Bytes sent for the last frame: ");
+    Serial.println(displayBytesLast);
     while(1);
     #endif
 
@@ -49,6 +83,8 @@ void setup() {
     float final_time = micros() - startTime;
     Serial.print("Worst Case Time for ScanKeys (ms): ");
     Serial.println(final_time/32000);
+    Serial.print("Worst Case Single Scan (us): ");
+    Serial.println(scanKeysWorstTime);
     while(1);
     #endif
 
@@ -63,6 +99,59 @@ void setup() {
     while(1);
     #endif
 
+    #ifdef TEST_FFT
+    fftInit();
+    int16_t fftRe[SCOPE_SAMPLES];
+    int16_t fftIm[SCOPE_SAMPLES];
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    uint32_t worstCycles = 0;
+    for (int iter = 0; iter < 32; iter++) {
+        for (int i = 0; i < SCOPE_SAMPLES; i++) {
+            fftRe[i] = (i * 977) & 0x7FFF;
+            fftIm[i] = 0;
+        }
+        uint32_t start = DWT->CYCCNT;
+        fftWindow(fftRe, 7);
+        fft(fftRe, fftIm, 7);
+        uint32_t cycles = DWT->CYCCNT - start;
+        if (cycles > worstCycles) worstCycles = cycles;
+    }
+    Serial.print("Worst Case Cycles for a 128-point FFT: ");
+    Serial.println(worstCycles);
+    while(1);
+    #endif
+
+    #ifdef TEST_CAN_THROUGHPUT
+    // Needs SINGLE_PIANO (loopback). Compares waiting for a mailbox with the interrupt-fed queue.
+    uint8_t testFrame[8] = {0};
+    const uint32_t testFrames = 1000;
+    uint32_t startTime = micros();
+    for (uint32_t i = 0; i < testFrames; i++) {
+        CAN_TX(canId(CAN_MSG_KEYSTATE, 0), testFrame);
+    }
+    uint32_t blockingTime = micros() - startTime;
+    uint32_t enqueueTime = 0;
+    startTime = micros();
+    for (uint32_t i = 0; i < testFrames; i++) {
+        uint32_t callStart = micros();
+        while (CAN_TX_Async(canId(CAN_MSG_KEYSTATE, 0), testFrame) != CAN_TX_QUEUED);  // Only spins when the queue is full
+        enqueueTime += micros() - callStart;
+    }
+    uint32_t rejected = CAN_TX_FullCount();
+    while (CAN_TX_QueueLevel());
+    uint32_t asyncTime = micros() - startTime;
+    Serial.print("Blocking CAN_TX (frames/s): ");
+    Serial.println(testFrames * 1000000ULL / blockingTime);
+    Serial.print("CAN_TX_Async (frames/s): ");
+    Serial.println(testFrames * 1000000ULL / asyncTime);
+    Serial.print("CAN_TX_Async calls rejected while full: ");
+    Serial.println(rejected);
+    Serial.print("Caller time per accepted frame (us): ");
+    Serial.println((float)(enqueueTime) / (testFrames + rejected));
+    while(1);
+    #endif
+
     #ifdef TEST_CAN_TX_ISR
     CAN_TX_ISR();
     #endif
@@ -82,13 +171,22 @@ void setup() {
 
 
     #ifndef DISABLE_THREADS
-    xTaskCreate(scanKeysTask, "scanKeys", 256, NULL, 2, NULL);
-    xTaskCreate(displayUpdateTask, "displayUpdate", 256, NULL, 1, NULL);
-    xTaskCreate(CAN_TX_Task, "CAN_TX", 128, NULL, 3, NULL);
-    xTaskCreate(CAN_RX_Task, "CAN_RX", 128, NULL, 3, NULL);
-    xTaskCreate(gameTask, "gameTask", 2048, NULL, 2, NULL);
+    audioRenderStorage.create(audioRenderTask, "audioRender", NULL, 5);  // 2.9 ms blocks
+    scanKeysStorage.create(scanKeysTask, "scanKeys", NULL, 4);
+    displayUpdateStorage.create(displayUpdateTask, "displayUpdate", NULL, 1);
+    canTxStorage.create(CAN_TX_Task, "CAN_TX", NULL, 3);
+    canRxStorage.create(CAN_RX_Task, "CAN_RX", NULL, 3);
+    gameStorage.create(gameTask, "gameTask", NULL, 2);
+    canStatsStorage.create(canStatsTask, "canStats", NULL, 1);
+    #ifdef PCAL_KNOBS
+    knobExpanderStorage.create(knobExpanderTask, "knobExpander", NULL, 4);
+    #endif
+    #ifdef TRACE
+    traceDrainStorage.create(traceDrainTask, "traceDrain", NULL, 1);
+    #endif
     #endif
 
+    lockHeap();  // Everything is allocated by now
     vTaskStartScheduler();
 }
 
@@ -0,0 +1,50 @@
+#include "midi.hpp"
+
+bool MidiParser::feed(uint8_t byte, uint32_t time, KeyEvent& out) {
+    if (byte >= 0xF8) {
+        return false;  // Real-time: clock, start/stop, active sensing
+    }
+    if (byte >= 0xF0) {
+        status = 0;  // SysEx and system common: skip their data
+        count = 0;
+        return false;
+    }
+    if (byte & 0x80) {
+        status = byte;
+        count = 0;
+        return false;
+    }
+    if (!status) {
+        return false;
+    }
+
+    data[count++] = byte;
+    uint8_t type = status & 0xF0;
+    uint8_t length = (type == 0xC0 || type == 0xD0) ? 1 : 2;  // Program change, channel pressure
+    if (count < length) {
+        return false;
+    }
+    count = 0;  // The status stays for the next message
+    if ((type != 0x80 && type != 0x90) || data[0] < MIDI_NOTE_MIN || data[0] > MIDI_NOTE_MAX) {
+        return false;
+    }
+    uint8_t note = data[0] - MIDI_NOTE_OFFSET;
+    out = {time, (uint8_t)(note / 12), (uint8_t)(note % 12), (uint8_t)(type == 0x90 && data[1] > 0), 0};
+    return true;
+}
+
+uint8_t MidiWriter::encode(const KeyEvent& event, uint8_t* out) {
+    uint8_t note = event.octave * 12 + event.key + MIDI_NOTE_OFFSET;
+    if (note > MIDI_NOTE_MAX) {
+        return 0;
+    }
+    uint8_t n = 0;
+    if (!statusSent || event.time - lastTime >= MIDI_RUNNING_STATUS_MS * 1000) {
+        out[n++] = 0x90 | ((channel - 1) & 0x0F);
+        statusSent = true;
+    }
+    out[n++] = note;
+    out[n++] = event.pressed ? MIDI_VELOCITY : 0;
+    lastTime = event.time;
+    return n;
+}
@@ -0,0 +1,57 @@
+#ifndef MIDI_HPP
+#define MIDI_HPP
+
+#include <cstdint>
+#include "keys.hpp"
+
+// MIDI 1.0 byte stream on the serial port (SERIAL_MIDI). Incoming note messages become
+// key events of this module, so they take the same path as the local keys; local key
+// events go out as note messages on MIDI_CHANNEL.
+//
+// Synth note n (octave * 12 + key) is MIDI note n + MIDI_NOTE_OFFSET, so MIDI 60 is C4,
+// octave 4. MIDI notes outside the 9 octaves of the NoteMap are ignored.
+#define MIDI_NOTE_OFFSET 12
+#define MIDI_NOTE_MIN MIDI_NOTE_OFFSET
+#define MIDI_NOTE_MAX (MIDI_NOTE_OFFSET + 107)
+#define MIDI_VELOCITY 100           // The keys have no velocity
+#define MIDI_RUNNING_STATUS_MS 250  // The status byte is repeated after a gap this long
+
+// Receiver. Channel messages may omit their status byte while it is unchanged (running
+// status). Real-time bytes (0xF8-0xFF) can appear anywhere, even inside a message, and are
+// skipped without touching the running status. Any other system message cancels it, so
+// SysEx and system common data bytes are skipped until the next status byte. Notes are
+// accepted on every channel.
+class MidiParser {
+public:
+    // Feed one byte. Returns true when it completes a note-on or note-off, which is
+    // written straight into `out` with `time` and module 0. Note-on with velocity 0 is
+    // a release.
+    bool feed(uint8_t byte, uint32_t time, KeyEvent& out);
+    void reset() { status = 0; count = 0; }
+
+private:
+    uint8_t status = 0;  // Running status, 0 if none
+    uint8_t data[2] = {};
+    uint8_t count = 0;   // Data bytes of the current message so far
+};
+
+// Sender. Every event is a note-on, with velocity 0 for a release, so consecutive
+// messages share their status byte and a chord costs 2 bytes per note. The status byte is
+// sent again after MIDI_RUNNING_STATUS_MS of silence, so a host that has just connected
+// picks up the stream with the next note.
+class MidiWriter {
+public:
+    explicit MidiWriter(uint8_t channel) : channel(channel) {}
+    // Encode `event` into `out`. Returns the number of bytes (at most 3), or 0 if the note
+    // has no MIDI number.
+    uint8_t encode(const KeyEvent& event, uint8_t* out);
+    // The last message was not sent: the next one must carry its status byte
+    void reset() { statusSent = false; }
+
+private:
+    uint8_t channel;     // 1-16
+    bool statusSent = false;
+    uint32_t lastTime = 0;
+};
+
+#endif // MIDI_HPP
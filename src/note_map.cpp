@@ -0,0 +1,64 @@
+#include "note_map.hpp"
+#include <cstring>
+
+bool NoteMap::press(uint8_t module, uint8_t note) {
+    if (note >= NOTES || module >= MODULES) {
+        return false;
+    }
+    bool wasHeld = owner[note] != 0;
+    owner[note] |= 1 << module;
+    bits[note >> 5] |= 1UL << (note & 31);
+    return !wasHeld;
+}
+
+bool NoteMap::release(uint8_t module, uint8_t note) {
+    if (note >= NOTES || module >= MODULES || !(owner[note] & (1 << module))) {
+        return false;
+    }
+    owner[note] &= ~(1 << module);
+    if (owner[note]) {
+        return false;  // Still held by another module
+    }
+    bits[note >> 5] &= ~(1UL << (note & 31));
+    return true;
+}
+
+uint8_t NoteMap::releaseModule(uint8_t module, uint8_t* out) {
+    uint8_t count = 0;
+    for (uint8_t word = 0; word < 4; word++) {
+        uint32_t pending = bits[word];
+        while (pending) {
+            uint8_t note = word * 32 + __builtin_ctz(pending);
+            pending &= pending - 1;
+            if (release(module, note)) {
+                if (out) {
+                    out[count] = note;
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+void NoteMap::clear() {
+    memset(bits, 0, sizeof(bits));
+    memset(owner, 0, sizeof(owner));
+}
+
+int NoteMap::highest() const {
+    for (int word = 3; word >= 0; word--) {
+        if (bits[word]) {
+            return word * 32 + 31 - __builtin_clz(bits[word]);
+        }
+    }
+    return -1;
+}
+
+uint8_t NoteMap::count(uint8_t module) const {
+    uint8_t n = 0;
+    for (uint8_t note = 0; note < NOTES; note++) {
+        n += (owner[note] >> module) & 1;
+    }
+    return n;
+}
@@ -0,0 +1,37 @@
+#ifndef NOTE_MAP_HPP
+#define NOTE_MAP_HPP
+
+#include <cstdint>
+
+// Every note held across the whole keyboard: a 108-key bitmap (9 octaves x 12 keys)
+// plus, per key, a mask of the modules holding it. Two modules playing the same note
+// keep it sounding until both have released it, and a module that leaves the bus
+// can have exactly its own notes released.
+class NoteMap {
+public:
+    static const uint8_t NOTES = 108;   // Note = octave * 12 + key
+    static const uint8_t MODULES = 16;
+
+    // Returns true if the note started sounding (first owner)
+    bool press(uint8_t module, uint8_t note);
+    // Returns true if the note stopped sounding (last owner gone)
+    bool release(uint8_t module, uint8_t note);
+    // Release every note `module` holds. Returns how many stopped sounding, and writes
+    // them to `out` (NOTES entries at most) if it is not null.
+    uint8_t releaseModule(uint8_t module, uint8_t* out = nullptr);
+    void clear();
+
+    bool held(uint8_t note) const { return note < NOTES && (bits[note >> 5] >> (note & 31)) & 1; }
+    uint16_t owners(uint8_t note) const { return note < NOTES ? owner[note] : 0; }
+    bool empty() const { return !(bits[0] | bits[1] | bits[2] | bits[3]); }
+    // Highest held note, or -1
+    int highest() const;
+    // Number of held notes owned by `module`
+    uint8_t count(uint8_t module) const;
+
+private:
+    uint32_t bits[4] = {};          // Bit n set while note n has any owner
+    uint16_t owner[NOTES] = {};     // Bit m set while module m holds the note
+};
+
+#endif // NOTE_MAP_HPP
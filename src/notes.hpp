@@ -0,0 +1,15 @@
+#ifndef NOTES_HPP
+#define NOTES_HPP
+
+#include <cstdint>
+
+// Note names for key index 0 (C) to 11 (B), in flash
+static constexpr const char* NOTE_NAMES[12] = {
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
+};
+
+constexpr const char* noteName(uint8_t index) {
+    return index < 12 ? NOTE_NAMES[index] : "";
+}
+
+#endif // NOTES_HPP
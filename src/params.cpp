@@ -0,0 +1,78 @@
+#include "params.hpp"
+#ifdef ARDUINO
+#include <STM32FreeRTOS.h>
+// Writers run in more than one task (scanKeysTask, and knobExpanderTask with PCAL_KNOBS),
+// so each write holds a critical section around the sequence counter and the value. It is
+// a handful of instructions; listeners are called after it.
+#define PARAM_WRITE_BEGIN() taskENTER_CRITICAL()
+#define PARAM_WRITE_END() taskEXIT_CRITICAL()
+#else
+#define PARAM_WRITE_BEGIN()  // Host builds have a single writer
+#define PARAM_WRITE_END()
+#endif
+
+const ParamInfo ParamRegistry::INFO[PARAM_COUNT] = {
+    {"Vol", 0, 8, 8},
+    {"Wave", 0, WAVE_COUNT - 1, WAVE_SAW},
+    {"Oct", 0, 8, 4},
+    {"Cut", 0, 127, 127},
+};
+
+ParamRegistry params;
+
+ParamRegistry::ParamRegistry() {
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        values[i] = INFO[i].initial;
+    }
+}
+
+bool ParamRegistry::set(ParamId id, int32_t value) {
+    const ParamInfo& range = INFO[id];
+    value = value < range.min ? range.min : (value > range.max ? range.max : value);
+
+    PARAM_WRITE_BEGIN();
+    if (values[id] == value) {
+        PARAM_WRITE_END();
+        return false;
+    }
+    uint32_t seq = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&sequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&values[id], value, __ATOMIC_RELAXED);
+    __atomic_store_n(&sequence, seq + 2, __ATOMIC_RELEASE);
+    PARAM_WRITE_END();
+
+    uint8_t count = __atomic_load_n(&listenerCount, __ATOMIC_ACQUIRE);
+    for (uint8_t i = 0; i < count; i++) {
+        listeners[i].fn(id, value, listeners[i].context);
+    }
+    return true;
+}
+
+bool ParamRegistry::trySnapshot(ParamSnapshot& out) const {
+    uint32_t start = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+    if (start & 1) {
+        return false;
+    }
+    ParamSnapshot copy;
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        copy.values[i] = __atomic_load_n(&values[i], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&sequence, __ATOMIC_RELAXED) != start) {
+        return false;
+    }
+    out = copy;
+    return true;
+}
+
+bool ParamRegistry::addListener(ParamListener listener, void* context) {
+    uint8_t count = __atomic_load_n(&listenerCount, __ATOMIC_RELAXED);
+    if (count >= MAX_LISTENERS) {
+        return false;
+    }
+    listeners[count].fn = listener;
+    listeners[count].context = context;
+    __atomic_store_n(&listenerCount, count + 1, __ATOMIC_RELEASE);
+    return true;
+}
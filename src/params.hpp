@@ -0,0 +1,67 @@
+#ifndef PARAMS_HPP
+#define PARAMS_HPP
+
+#include <cstdint>
+
+enum ParamId : uint8_t {
+    PARAM_VOLUME = 0,  // 0-8, log taper as a right shift
+    PARAM_WAVEFORM,    // See Waveform
+    PARAM_OCTAVE,      // Octave of the local keys
+    PARAM_CUTOFF,      // One-pole low-pass, 127 is fully open
+    PARAM_COUNT
+};
+
+enum Waveform : uint8_t { WAVE_SAW = 0, WAVE_SQUARE, WAVE_TRIANGLE, WAVE_SINE, WAVE_COUNT };
+
+struct ParamInfo {
+    const char* name;  // Short label for the display
+    int32_t min;
+    int32_t max;
+    int32_t initial;
+};
+
+struct ParamSnapshot {
+    int32_t values[PARAM_COUNT];
+    int32_t operator[](ParamId id) const { return values[id]; }
+};
+
+typedef void (*ParamListener)(ParamId id, int32_t value, void* context);
+
+// Typed parameter store with seqlock publication. Readers take a consistent copy of every
+// value without locks. Writers may run in several tasks: set() serialises them with a short
+// critical section, so it must not be called from an ISR. Listeners are called in the
+// writer's context after each change.
+class ParamRegistry {
+public:
+    static const uint8_t MAX_LISTENERS = 4;
+
+    ParamRegistry();
+
+    static const ParamInfo& info(ParamId id) { return INFO[id]; }
+
+    // Clamp and publish a value; returns false if it did not change
+    bool set(ParamId id, int32_t value);
+    int32_t get(ParamId id) const { return __atomic_load_n(&values[id], __ATOMIC_RELAXED); }
+
+    // Copy all values. trySnapshot() never waits: it returns false and leaves `out`
+    // untouched if a write was in progress, so a high-priority reader can keep its last copy.
+    bool trySnapshot(ParamSnapshot& out) const;
+    void snapshot(ParamSnapshot& out) const { while (!trySnapshot(out)) {} }
+
+    bool addListener(ParamListener listener, void* context = nullptr);
+
+private:
+    static const ParamInfo INFO[PARAM_COUNT];
+
+    int32_t values[PARAM_COUNT];
+    uint32_t sequence = 0;  // Odd while a write is in progress
+    struct {
+        ParamListener fn;
+        void* context;
+    } listeners[MAX_LISTENERS] = {};
+    uint8_t listenerCount = 0;
+};
+
+extern ParamRegistry params;
+
+#endif // PARAMS_HPP
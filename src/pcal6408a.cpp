@@ -0,0 +1,20 @@
+#include "pcal6408a.hpp"
+
+bool PCAL6408A::begin() {
+    // {register, value} in the order they are written
+    const uint8_t config[][2] = {
+        {CONFIGURATION, 0xFF},       // All pins are inputs
+        {PULL_SELECT, 0xFF},         // Pull-ups rather than pull-downs
+        {PULL_ENABLE, 0xFF},         // Enable all pulls
+        {POLARITY_INVERSION, 0xFF},  // Read closed contacts as 1, like readCols()
+        {INPUT_LATCH, 0xFF},         // Hold short pulses until the inputs are read
+        {INTERRUPT_MASK, 0x00},      // Interrupt on any pin
+    };
+    for (const auto& entry : config) {
+        if (!bus.writeRegister(address, entry[0], entry[1])) {
+            return false;
+        }
+    }
+    uint8_t discard;
+    return readInputs(discard);  // Clear any pending interrupt
+}
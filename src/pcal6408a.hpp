@@ -0,0 +1,44 @@
+#ifndef PCAL6408A_HPP
+#define PCAL6408A_HPP
+
+#include <cstdint>
+
+// Register access to an I2C device. The firmware implements it on Wire; a host test
+// can implement it on an in-memory register file.
+class I2CBus {
+public:
+    virtual bool writeRegister(uint8_t address, uint8_t reg, uint8_t value) = 0;
+    virtual bool readRegister(uint8_t address, uint8_t reg, uint8_t& value) = 0;
+};
+
+// Driver for the PCAL6408A GPIO expander that reads the knobs on StackSynth v2.
+// P0..P7 are the A/B outputs of knobs 0..3, so knob k is bits 2k (A) and 2k+1 (B).
+class PCAL6408A {
+public:
+    static const uint8_t ADDRESS = 0x21;
+
+    enum Register : uint8_t {
+        INPUT_PORT = 0x00,
+        POLARITY_INVERSION = 0x02,
+        CONFIGURATION = 0x03,
+        INPUT_LATCH = 0x42,
+        PULL_ENABLE = 0x43,
+        PULL_SELECT = 0x44,
+        INTERRUPT_MASK = 0x45,
+        INTERRUPT_STATUS = 0x46
+    };
+
+    explicit PCAL6408A(I2CBus& bus, uint8_t address = ADDRESS) : bus(bus), address(address) {}
+
+    // All pins inputs with pull-ups, latched, inverted to match the key matrix, interrupts on
+    bool begin();
+
+    // Read the input register, which also clears the interrupt
+    bool readInputs(uint8_t& value) { return bus.readRegister(address, INPUT_PORT, value); }
+
+private:
+    I2CBus& bus;
+    uint8_t address;
+};
+
+#endif // PCAL6408A_HPP
@@ -8,6 +8,19 @@ const int RA0_PIN = D3, RA1_PIN = D6, RA2_PIN = D12, REN_PIN = A5;
 const int C0_PIN = A2, C1_PIN = D9, C2_PIN = A6, C3_PIN = D1;
 const int OUT_PIN = D11, OUTL_PIN = A4, OUTR_PIN = A3;
 const int JOYY_PIN = A0, JOYX_PIN = A1;
+const int KNOB_INT_PIN = D0;  // PCAL6408A INT# (PA10, StackSynth v2 only)
 const int DEN_BIT = 3, DRST_BIT = 4, HKOW_BIT = 5, HKOE_BIT = 6;
 
+// Key matrix input positions in sysState.inputs (bit index = row * 4 + column)
+const int KNOB3_A_BIT = 12, KNOB3_B_BIT = 13, KNOB2_A_BIT = 14, KNOB2_B_BIT = 15;
+const int KNOB1_A_BIT = 16, KNOB1_B_BIT = 17, KNOB0_A_BIT = 18, KNOB0_B_BIT = 19;
+const int KNOB2_S_BIT = 20, KNOB3_S_BIT = 21, JOYS_BIT = 22, HSW_BIT = 23;
+const int KNOB0_S_BIT = 24, KNOB1_S_BIT = 25, HSE_BIT = 27;
+const int INPUT_ROWS = 7;
+
+// Inputs that are mechanical switches and need debouncing (keys and knob/joystick buttons)
+const uint32_t KEYS_MASK = 0x00000FFF;
+const uint32_t DEBOUNCE_MASK = KEYS_MASK | (1UL << KNOB0_S_BIT) | (1UL << KNOB1_S_BIT)
+                             | (1UL << KNOB2_S_BIT) | (1UL << KNOB3_S_BIT) | (1UL << JOYS_BIT);
+
 #endif
@@ -0,0 +1,212 @@
+#include "recorder.hpp"
+#include <cstring>
+
+// Bytes kept free while recording so the take can still be closed with releases
+static const uint32_t RELEASE_RESERVE = 64;
+
+uint8_t Recorder::encode(uint8_t* dst, uint32_t deltaMs, const KeyEvent& event) {
+    uint32_t header = (deltaMs << 3) | (event.module & 0x07);
+    uint8_t n = 0;
+    while (header >= 0x80) {
+        dst[n++] = (header & 0x7F) | 0x80;
+        header >>= 7;
+    }
+    dst[n++] = header;
+    dst[n++] = (event.pressed ? 0x80 : 0) | ((event.octave * 12 + event.key) & 0x7F);
+    return n;
+}
+
+uint8_t Recorder::decode(const uint8_t* src, uint32_t& deltaMs, KeyEvent& event) {
+    uint32_t header = 0;
+    uint8_t n = 0;
+    uint8_t shift = 0;
+    do {
+        header |= (uint32_t)(src[n] & 0x7F) << shift;
+        shift += 7;
+    } while (src[n++] & 0x80);
+    uint8_t note = src[n] & 0x7F;
+    event.pressed = src[n++] >> 7;
+    event.octave = note / 12;
+    event.key = note % 12;
+    event.module = header & 0x07;
+    deltaMs = header >> 3;
+    return n;
+}
+
+void Recorder::setHeld(const KeyEvent& event, uint32_t* map) {
+    uint8_t note = event.octave * 12 + event.key;
+    if (event.pressed) {
+        map[note >> 5] |= (1UL << (note & 31));
+    } else {
+        map[note >> 5] &= ~(1UL << (note & 31));
+    }
+}
+
+void Recorder::record(uint32_t nowUs) {
+    length = 0;
+    loopLength = 0;
+    startUs = nowUs;
+    lastMs = 0;
+    cursor = 0;
+    memset(held, 0, sizeof(held));
+    overflow = false;
+    mode = RECORDING;
+}
+
+// Close the take: release anything still held so the loop cannot leave notes hanging
+void Recorder::closeTake(uint32_t nowUs) {
+    uint32_t endMs = (nowUs - startUs) / 1000;
+    if (endMs < lastMs) endMs = lastMs;
+    for (uint8_t note = 0; note < 128; note++) {
+        if (!(held[note >> 5] & (1UL << (note & 31)))) continue;
+        if (length + MAX_EVENT_BYTES > RECORDER_BYTES) {
+            overflow = true;
+            break;
+        }
+        KeyEvent release = {0, (uint8_t)(note / 12), (uint8_t)(note % 12), 0, 0};
+        length += encode(data + length, endMs - lastMs, release);
+        lastMs = endMs;
+    }
+    memset(held, 0, sizeof(held));
+    loopLength = endMs > 0 ? endMs : 1;
+    mode = IDLE;
+}
+
+void Recorder::play(uint32_t nowUs) {
+    if (mode == OVERDUBBING) {
+        mode = PLAYING;
+        return;
+    }
+    if (mode == RECORDING) {
+        closeTake(nowUs);
+    }
+    if (mode == PLAYING || loopLength == 0) {
+        return;
+    }
+    startUs = nowUs;
+    cursor = 0;
+    lastMs = 0;
+    mode = PLAYING;
+}
+
+void Recorder::overdub() {
+    if (mode == PLAYING) {
+        mode = OVERDUBBING;
+    }
+}
+
+// Emit the releases left by stop(), as many as fit. The rest stay for the next call.
+uint8_t Recorder::drainReleases(uint32_t nowUs, KeyEvent* out, uint8_t maxEvents) {
+    uint8_t count = 0;
+    for (uint8_t note = 0; note < 128 && count < maxEvents; note++) {
+        if (releases[note >> 5] & (1UL << (note & 31))) {
+            releases[note >> 5] &= ~(1UL << (note & 31));
+            out[count++] = {nowUs, (uint8_t)(note / 12), (uint8_t)(note % 12), 0, 0};
+        }
+    }
+    return count;
+}
+
+uint8_t Recorder::stop(uint32_t nowUs, KeyEvent* out, uint8_t maxEvents) {
+    if (mode == RECORDING) {
+        closeTake(nowUs);
+    }
+    if (mode == PLAYING || mode == OVERDUBBING) {
+        for (uint8_t i = 0; i < 4; i++) {
+            releases[i] |= held[i];
+        }
+        memset(held, 0, sizeof(held));
+    }
+    mode = IDLE;
+    return drainReleases(nowUs, out, maxEvents);
+}
+
+bool Recorder::capture(const KeyEvent& event) {
+    uint32_t offsetMs = (event.time - startUs) / 1000;
+
+    if (mode == RECORDING) {
+        uint32_t reserve = event.pressed ? RELEASE_RESERVE : 0;
+        if (length + MAX_EVENT_BYTES + reserve > RECORDER_BYTES) {
+            overflow = true;
+            return false;
+        }
+        if (offsetMs < lastMs) offsetMs = lastMs;
+        length += encode(data + length, offsetMs - lastMs, event);
+        lastMs = offsetMs;
+        setHeld(event, held);
+        return true;
+    }
+    if (mode == OVERDUBBING) {
+        if (offsetMs > loopLength) offsetMs = loopLength;
+        return insert(offsetMs, event);
+    }
+    return false;
+}
+
+// Insert an event just before the cursor and shorten the next event's delta to match
+bool Recorder::insert(uint32_t offsetMs, const KeyEvent& event) {
+    if (offsetMs < lastMs) offsetMs = lastMs;
+
+    uint8_t newBytes[MAX_EVENT_BYTES];
+    uint8_t nextBytes[MAX_EVENT_BYTES];
+    uint8_t newLen;
+    uint8_t nextLen = 0;
+    uint8_t oldNextLen = 0;
+
+    if (cursor < length) {
+        uint32_t nextDelta;
+        KeyEvent next;
+        oldNextLen = decode(data + cursor, nextDelta, next);
+        uint32_t nextMs = lastMs + nextDelta;
+        if (offsetMs > nextMs) offsetMs = nextMs;
+        nextLen = encode(nextBytes, nextMs - offsetMs, next);
+    }
+    newLen = encode(newBytes, offsetMs - lastMs, event);
+
+    uint32_t newLength = length + newLen + nextLen - oldNextLen;
+    if (newLength > RECORDER_BYTES) {
+        overflow = true;
+        return false;
+    }
+    uint32_t tail = cursor + oldNextLen;
+    memmove(data + cursor + newLen + nextLen, data + tail, length - tail);
+    memcpy(data + cursor, newBytes, newLen);
+    memcpy(data + cursor + newLen, nextBytes, nextLen);
+    length = newLength;
+    cursor += newLen;
+    lastMs = offsetMs;
+    return true;
+}
+
+uint8_t Recorder::poll(uint32_t nowUs, KeyEvent* out, uint8_t maxEvents) {
+    uint8_t count = drainReleases(nowUs, out, maxEvents);  // Those stop() had no room for
+    if (mode != PLAYING && mode != OVERDUBBING) {
+        return count;
+    }
+    uint32_t elapsedMs = (nowUs - startUs) / 1000;
+
+    while (count < maxEvents) {
+        if (cursor < length) {
+            uint32_t deltaMs;
+            KeyEvent event;
+            uint8_t n = decode(data + cursor, deltaMs, event);
+            if (lastMs + deltaMs > elapsedMs) {
+                break;
+            }
+            cursor += n;
+            lastMs += deltaMs;
+            event.time = startUs + lastMs * 1000;
+            setHeld(event, held);
+            out[count++] = event;
+        } else if (elapsedMs >= loopLength) {
+            // End of the loop: start the next pass
+            startUs += loopLength * 1000;
+            elapsedMs -= loopLength;
+            cursor = 0;
+            lastMs = 0;
+        } else {
+            break;
+        }
+    }
+    return count;
+}
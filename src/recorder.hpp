@@ -0,0 +1,65 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <cstdint>
+#include "keys.hpp"
+
+#define RECORDER_BYTES 4096
+
+// Records key events into a static buffer and plays them back in a loop.
+// Each event is stored as a varint of (delta_ms << 3 | module) followed by one byte
+// of (pressed << 7 | octave * 12 + key), so a typical event takes 3 bytes and
+// several minutes of playing fit in RECORDER_BYTES.
+// All times passed in are micros() timestamps; deltas are stored in milliseconds.
+class Recorder {
+public:
+    enum State : uint8_t { IDLE, RECORDING, PLAYING, OVERDUBBING };
+
+    static const uint8_t MAX_EVENT_BYTES = 6;  // 5-byte varint + note byte
+
+    // Start a new take, discarding the previous one
+    void record(uint32_t nowUs);
+    // Close the take (the loop ends now) or resume looping after an overdub
+    void play(uint32_t nowUs);
+    // Merge live events into the loop while it keeps playing
+    void overdub();
+    // Stop playback; releases for notes still held by the loop are written to `out`. Those
+    // that do not fit in `maxEvents` are returned by the following poll() calls.
+    uint8_t stop(uint32_t nowUs, KeyEvent* out, uint8_t maxEvents);
+
+    // Store a live event while recording or overdubbing. Returns false if it was not stored.
+    bool capture(const KeyEvent& event);
+    // Fetch the playback events that are due at nowUs, or the releases left over by stop()
+    uint8_t poll(uint32_t nowUs, KeyEvent* out, uint8_t maxEvents);
+
+    State state() const { return mode; }
+    uint32_t size() const { return length; }
+    uint32_t loopMs() const { return loopLength; }
+    bool overflowed() const { return overflow; }
+    const uint8_t* bytes() const { return data; }
+
+    // Event encoding, exposed for host tests
+    static uint8_t encode(uint8_t* dst, uint32_t deltaMs, const KeyEvent& event);
+    static uint8_t decode(const uint8_t* src, uint32_t& deltaMs, KeyEvent& event);
+
+private:
+    void closeTake(uint32_t nowUs);
+    uint8_t drainReleases(uint32_t nowUs, KeyEvent* out, uint8_t maxEvents);
+    bool insert(uint32_t offsetMs, const KeyEvent& event);
+    void setHeld(const KeyEvent& event, uint32_t* map);
+
+    uint8_t data[RECORDER_BYTES];
+    uint32_t length = 0;        // Bytes used
+    uint32_t loopLength = 0;    // Loop duration in ms
+    uint32_t startUs = 0;       // Recording: take start. Playing: start of the current pass
+    uint32_t lastMs = 0;        // Offset of the last event before the cursor
+    uint32_t cursor = 0;        // Byte offset of the next event to play
+    uint32_t held[4] = {};      // Notes pressed in the take (recording) or by playback
+    uint32_t releases[4] = {};  // Playback notes stopped but not yet released
+    State mode = IDLE;
+    bool overflow = false;
+};
+
+extern Recorder recorder;  // Driven by scanKeysTask
+
+#endif // RECORDER_HPP
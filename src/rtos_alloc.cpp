@@ -0,0 +1,83 @@
+#include "rtos_alloc.hpp"
+#include <Arduino.h>
+
+#ifdef STATIC_ALLOCATION
+
+static volatile bool heapLocked = false;
+
+void lockHeap() {
+    heapLocked = true;
+}
+
+// Somewhere allocated after startup. Stop here so the debugger shows the caller.
+extern "C" void heapAllocationAfterStartup() {
+    taskDISABLE_INTERRUPTS();
+    while (1);
+}
+
+// -Wl,--wrap=<symbol> in platformio.ini sends every allocation through these
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void* __real__malloc_r(struct _reent* reent, size_t size);
+void* __real__calloc_r(struct _reent* reent, size_t count, size_t size);
+void* __real__realloc_r(struct _reent* reent, void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    if (heapLocked) heapAllocationAfterStartup();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    if (heapLocked) heapAllocationAfterStartup();
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    if (heapLocked) heapAllocationAfterStartup();
+    return __real_realloc(pointer, size);
+}
+
+void* __wrap__malloc_r(struct _reent* reent, size_t size) {
+    if (heapLocked) heapAllocationAfterStartup();
+    return __real__malloc_r(reent, size);
+}
+
+void* __wrap__calloc_r(struct _reent* reent, size_t count, size_t size) {
+    if (heapLocked) heapAllocationAfterStartup();
+    return __real__calloc_r(reent, count, size);
+}
+
+void* __wrap__realloc_r(struct _reent* reent, void* pointer, size_t size) {
+    if (heapLocked) heapAllocationAfterStartup();
+    return __real__realloc_r(reent, pointer, size);
+}
+}
+
+// Memory for the tasks the kernel creates itself, required with static allocation
+static StaticTask_t idleTaskTCB;
+static StackType_t idleTaskStack[configMINIMAL_STACK_SIZE];
+
+extern "C" void vApplicationGetIdleTaskMemory(StaticTask_t** tcb, StackType_t** stack, uint32_t* stackSize) {
+    *tcb = &idleTaskTCB;
+    *stack = idleTaskStack;
+    *stackSize = configMINIMAL_STACK_SIZE;
+}
+
+#if configUSE_TIMERS
+static StaticTask_t timerTaskTCB;
+static StackType_t timerTaskStack[configTIMER_TASK_STACK_DEPTH];
+
+extern "C" void vApplicationGetTimerTaskMemory(StaticTask_t** tcb, StackType_t** stack, uint32_t* stackSize) {
+    *tcb = &timerTaskTCB;
+    *stack = timerTaskStack;
+    *stackSize = configTIMER_TASK_STACK_DEPTH;
+}
+#endif
+
+#else
+
+void lockHeap() {}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef RTOS_ALLOC_HPP
+#define RTOS_ALLOC_HPP
+
+#include <STM32FreeRTOS.h>
+
+#if defined(STATIC_ALLOCATION) && !configSUPPORT_STATIC_ALLOCATION
+#error "STATIC_ALLOCATION needs configSUPPORT_STATIC_ALLOCATION=1, see the nucleo_l432kc_static environment"
+#endif
+
+// Storage for FreeRTOS objects. With STATIC_ALLOCATION (the nucleo_l432kc_static build,
+// which also sets configSUPPORT_STATIC_ALLOCATION) the TCBs, stacks and queue buffers are
+// placed in .bss by these objects; otherwise they are empty and the objects come from the
+// FreeRTOS heap as before. Declare one storage object per RTOS object, at file scope.
+
+template <uint32_t STACK_WORDS>
+class TaskStorage {
+public:
+    TaskHandle_t create(TaskFunction_t function, const char* name, void* parameters, UBaseType_t priority) {
+        #ifdef STATIC_ALLOCATION
+        return xTaskCreateStatic(function, name, STACK_WORDS, parameters, priority, stack, &tcb);
+        #else
+        TaskHandle_t handle = NULL;
+        xTaskCreate(function, name, STACK_WORDS, parameters, priority, &handle);
+        return handle;
+        #endif
+    }
+
+private:
+    #ifdef STATIC_ALLOCATION
+    StackType_t stack[STACK_WORDS];
+    StaticTask_t tcb;
+    #endif
+};
+
+class SemaphoreStorage {
+public:
+    SemaphoreHandle_t createBinary() {
+        #ifdef STATIC_ALLOCATION
+        return xSemaphoreCreateBinaryStatic(&buffer);
+        #else
+        return xSemaphoreCreateBinary();
+        #endif
+    }
+
+    SemaphoreHandle_t createMutex() {
+        #ifdef STATIC_ALLOCATION
+        return xSemaphoreCreateMutexStatic(&buffer);
+        #else
+        return xSemaphoreCreateMutex();
+        #endif
+    }
+
+    SemaphoreHandle_t createCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+        #ifdef STATIC_ALLOCATION
+        return xSemaphoreCreateCountingStatic(maxCount, initialCount, &buffer);
+        #else
+        return xSemaphoreCreateCounting(maxCount, initialCount);
+        #endif
+    }
+
+private:
+    #ifdef STATIC_ALLOCATION
+    StaticSemaphore_t buffer;
+    #endif
+};
+
+template <uint32_t LENGTH, uint32_t ITEM_SIZE>
+class QueueStorage {
+public:
+    QueueHandle_t create() {
+        #ifdef STATIC_ALLOCATION
+        return xQueueCreateStatic(LENGTH, ITEM_SIZE, items, &queue);
+        #else
+        return xQueueCreate(LENGTH, ITEM_SIZE);
+        #endif
+    }
+
+private:
+    #ifdef STATIC_ALLOCATION
+    uint8_t items[LENGTH * ITEM_SIZE];
+    StaticQueue_t queue;
+    #endif
+};
+
+// Called just before the scheduler starts. With STATIC_ALLOCATION, any heap allocation
+// after this point halts in heapAllocationAfterStartup() (malloc is wrapped by the linker).
+// That includes libc functions that allocate their state on first use: newlib-nano's
+// rand(), strtok() and the time functions do, and so does stdio without a buffer set up.
+// Tasks must not call them unless they have already been called before the lock.
+void lockHeap();
+
+#endif // RTOS_ALLOC_HPP
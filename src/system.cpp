@@ -2,23 +2,25 @@
 #include "pindef.hpp"
 #include <U8g2lib.h>
 #include <STM32FreeRTOS.h>
+#include "rtos_alloc.hpp"
+#include "can_protocol.hpp"
 
-uint8_t globalRXMessage[8] = {0};
 SemaphoreHandle_t sysMutex;
 QueueHandle_t msgInQ ;
 QueueHandle_t msgOutQ;
-SemaphoreHandle_t CAN_TX_Semaphore;
-uint8_t prevKnobState = 0;
+SemaphoreHandle_t i2cMutex;
 
-bool canTxSuccess = false;
-bool canRxSuccess = false;
+static SemaphoreStorage sysMutexStorage;
+static QueueStorage<36, sizeof(CANFrame)> msgInQStorage;
+static QueueStorage<36, sizeof(CANFrame)> msgOutQStorage;
+static SemaphoreStorage i2cMutexStorage;
+static SemaphoreStorage sysStateMutexStorage;
 
 
 SystemState sysState = {
     .inputs = 0,
     .mutex = nullptr,  // Will be initialized in initSystem()
     .areAllKnobSPressed = false,
-    .knob3Rotation = 0,
     .keyStates = 0
 };
 
@@ -51,10 +53,10 @@ std::bitset<4> readCols() {
 }
 
 void initSystem() {
-    sysMutex = xSemaphoreCreateMutex();
-    msgInQ = xQueueCreate(36, 8);
-    msgOutQ = xQueueCreate(36, 8);
-    CAN_TX_Semaphore = xSemaphoreCreateCounting(3, 3);
+    sysMutex = sysMutexStorage.createMutex();
+    msgInQ = msgInQStorage.create();
+    msgOutQ = msgOutQStorage.create();
+    i2cMutex = i2cMutexStorage.createMutex();
 
     pinMode(RA0_PIN, OUTPUT); pinMode(RA1_PIN, OUTPUT); pinMode(RA2_PIN, OUTPUT);
     pinMode(REN_PIN, OUTPUT); pinMode(OUT_PIN, OUTPUT); pinMode(OUTL_PIN, OUTPUT);
@@ -67,6 +69,5 @@ void initSystem() {
     setOutMuxBit(DRST_BIT, HIGH);
     setOutMuxBit(DEN_BIT, HIGH);
 
-    sysState.mutex = xSemaphoreCreateMutex();
-    sysState.knob3Rotation = 8;  // Initialize knob rotation to maximum (no attenuation)
+    sysState.mutex = sysStateMutexStorage.createMutex();
 }
@@ -8,15 +8,12 @@
 #include <STM32FreeRTOS.h>
 
 // Global System State
-extern uint8_t globalRXMessage[8];  
 extern SemaphoreHandle_t sysMutex;
 
 // Queues and Semaphores
-extern QueueHandle_t msgInQ;
-extern QueueHandle_t msgOutQ;
-extern SemaphoreHandle_t CAN_TX_Semaphore;
-
-extern uint8_t prevKnobState;
+extern QueueHandle_t msgInQ;   // CANFrame items
+extern QueueHandle_t msgOutQ;  // CANFrame items
+extern SemaphoreHandle_t i2cMutex;  // Shared by the display and the knob expander
 
 void initSystem();  // Function to initialize all system components
 void setRow(uint8_t row);
@@ -27,13 +24,10 @@ struct SystemState {
     SemaphoreHandle_t mutex;
     bool areAllKnobSPressed;
     bool gameActiveOverride = false;
-    int knob3Rotation;
     std::bitset<12> keyStates;
+    uint8_t displayView = 0;  // DisplayView, cycled with the knob 3 button
 };
 
 extern SystemState sysState;
 
-extern bool canTxSuccess;
-extern bool canRxSuccess;
-
 #endif // SYSTEM_HPP
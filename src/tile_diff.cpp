@@ -0,0 +1,33 @@
+#include "tile_diff.hpp"
+#include <cstring>
+
+uint8_t TileDiff::diff(const uint8_t* frame, TileRun* runs) {
+    uint8_t count = 0;
+    for (uint8_t y = 0; y < DISPLAY_TILES_Y; y++) {
+        const uint8_t* row = frame + y * DISPLAY_TILES_X * 8;
+        uint8_t* sent = shadow + y * DISPLAY_TILES_X * 8;
+        bool inRun = false;
+        for (uint8_t x = 0; x < DISPLAY_TILES_X; x++) {
+            bool dirty = !valid || memcmp(row + x * 8, sent + x * 8, 8) != 0;
+            if (dirty) {
+                memcpy(sent + x * 8, row + x * 8, 8);
+                if (inRun) {
+                    runs[count - 1].width++;
+                } else {
+                    runs[count++] = {x, y, 1};
+                }
+            }
+            inRun = dirty;
+        }
+    }
+    valid = true;
+    return count;
+}
+
+uint32_t TileDiff::transferBytes(const TileRun* runs, uint8_t count) {
+    uint32_t bytes = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        bytes += RUN_OVERHEAD + runs[i].width * 8;
+    }
+    return bytes;
+}
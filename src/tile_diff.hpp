@@ -0,0 +1,39 @@
+#ifndef TILE_DIFF_HPP
+#define TILE_DIFF_HPP
+
+#include <cstdint>
+
+#define DISPLAY_TILES_X 16  // 128 px
+#define DISPLAY_TILES_Y 4   // 32 px
+
+// A horizontal run of changed 8x8 tiles within one tile row
+struct TileRun {
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;
+};
+
+// Compares each frame with the last one sent to the display, one 8x8 tile at a time.
+// Works on the U8g2 full-buffer layout: tile row y starts at y * 128 bytes and
+// tile x is the 8 column bytes from x * 8.
+class TileDiff {
+public:
+    static const uint8_t MAX_RUNS = DISPLAY_TILES_X / 2 * DISPLAY_TILES_Y;
+    static const uint8_t RUN_OVERHEAD = 8;  // I2C bytes to address a run: page, column, control
+
+    // Find the changed tiles of `frame` and record them as sent.
+    // Fills `runs` (at least MAX_RUNS long) and returns how many there are.
+    uint8_t diff(const uint8_t* frame, TileRun* runs);
+
+    // Treat every tile as changed on the next diff
+    void invalidate() { valid = false; }
+
+    // I2C bytes needed to send `count` runs, including per-run addressing
+    static uint32_t transferBytes(const TileRun* runs, uint8_t count);
+
+private:
+    uint8_t shadow[DISPLAY_TILES_X * DISPLAY_TILES_Y * 8];
+    bool valid = false;
+};
+
+#endif // TILE_DIFF_HPP
@@ -0,0 +1,49 @@
+#include "trace.hpp"
+
+#ifdef TRACE
+#include <STM32FreeRTOS.h>
+#include <cstdio>
+
+TraceRecord traceBuffer[TRACE_SIZE];
+uint32_t traceHead = 0;
+
+void initTrace() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static void printRecord(uint32_t seq, uint32_t cycles, uint8_t event, uint16_t arg) {
+    char line[32];
+    snprintf(line, sizeof(line), TRACE_LINE_FORMAT, (unsigned long)seq, (unsigned long)cycles, event, arg);
+    Serial.println(line);
+}
+
+void traceDrainTask(void *pvParameters) {
+    uint32_t tail = 0;  // Index of the next record to print
+
+    while (1) {
+        uint32_t head = __atomic_load_n(&traceHead, __ATOMIC_ACQUIRE);
+        if (head - tail > TRACE_SIZE) {
+            // The writers lapped us: skip to the oldest record that can still be intact
+            uint32_t lost = head - TRACE_SIZE - tail;
+            printRecord(tail + 1, DWT->CYCCNT, TRACE_LOST, lost > 0xFFFF ? 0xFFFF : lost);
+            tail = head - TRACE_SIZE;
+        }
+        while (tail != head) {
+            TraceRecord& slot = traceBuffer[tail & (TRACE_SIZE - 1)];
+            uint32_t seq = __atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE);
+            if (seq != tail + 1) {
+                break;  // Reserved but not written yet, or already overwritten
+            }
+            TraceRecord record = slot;
+            if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != seq) {
+                break;  // Overwritten while copying; the lap check above handles it
+            }
+            printRecord(record.seq, record.cycles, record.event, record.arg);
+            tail++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+#endif
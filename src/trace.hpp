@@ -0,0 +1,71 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include "config.hpp"
+
+// Binary event trace. trace() stores {event, DWT cycle count, argument} in a lock-free ring
+// in a handful of cycles, from tasks or ISRs, and traceDrainTask prints the records over the
+// serial port at the lowest priority. tools/trace_decode.cpp turns a capture into a timeline.
+
+// Spans come in pairs: an even BEGIN followed by its END, so the decoder can time them
+enum TraceEvent : uint8_t {
+    TRACE_LOST = 0,             // arg: records overwritten before they were drained
+    TRACE_MARK,                 // arg: free for ad-hoc use
+    TRACE_CAN_RX_ISR_BEGIN = 2, // arg: receive FIFO
+    TRACE_CAN_RX_ISR_END,       // arg: frames drained
+    TRACE_CAN_TX_ISR_BEGIN,
+    TRACE_CAN_TX_ISR_END,
+    TRACE_CAN_RX_TASK_BEGIN,
+    TRACE_CAN_RX_TASK_END,      // arg: first message byte
+    TRACE_CAN_TX_BEGIN,         // arg: first message byte
+    TRACE_CAN_TX_END,           // arg: CAN_TX result
+    TRACE_EVENT_COUNT
+};
+
+static constexpr const char* TRACE_EVENT_NAMES[TRACE_EVENT_COUNT] = {
+    "lost", "mark",
+    "CAN_RX_ISR", "CAN_RX_ISR",
+    "CAN_TX_ISR", "CAN_TX_ISR",
+    "CAN_RX_Task", "CAN_RX_Task",
+    "CAN_TX", "CAN_TX",
+};
+
+struct TraceRecord {
+    uint32_t seq;     // Write index + 1 once the record is complete
+    uint32_t cycles;  // DWT->CYCCNT at the event
+    uint16_t arg;
+    uint8_t event;
+};
+
+// Drain output, one record per line: '@' then seq, cycles, event and arg in hex
+#define TRACE_LINE_FORMAT "@%08lx %08lx %02x %04x"
+
+#define TRACE_SIZE 128  // Records, a power of two
+
+#ifdef TRACE
+#include <Arduino.h>
+
+extern TraceRecord traceBuffer[TRACE_SIZE];
+extern uint32_t traceHead;
+
+// Reserve a slot with one atomic add, fill it, then publish it through its sequence number.
+// A writer that falls a whole ring behind the drain task overwrites the oldest records.
+inline void trace(TraceEvent event, uint16_t arg = 0) {
+    uint32_t cycles = DWT->CYCCNT;
+    uint32_t index = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED);
+    TraceRecord& record = traceBuffer[index & (TRACE_SIZE - 1)];
+    record.cycles = cycles;
+    record.arg = arg;
+    record.event = event;
+    __atomic_store_n(&record.seq, index + 1, __ATOMIC_RELEASE);
+}
+
+void initTrace();  // Start the DWT cycle counter
+void traceDrainTask(void *pvParameters);
+#else
+inline void trace(TraceEvent, uint16_t = 0) {}
+inline void initTrace() {}
+#endif
+
+#endif // TRACE_HPP
@@ -0,0 +1,253 @@
+#include "voice.hpp"
+#include "keys.hpp"
+#include "audio.hpp"
+#include "system.hpp"
+#include "fixed_point.hpp"
+#include "can_bus.hpp"
+#include "note_map.hpp"
+#include "voice_alloc.hpp"
+#include "config.hpp"
+#include <cmath>
+
+// Phase steps for octave 4, from C4 to B4 (A4 = 440 Hz)
+struct StepTable {
+    uint32_t step[12];
+};
+
+static constexpr StepTable makeStepTable() {
+    StepTable table = {};
+    const double semitone = 1.0594630943592953;  // 2^(1/12)
+    double freq = 440.0;
+    for (int i = 0; i < 9; i++) {
+        freq /= semitone;  // Down from A4 to C4
+    }
+    for (int i = 0; i < 12; i++) {
+        table.step[i] = (uint32_t)(4294967296.0 * freq / SAMPLE_RATE);
+        freq *= semitone;
+    }
+    return table;
+}
+
+static constexpr StepTable noteSteps = makeStepTable();
+
+#define VIBRATO_RATE_HZ 5
+#define VIBRATO_CENTS 50  // Depth at full modulation
+
+// Vibrato LFO phase step per block
+static constexpr uint32_t LFO_STEP =
+    (uint32_t)(4294967296.0 * VIBRATO_RATE_HZ * AUDIO_BLOCK / SAMPLE_RATE);
+
+static NoteMap heldNotes;  // Notes held on every module, only touched by the render task
+static int8_t sineTable[256];
+
+void voiceInit() {
+    for (int i = 0; i < 256; i++) {
+        sineTable[i] = (int8_t)lround(127.0 * sin(2.0 * M_PI * i / 256.0));
+    }
+}
+
+static uint32_t noteStep(uint8_t note) {
+    int8_t octaveShift = note / 12 - 4;
+    uint32_t step = noteSteps.step[note % 12];
+    return octaveShift >= 0 ? step << octaveShift : step >> -octaveShift;
+}
+
+#ifdef DISTRIBUTED_VOICES
+static_assert(VOICES_PER_MODULE >= 1 && VOICES_PER_MODULE <= 15,
+              "The load in key-state frames is 4 bits");
+
+struct Voice {
+    uint32_t phase;
+    uint32_t step;
+    uint32_t started;  // Start order; the oldest voice is stolen when all are busy
+    uint8_t note;
+    uint8_t origin;    // Module whose key holds the note
+    bool active;
+};
+
+static Voice voices[VOICES_PER_MODULE];
+static uint32_t voiceStarts = 0;
+
+static void startVoice(const VoiceAssignment& assign) {
+    if (assign.note >= NoteMap::NOTES) {
+        return;
+    }
+    Voice* slot = nullptr;
+    for (Voice& voice : voices) {
+        if (voice.active && voice.note == assign.note && voice.origin == assign.origin) {
+            return;  // Already playing
+        }
+        if (!slot || (slot->active && (!voice.active || voice.started < slot->started))) {
+            slot = &voice;
+        }
+    }
+    *slot = {0, noteStep(assign.note), voiceStarts++, assign.note, assign.origin, true};
+}
+
+// Start the voices assigned to this module and stop those whose key has been released.
+// Assignments are drained before the key events: the press behind each one was published
+// first, so it is in the events drained after, and a voice never outlives its key.
+static void startAssignedVoices() {
+    static uint32_t epoch = 0;
+    if (epoch != handshake.epoch()) {
+        // Re-enumerated: module IDs have changed, so have the owners of every note
+        epoch = handshake.epoch();
+        heldNotes.clear();
+        for (Voice& voice : voices) {
+            voice.active = false;
+        }
+    }
+    VoiceAssignment assign;
+    while (voiceAssignments.pop(0, assign) || localVoiceAssignments.pop(0, assign)) {
+        startVoice(assign);
+    }
+}
+
+static void stopReleasedVoices() {
+    uint8_t active = 0;
+    for (Voice& voice : voices) {
+        if (voice.active && !((heldNotes.owners(voice.note) >> voice.origin) & 1)) {
+            voice.active = false;
+        }
+        active += voice.active;
+    }
+    // Our load goes out in the next key-state frame
+    uint8_t position = handshake.position();
+    if (voiceAllocator.load(position) != active) {
+        voiceAllocator.report(position, active);
+        notifyCANTx();
+    }
+}
+#endif
+
+// Merge one key event into the NoteMap. Returns true if a note started or stopped sounding.
+static bool applyKeyEvent(const KeyEvent& event, uint8_t module) {
+    uint8_t note = event.octave * 12 + event.key;
+    return event.pressed ? heldNotes.press(module, note) : heldNotes.release(module, note);
+}
+
+void voiceProcessEvents() {
+    KeyEvent event;
+    bool changed = false;
+    #ifdef DISTRIBUTED_VOICES
+    bool tracking = true;  // Every module renders its share of the notes
+    startAssignedVoices();
+    #else
+    bool tracking = handshake.isReceiver();  // Only the westmost module plays; the others just send their keys
+    #endif
+
+    // Local keys belong to this module's position, remote ones to the module that sent them
+    while (keyEvents.pop(KEY_READER_VOICE, event)) {
+        if (tracking) {
+            changed |= applyKeyEvent(event, handshake.position() & 0xF);
+        }
+    }
+    while (remoteKeyEvents.pop(0, event)) {
+        if (tracking) {
+            changed |= applyKeyEvent(event, event.module & 0xF);
+        }
+    }
+
+    // Modules that have left the bus lose every note they owned, even if a release was dropped
+    uint16_t departed = __atomic_exchange_n(&departedModules, 0, __ATOMIC_ACQUIRE);
+    while (departed) {
+        uint8_t module = __builtin_ctz(departed);
+        departed &= departed - 1;
+        changed |= heldNotes.releaseModule(module) > 0;
+    }
+
+    #ifdef DISTRIBUTED_VOICES
+    stopReleasedVoices();
+    #else
+    if (!tracking && !heldNotes.empty()) {
+        heldNotes.clear();  // Became a sender with notes still held
+        changed = true;
+    }
+    if (!changed || __atomic_load_n(&sysState.gameActiveOverride, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    // Highest held note wins, as before
+    int note = heldNotes.highest();
+    __atomic_store_n(&currentStepSize, note >= 0 ? noteStep(note) : 0, __ATOMIC_RELAXED);
+    #endif
+}
+
+// One oscillator sample from -128 to 127
+static inline int32_t oscillator(uint32_t phase, uint8_t wave) {
+    int32_t p = phase >> 24;
+    switch (wave) {
+        case WAVE_SQUARE:   return p < 128 ? 127 : -128;
+        case WAVE_TRIANGLE: return p < 128 ? 2 * p - 128 : 383 - 2 * p;
+        case WAVE_SINE:     return sineTable[p];
+        default:            return p - 128;  // Sawtooth
+    }
+}
+
+// Oscillators to render this block: every voice assigned to this module, or the single
+// note in currentStepSize without DISTRIBUTED_VOICES and while the game drives the output.
+// Returns how many were written to `phases` and `steps`.
+static uint8_t collectOscillators(uint32_t** phases, uint32_t* steps) {
+    static uint32_t phaseAcc = 0;
+    #ifdef DISTRIBUTED_VOICES
+    if (!__atomic_load_n(&sysState.gameActiveOverride, __ATOMIC_RELAXED)) {
+        uint8_t count = 0;
+        for (Voice& voice : voices) {
+            if (voice.active) {
+                phases[count] = &voice.phase;
+                steps[count++] = voice.step;
+            }
+        }
+        return count;
+    }
+    #endif
+    phases[0] = &phaseAcc;
+    steps[0] = __atomic_load_n(&currentStepSize, __ATOMIC_RELAXED);
+    return 1;
+}
+
+void voiceRender(uint8_t* out, uint32_t count, const ParamSnapshot& snapshot,
+                 const JoystickState& joystick) {
+    static int32_t filterState = 0;  // Low-pass output in Q8
+    static uint32_t lfoPhase = 0;
+
+    uint32_t* phaseRefs[VOICES_PER_MODULE];
+    uint32_t phases[VOICES_PER_MODULE];
+    uint32_t steps[VOICES_PER_MODULE];
+    uint8_t oscillators = collectOscillators(phaseRefs, steps);
+
+    // Pitch bend plus a triangle vibrato, applied to the steps once per block
+    lfoPhase += LFO_STEP;
+    int32_t lfo = lfoPhase < 0x80000000 ? (int32_t)(lfoPhase >> 16) - 16384
+                                        : 49151 - (int32_t)(lfoPhase >> 16);  // +-16384
+    int32_t cents = joystick.bendCents +
+                    lfo * VIBRATO_CENTS * joystick.modDepth / (16384 * JOY_MOD_MAX);
+    uint32_t ratio = cents != 0 ? centsToRatioQ16(cents) : 1 << 16;
+    for (uint8_t v = 0; v < oscillators; v++) {
+        phases[v] = *phaseRefs[v];
+        steps[v] = ((uint64_t)steps[v] * ratio) >> 16;
+    }
+    uint8_t wave = snapshot[PARAM_WAVEFORM];
+    uint8_t volumeShift = 8 - snapshot[PARAM_VOLUME];
+    int32_t alpha = snapshot[PARAM_CUTOFF] + 1;  // 1 to 128, 128 passes the input through
+    int32_t mixGain = oscillators > 1 ? 256 / oscillators : 256;  // Q8: the sum of full-scale voices stays in range
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t sample = 0;
+        for (uint8_t v = 0; v < oscillators; v++) {
+            phases[v] += steps[v];
+            sample += oscillator(phases[v], wave);
+        }
+        sample = (sample * mixGain) >> 8;
+        filterState += ((sample * 256 - filterState) * alpha) >> 7;
+        // Apply volume control using right shift.
+        int32_t Vout = (filterState >> 8) >> volumeShift;
+        if (Vout > 127) Vout = 127;
+        if (Vout < -128) Vout = -128;
+        out[i] = Vout + 128;
+    }
+
+    for (uint8_t v = 0; v < oscillators; v++) {
+        *phaseRefs[v] = phases[v];
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef VOICE_HPP
+#define VOICE_HPP
+
+#include <cstdint>
+#include "params.hpp"
+#include "joystick.hpp"
+
+void voiceInit();
+
+// Drain pending key events and update the playing note
+void voiceProcessEvents();
+
+// Render `count` unsigned 8-bit samples with the parameters and joystick position of this block
+void voiceRender(uint8_t* out, uint32_t count, const ParamSnapshot& snapshot,
+                 const JoystickState& joystick);
+
+#endif // VOICE_HPP
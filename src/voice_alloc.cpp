@@ -0,0 +1,44 @@
+#include "voice_alloc.hpp"
+
+void VoiceAllocator::report(uint8_t module, uint8_t load) {
+    if (module < MODULES) {
+        __atomic_store_n(&loads[module], load, __ATOMIC_RELAXED);
+    }
+}
+
+void VoiceAllocator::assigned(uint8_t module) {
+    if (module < MODULES && __atomic_load_n(&loads[module], __ATOMIC_RELAXED) < 0xFF) {
+        __atomic_fetch_add(&loads[module], 1, __ATOMIC_RELAXED);
+    }
+}
+
+uint8_t VoiceAllocator::load(uint8_t module) const {
+    return module < MODULES ? __atomic_load_n(&loads[module], __ATOMIC_RELAXED) : 0xFF;
+}
+
+void VoiceAllocator::reset() {
+    for (uint8_t module = 0; module < MODULES; module++) {
+        __atomic_store_n(&loads[module], 0, __ATOMIC_RELAXED);
+    }
+}
+
+uint8_t VoiceAllocator::choose(uint8_t origin, uint8_t modules) const {
+    if (modules > MODULES) {
+        modules = MODULES;
+    }
+    if (origin >= modules) {
+        return origin;
+    }
+    // Walk east from the origin, so a strictly lower load is needed to move a note further away
+    uint8_t best = origin;
+    uint8_t bestLoad = load(origin);
+    for (uint8_t step = 1; step < modules; step++) {
+        uint8_t module = (origin + step) % modules;
+        uint8_t moduleLoad = load(module);
+        if (moduleLoad < bestLoad) {
+            best = module;
+            bestLoad = moduleLoad;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,38 @@
+#ifndef VOICE_ALLOC_HPP
+#define VOICE_ALLOC_HPP
+
+#include <cstdint>
+
+// Voice allocation for distributed polyphony (DISTRIBUTED_VOICES). Each new note is
+// rendered by the least-loaded module in the stack. Only the module whose key started
+// the note decides, so every module agrees on the result without further exchange.
+//
+// A module's load is the number of voices it is rendering, as reported in its key-state
+// frames. Between reports, every assignment seen on the bus counts as one more voice, so
+// the notes of a chord are spread out even though the reports lag behind.
+class VoiceAllocator {
+public:
+    static const uint8_t MODULES = 16;
+
+    // Load reported by a module, replacing the estimate
+    void report(uint8_t module, uint8_t load);
+    // A voice has been assigned to `module` since its last report
+    void assigned(uint8_t module);
+    uint8_t load(uint8_t module) const;
+    void reset();
+
+    // Module that renders a new note from `origin`, among positions 0 to modules - 1.
+    // The lowest load wins; ties go to the origin, then to the nearest module east of it,
+    // wrapping round to position 0. Outside the stack (modules 0 or origin not in it),
+    // the origin renders its own notes.
+    uint8_t choose(uint8_t origin, uint8_t modules) const;
+
+private:
+    uint8_t loads[MODULES] = {};
+};
+
+// Reports and assignments from CAN_RX_Task, own load from the voice engine,
+// decisions in CAN_TX_Task
+extern VoiceAllocator voiceAllocator;
+
+#endif // VOICE_ALLOC_HPP
@@ -0,0 +1,134 @@
+#include "widgets.hpp"
+#include "notes.hpp"
+#include <cstring>
+
+bool Widget::render(u8g2_t* u8g2) {
+    if (!dirty) {
+        return false;
+    }
+    u8g2_SetDrawColor(u8g2, 0);
+    u8g2_DrawBox(u8g2, bounds.x, bounds.y, bounds.w, bounds.h);
+    u8g2_SetDrawColor(u8g2, 1);
+    u8g2_SetClipWindow(u8g2, bounds.x, bounds.y, bounds.x + bounds.w, bounds.y + bounds.h);
+    draw(u8g2);
+    u8g2_SetMaxClipWindow(u8g2);
+    dirty = false;
+    return true;
+}
+
+Label::Label(Rect bounds, const uint8_t* font, const char* text) : Widget(bounds), font(font) {
+    strncpy(buffer, text, MAX_TEXT - 1);
+    buffer[MAX_TEXT - 1] = '\0';
+}
+
+void Label::setText(const char* text) {
+    if (strncmp(buffer, text, MAX_TEXT - 1) != 0) {
+        strncpy(buffer, text, MAX_TEXT - 1);
+        buffer[MAX_TEXT - 1] = '\0';
+        invalidate();
+    }
+}
+
+void Label::draw(u8g2_t* u8g2) {
+    u8g2_SetFont(u8g2, font);
+    u8g2_DrawStr(u8g2, bounds.x, bounds.y + u8g2_GetAscent(u8g2), buffer);
+}
+
+void Meter::setValue(int32_t value, int32_t range) {
+    if (value < 0) value = 0;
+    if (range <= 0 || value > range) value = range > 0 ? range : 0;
+    uint8_t newFill = range > 0 ? value * (bounds.w - 2) / range : 0;
+    if (newFill != fill) {
+        fill = newFill;
+        invalidate();
+    }
+}
+
+void Meter::draw(u8g2_t* u8g2) {
+    u8g2_DrawFrame(u8g2, bounds.x, bounds.y, bounds.w, bounds.h);
+    if (fill > 0) {
+        u8g2_DrawBox(u8g2, bounds.x + 1, bounds.y + 1, fill, bounds.h - 2);
+    }
+}
+
+void NoteList::setKeys(uint16_t newKeys) {
+    newKeys &= 0xFFF;
+    if (newKeys != keys) {
+        keys = newKeys;
+        invalidate();
+    }
+}
+
+void NoteList::draw(u8g2_t* u8g2) {
+    u8g2_SetFont(u8g2, font);
+    int16_t y = bounds.y + u8g2_GetAscent(u8g2);
+    if (keys == 0) {
+        u8g2_DrawStr(u8g2, bounds.x, y, "No Note");
+        return;
+    }
+    int16_t x = bounds.x;
+    for (uint8_t i = 0; i < 12; i++) {
+        if (keys & (1 << i)) {
+            x += u8g2_DrawStr(u8g2, x, y, noteName(i)) + 3;
+        }
+    }
+}
+
+void Menu::setItems(const char* const* newItems, uint8_t newCount) {
+    items = newItems;
+    count = newCount;
+    selection = 0;
+    first = 0;
+    invalidate();
+}
+
+void Menu::select(int16_t index) {
+    if (index >= count) index = count - 1;
+    if (index < 0) index = 0;
+    uint8_t newFirst = first;
+    if (index < newFirst) {
+        newFirst = index;
+    } else if (index >= newFirst + visibleRows()) {
+        newFirst = index - visibleRows() + 1;
+    }
+    if (index != selection || newFirst != first) {
+        selection = index;
+        first = newFirst;
+        invalidate();
+    }
+}
+
+void Menu::draw(u8g2_t* u8g2) {
+    u8g2_SetFont(u8g2, font);
+    int8_t ascent = u8g2_GetAscent(u8g2);
+    for (uint8_t row = 0; row < visibleRows() && first + row < count; row++) {
+        uint8_t index = first + row;
+        int16_t y = bounds.y + row * rowHeight;
+        if (index == selection) {
+            u8g2_DrawBox(u8g2, bounds.x, y, bounds.w, rowHeight);
+            u8g2_SetDrawColor(u8g2, 0);
+        }
+        u8g2_DrawStr(u8g2, bounds.x + 1, y + 1 + ascent, items[index]);
+        u8g2_SetDrawColor(u8g2, 1);
+    }
+}
+
+void Screen::add(Widget& widget) {
+    if (count < MAX_WIDGETS) {
+        widgets[count++] = &widget;
+    }
+}
+
+void Screen::invalidate() {
+    for (uint8_t i = 0; i < count; i++) {
+        widgets[i]->invalidate();
+    }
+}
+
+uint8_t Screen::render(u8g2_t* u8g2) {
+    uint8_t drawn = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        drawn += widgets[i]->render(u8g2);
+    }
+    return drawn;
+}
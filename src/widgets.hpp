@@ -0,0 +1,128 @@
+#ifndef WIDGETS_HPP
+#define WIDGETS_HPP
+
+#include <cstdint>
+#ifdef ARDUINO
+#include <U8g2lib.h>
+#else
+#include <u8g2.h>  // Plain U8g2 C library, e.g. with a memory-only setup on a PC
+#endif
+
+// Retained-mode widgets for the OLED. Each widget owns a rectangle of the frame buffer and
+// a dirty flag; setters only invalidate it when what it shows actually changes. The frame
+// buffer is not cleared between frames, so only dirty widgets are erased and redrawn, and
+// the tile diff then sends only the tiles they touched. Drawing goes through the U8g2 C API
+// so the same code can render into an in-memory buffer off target.
+
+struct Rect {
+    uint8_t x;
+    uint8_t y;
+    uint8_t w;
+    uint8_t h;
+};
+
+class Widget {
+public:
+    explicit Widget(Rect bounds) : bounds(bounds) {}
+
+    void invalidate() { dirty = true; }
+    bool isDirty() const { return dirty; }
+    const Rect& area() const { return bounds; }
+
+    // Erase the rectangle and redraw, clipped to it. Returns false if nothing changed.
+    bool render(u8g2_t* u8g2);
+
+protected:
+    virtual void draw(u8g2_t* u8g2) = 0;
+
+    Rect bounds;
+
+private:
+    bool dirty = true;
+};
+
+// One line of text, top-aligned in its rectangle
+class Label : public Widget {
+public:
+    static const uint8_t MAX_TEXT = 24;
+
+    Label(Rect bounds, const uint8_t* font, const char* text = "");
+    void setText(const char* text);
+    const char* text() const { return buffer; }
+
+protected:
+    void draw(u8g2_t* u8g2) override;
+
+private:
+    const uint8_t* font;
+    char buffer[MAX_TEXT];
+};
+
+// Horizontal bar showing value out of range
+class Meter : public Widget {
+public:
+    explicit Meter(Rect bounds) : Widget(bounds) {}
+    void setValue(int32_t value, int32_t range);
+
+protected:
+    void draw(u8g2_t* u8g2) override;
+
+private:
+    uint8_t fill = 0;  // Filled width in pixels, the only thing that is drawn
+};
+
+// Names of the pressed keys, from a 12-bit key mask
+class NoteList : public Widget {
+public:
+    NoteList(Rect bounds, const uint8_t* font) : Widget(bounds), font(font) {}
+    void setKeys(uint16_t keys);
+
+protected:
+    void draw(u8g2_t* u8g2) override;
+
+private:
+    const uint8_t* font;
+    uint16_t keys = 0;
+};
+
+// Vertical list of items with the selected one drawn inverted. Shows as many rows as fit
+// and scrolls to keep the selection in view.
+class Menu : public Widget {
+public:
+    Menu(Rect bounds, const uint8_t* font, uint8_t rowHeight)
+        : Widget(bounds), font(font), rowHeight(rowHeight ? rowHeight : 1) {}
+    // `items` is not copied, so it must outlive the menu (e.g. a static table)
+    void setItems(const char* const* items, uint8_t count);
+    void select(int16_t index);  // Clamped to the items
+    void move(int8_t steps) { select(selection + steps); }
+    uint8_t selected() const { return selection; }
+
+protected:
+    void draw(u8g2_t* u8g2) override;
+
+private:
+    uint8_t visibleRows() const { return bounds.h / rowHeight ? bounds.h / rowHeight : 1; }
+
+    const uint8_t* font;
+    const char* const* items = nullptr;
+    uint8_t count = 0;
+    uint8_t rowHeight;
+    uint8_t selection = 0;
+    uint8_t first = 0;  // Item shown on the top row
+};
+
+// A fixed set of widgets that are shown together
+class Screen {
+public:
+    static const uint8_t MAX_WIDGETS = 8;
+
+    void add(Widget& widget);
+    void invalidate();  // Redraw everything, e.g. after switching to this screen
+    uint8_t render(u8g2_t* u8g2);  // Redraw dirty widgets, returns how many
+
+private:
+    Widget* widgets[MAX_WIDGETS];
+    uint8_t count = 0;
+};
+
+#endif // WIDGETS_HPP
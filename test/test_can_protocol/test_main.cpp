@@ -0,0 +1,248 @@
+#include <unity.h>
+#include "can_protocol.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+static KeyStateFrame keyState(uint8_t module, uint8_t octave, uint16_t keys, uint8_t seq) {
+    return {module, octave, keys, 0, seq, 0};
+}
+
+void test_key_state_byte_layout() {
+    KeyStateFrame frame = {3, 5, 0x891, 2, 200, 0x123456};
+    uint8_t data[8];
+    encodeKeyState(frame, data);
+    const uint8_t expected[8] = {0x11, 0x53, 0x91, 0x28, 200, 0x56, 0x34, 0x12};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data, 8);
+}
+
+void test_key_state_round_trips() {
+    uint8_t data[8];
+    for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+        for (uint8_t octave = 0; octave < KEYSTATE_OCTAVES; octave++) {
+            KeyStateFrame frame = {module, octave, (uint16_t)(0x0A5A ^ (module * 0x111)), (uint8_t)(module % 5),
+                                   (uint8_t)(module * 17 + octave), (uint32_t)(0xFFFFFF - module)};
+            KeyStateFrame decoded = {};
+            encodeKeyState(frame, data);
+            TEST_ASSERT_TRUE(decodeKeyState(data, decoded));
+            TEST_ASSERT_EQUAL_UINT8(frame.module, decoded.module);
+            TEST_ASSERT_EQUAL_UINT8(frame.octave, decoded.octave);
+            TEST_ASSERT_EQUAL_HEX16(frame.keys & 0xFFF, decoded.keys);
+            TEST_ASSERT_EQUAL_UINT8(frame.load, decoded.load);
+            TEST_ASSERT_EQUAL_UINT8(frame.seq, decoded.seq);
+            TEST_ASSERT_EQUAL_UINT32(frame.timeMs, decoded.timeMs);
+        }
+    }
+}
+
+void test_key_state_load_and_time_are_truncated() {
+    KeyStateFrame frame = {1, 4, 0x001, 40, 0, 0x1ABCDEF};
+    KeyStateFrame decoded;
+    uint8_t data[8];
+    encodeKeyState(frame, data);
+    TEST_ASSERT_TRUE(decodeKeyState(data, decoded));
+    TEST_ASSERT_EQUAL_UINT8(15, decoded.load);              // Saturates in 4 bits
+    TEST_ASSERT_EQUAL_UINT32(0xABCDEF, decoded.timeMs);     // 24 bits on the bus
+    TEST_ASSERT_EQUAL_HEX16(0x001, decoded.keys);
+}
+
+void test_other_versions_and_types_are_rejected() {
+    KeyStateFrame frame = keyState(0, 4, 0x001, 0);
+    KeyStateFrame decoded;
+    uint8_t data[8];
+    encodeKeyState(frame, data);
+    data[0] = ((CAN_PROTOCOL_VERSION + 1) << 4) | CAN_MSG_KEYSTATE;
+    TEST_ASSERT_FALSE(decodeKeyState(data, decoded));
+    data[0] = (CAN_PROTOCOL_VERSION << 4) | CAN_MSG_VOICE;
+    TEST_ASSERT_FALSE(decodeKeyState(data, decoded));
+    const uint8_t legacy[8] = {'P', 4, 0};  // The old one-frame-per-key message
+    TEST_ASSERT_FALSE(decodeKeyState(legacy, decoded));
+}
+
+void test_can_ids_encode_class_type_and_module() {
+    TEST_ASSERT_EQUAL_HEX32(0x040, canId(CAN_MSG_CLOCK, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x11F, canId(CAN_MSG_KEYSTATE, 15));
+    TEST_ASSERT_EQUAL_HEX32(0x135, canId(CAN_MSG_VOICE, 5));
+    TEST_ASSERT_EQUAL_HEX32(0x22A, canId(CAN_MSG_HANDSHAKE, 10));
+    TEST_ASSERT_EQUAL_HEX32(canId(CAN_MSG_KEYSTATE, 3), canId(CAN_MSG_KEYSTATE, 0x13));  // Module is 4 bits
+    for (uint8_t i = 0; i < CAN_ROUTE_COUNT; i++) {
+        for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+            uint32_t id = canId(CAN_ROUTES[i].type, module);
+            TEST_ASSERT_LESS_OR_EQUAL(0x7FF, id);  // Standard 11-bit ID
+            TEST_ASSERT_EQUAL_UINT8(CAN_ROUTES[i].type, canIdMessage(id));
+            TEST_ASSERT_EQUAL_UINT8(module, canIdModule(id));
+            TEST_ASSERT_EQUAL_UINT8(CAN_ROUTES[i].cls, id >> CAN_ID_CLASS_SHIFT);
+        }
+    }
+}
+
+void test_can_ids_are_unique_and_ordered_by_priority() {
+    for (uint8_t i = 0; i < CAN_ROUTE_COUNT; i++) {
+        for (uint8_t j = 0; j < CAN_ROUTE_COUNT; j++) {
+            for (uint8_t a = 0; a < CAN_MAX_MODULES; a++) {
+                for (uint8_t b = 0; b < CAN_MAX_MODULES; b++) {
+                    uint32_t first = canId(CAN_ROUTES[i].type, a);
+                    uint32_t second = canId(CAN_ROUTES[j].type, b);
+                    if (i != j || a != b) {
+                        TEST_ASSERT_NOT_EQUAL(first, second);
+                    }
+                    // A higher-priority class wins arbitration whatever the modules
+                    if (CAN_ROUTES[i].cls < CAN_ROUTES[j].cls) {
+                        TEST_ASSERT_LESS_THAN(second, first);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void test_filters_pass_exactly_their_route() {
+    // initCAN() sets one filter per route from canId(type, 0) and CAN_ID_SOURCE_MASK
+    for (uint8_t bank = 0; bank < CAN_ROUTE_COUNT; bank++) {
+        uint32_t filter = canId(CAN_ROUTES[bank].type, 0);
+        TEST_ASSERT_EQUAL_HEX32(0, filter & ~CAN_ID_SOURCE_MASK);
+        for (uint8_t i = 0; i < CAN_ROUTE_COUNT; i++) {
+            for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+                bool match = (canId(CAN_ROUTES[i].type, module) & CAN_ID_SOURCE_MASK) == filter;
+                TEST_ASSERT_EQUAL(i == bank, match);
+            }
+        }
+    }
+    // Notes and voice assignments share a FIFO so they stay in order; clock and control
+    // traffic use the other one
+    for (uint8_t i = 0; i < CAN_ROUTE_COUNT; i++) {
+        TEST_ASSERT_LESS_OR_EQUAL(1, CAN_ROUTES[i].fifo);
+        TEST_ASSERT_EQUAL_UINT8(CAN_ROUTES[i].cls == CAN_CLASS_NOTE ? 0 : 1, CAN_ROUTES[i].fifo);
+    }
+    // The legacy ID is not a route any more
+    for (uint8_t bank = 0; bank < CAN_ROUTE_COUNT; bank++) {
+        TEST_ASSERT_NOT_EQUAL(canId(CAN_ROUTES[bank].type, 0), 0x123 & CAN_ID_SOURCE_MASK);
+    }
+}
+
+void test_tracker_turns_a_chord_into_one_frame_of_events() {
+    static KeyStateTracker tracker;
+    tracker = KeyStateTracker();
+    KeyEvent events[KeyStateTracker::MAX_EVENTS];
+    uint8_t count = tracker.apply(keyState(2, 4, 0x091, 0), 1000, events);  // C, E, G
+    TEST_ASSERT_EQUAL_UINT8(3, count);
+    const uint8_t keys[] = {0, 4, 7};
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT8(keys[i], events[i].key);
+        TEST_ASSERT_EQUAL_UINT8(4, events[i].octave);
+        TEST_ASSERT_EQUAL_UINT8(1, events[i].pressed);
+        TEST_ASSERT_EQUAL_UINT8(2, events[i].module);
+        TEST_ASSERT_EQUAL_UINT32(1000, events[i].time);
+    }
+
+    // E released, A pressed: releases come first
+    count = tracker.apply(keyState(2, 4, 0x281, 1), 2000, events);
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+    TEST_ASSERT_EQUAL_UINT8(4, events[0].key);
+    TEST_ASSERT_EQUAL_UINT8(0, events[0].pressed);
+    TEST_ASSERT_EQUAL_UINT8(9, events[1].key);
+    TEST_ASSERT_EQUAL_UINT8(1, events[1].pressed);
+
+    // A refresh with the same state produces nothing
+    TEST_ASSERT_EQUAL_UINT8(0, tracker.apply(keyState(2, 4, 0x281, 2), 3000, events));
+    TEST_ASSERT_EQUAL_HEX16(0x281, tracker.keys(2, 4));
+    TEST_ASSERT_EQUAL_UINT32(0, tracker.lostFrames());
+}
+
+void test_tracker_heals_a_lost_frame() {
+    static KeyStateTracker tracker;
+    tracker = KeyStateTracker();
+    KeyEvent events[KeyStateTracker::MAX_EVENTS];
+    tracker.apply(keyState(0, 3, 0x001, 254), 0, events);
+    // Frames 255 (press D) and 0 (release C) are lost; frame 1 has the current state
+    uint8_t count = tracker.apply(keyState(0, 3, 0x004, 1), 300, events);
+    TEST_ASSERT_EQUAL_UINT32(2, tracker.lostFrames());  // Across the sequence wrap
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+    TEST_ASSERT_EQUAL_UINT8(0, events[0].key);
+    TEST_ASSERT_EQUAL_UINT8(0, events[0].pressed);
+    TEST_ASSERT_EQUAL_UINT8(2, events[1].key);
+    TEST_ASSERT_EQUAL_UINT8(1, events[1].pressed);
+}
+
+void test_tracker_keeps_octaves_and_modules_apart() {
+    static KeyStateTracker tracker;
+    tracker = KeyStateTracker();
+    KeyEvent events[KeyStateTracker::MAX_EVENTS];
+    tracker.apply(keyState(0, 4, 0x001, 0), 0, events);
+    tracker.apply(keyState(0, 5, 0x001, 1), 0, events);  // Same module, MIDI in another octave
+    tracker.apply(keyState(1, 4, 0x001, 0), 0, events);  // Same note from another module
+    // Emptying octave 5 releases only that octave
+    TEST_ASSERT_EQUAL_UINT8(1, tracker.apply(keyState(0, 5, 0x000, 2), 10, events));
+    TEST_ASSERT_EQUAL_UINT8(5, events[0].octave);
+    TEST_ASSERT_EQUAL_HEX16(0x001, tracker.keys(0, 4));
+    TEST_ASSERT_EQUAL_HEX16(0x001, tracker.keys(1, 4));
+    // Octaves outside the NoteMap only count for the sequence and the heartbeat
+    TEST_ASSERT_EQUAL_UINT8(0, tracker.apply(keyState(0, KEYSTATE_OCTAVES, 0xFFF, 3), 20, events));
+    TEST_ASSERT_EQUAL_HEX16(0, tracker.keys(0, KEYSTATE_OCTAVES));
+}
+
+void test_tracker_expires_silent_modules_and_stale_octaves() {
+    static KeyStateTracker tracker;
+    tracker = KeyStateTracker();
+    KeyEvent events[KeyStateTracker::MAX_EVENTS];
+    TEST_ASSERT_EQUAL_INT8(-1, tracker.expired(1000000, KEYSTATE_TIMEOUT_MS));
+    tracker.apply(keyState(3, 4, 0x003, 0), 0, events);
+    tracker.apply(keyState(3, 6, 0x800, 1), 0, events);
+    tracker.apply(keyState(5, 4, 0x010, 0), 200, events);
+    TEST_ASSERT_EQUAL_INT8(-1, tracker.expired(KEYSTATE_TIMEOUT_MS - 1, KEYSTATE_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_INT8(3, tracker.expired(KEYSTATE_TIMEOUT_MS, KEYSTATE_TIMEOUT_MS));
+
+    // Module 3 keeps refreshing octave 4 only: octave 6 goes stale, one octave per call
+    tracker.apply(keyState(3, 4, 0x003, 2), 300, events);
+    uint8_t count = tracker.expireOctave(KEYSTATE_TIMEOUT_MS, KEYSTATE_TIMEOUT_MS, events);
+    TEST_ASSERT_EQUAL_UINT8(1, count);
+    TEST_ASSERT_EQUAL_UINT8(6, events[0].octave);
+    TEST_ASSERT_EQUAL_UINT8(11, events[0].key);
+    TEST_ASSERT_EQUAL_UINT8(0, events[0].pressed);
+    TEST_ASSERT_EQUAL_UINT8(3, events[0].module);
+    TEST_ASSERT_EQUAL_UINT8(0, tracker.expireOctave(KEYSTATE_TIMEOUT_MS, KEYSTATE_TIMEOUT_MS, events));
+
+    tracker.forget(3);
+    TEST_ASSERT_EQUAL_HEX16(0, tracker.keys(3, 4));
+    TEST_ASSERT_EQUAL_INT8(5, tracker.expired(1000, KEYSTATE_TIMEOUT_MS));
+}
+
+// What CAN_RX_Task does on a new handshake epoch: every module the tracker has seen is
+// departed, and nothing is left to expire later under a position that is now ours
+void test_tracker_is_cleared_on_re_enumeration() {
+    static KeyStateTracker tracker;
+    tracker = KeyStateTracker();
+    KeyEvent events[KeyStateTracker::MAX_EVENTS];
+    tracker.apply(keyState(0, 4, 0x001, 0), 0, events);
+    tracker.apply(keyState(2, 5, 0x002, 0), 0, events);
+    uint16_t departed = 0;
+    for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+        if (tracker.seen(module)) {
+            departed |= 1 << module;
+        }
+        tracker.forget(module);
+    }
+    TEST_ASSERT_EQUAL_HEX16(0x0005, departed);
+    for (uint8_t module = 0; module < CAN_MAX_MODULES; module++) {
+        TEST_ASSERT_FALSE(tracker.seen(module));
+    }
+    TEST_ASSERT_EQUAL_INT8(-1, tracker.expired(10 * KEYSTATE_TIMEOUT_MS, KEYSTATE_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_UINT8(0, tracker.expireOctave(10 * KEYSTATE_TIMEOUT_MS, KEYSTATE_TIMEOUT_MS, events));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_key_state_byte_layout);
+    RUN_TEST(test_key_state_round_trips);
+    RUN_TEST(test_key_state_load_and_time_are_truncated);
+    RUN_TEST(test_other_versions_and_types_are_rejected);
+    RUN_TEST(test_can_ids_encode_class_type_and_module);
+    RUN_TEST(test_can_ids_are_unique_and_ordered_by_priority);
+    RUN_TEST(test_filters_pass_exactly_their_route);
+    RUN_TEST(test_tracker_turns_a_chord_into_one_frame_of_events);
+    RUN_TEST(test_tracker_heals_a_lost_frame);
+    RUN_TEST(test_tracker_keeps_octaves_and_modules_apart);
+    RUN_TEST(test_tracker_expires_silent_modules_and_stale_octaves);
+    RUN_TEST(test_tracker_is_cleared_on_re_enumeration);
+    return UNITY_END();
+}
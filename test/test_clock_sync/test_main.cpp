@@ -0,0 +1,205 @@
+#include <unity.h>
+#include <cmath>
+#include "can_protocol.hpp"
+#include "clock_sync.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+// Deterministic uniform noise in [0, 1)
+static uint32_t noiseState;
+static double noise() {
+    noiseState = noiseState * 1664525 + 1013904223;
+    return (noiseState >> 8) / 16777216.0;
+}
+
+// A master and one follower on a simulated bus. Both timers start near the 32-bit wrap and
+// the follower's crystal is `ppm` fast. The master's transmit interrupt and the follower's
+// receive interrupt each add up to `jitterUs` of latency, and a share `loss` of the frames
+// is lost. The follower pairs frames the way CAN_RX_Task does.
+struct Bus {
+    ClockSync follower;
+    double ppm;
+    double jitterUs;
+    double loss;
+    uint8_t seq = 0;
+    uint32_t lastTxUs = 0;
+    bool lastTxValid = false;
+    ClockSyncFrame last = {};
+    uint32_t lastRxUs = 0;
+    bool haveLast = false;
+
+    Bus(double ppm, double jitterUs, double loss) : ppm(ppm), jitterUs(jitterUs), loss(loss) {
+        noiseState = 7;
+    }
+
+    static uint32_t wrap(double us) { return (uint32_t)(uint64_t)llround(fmod(us, 4294967296.0)); }
+    uint32_t masterUs(double t) const { return wrap(4294000000.0 + t * 1e6); }
+    uint32_t localUs(double t) const { return wrap(3900000000.0 + t * 1e6 * (1 + ppm * 1e-6)); }
+
+    // Sync sent at time t, in seconds
+    void sync(double t) {
+        ClockSyncFrame frame = {0, seq++, lastTxValid, lastTxUs};
+        uint8_t data[8];
+        encodeClockSync(frame, data);
+        lastTxUs = masterUs(t + noise() * jitterUs * 1e-6);
+        lastTxValid = true;
+        double rxJitter = noise() * jitterUs * 1e-6;
+        if (noise() < loss) {
+            return;
+        }
+        ClockSyncFrame rx;
+        TEST_ASSERT_TRUE(decodeClockSync(data, rx));
+        if (haveLast && rx.previousValid && rx.seq == (uint8_t)(last.seq + 1) && rx.position == last.position) {
+            follower.receive(rx.previousUs, lastRxUs);
+        }
+        last = rx;
+        lastRxUs = localUs(t + rxJitter);
+        haveLast = true;
+    }
+
+    // Follower's error at time t, in us
+    int32_t error(double t) const { return (int32_t)(follower.masterTime(localUs(t)) - masterUs(t)); }
+};
+
+struct Stats {
+    double mean;
+    double worst;
+};
+
+// Run for `seconds`, measuring the error between syncs after `settle` seconds
+static Stats run(Bus& bus, double seconds, double settle) {
+    double sum = 0;
+    double worst = 0;
+    int n = 0;
+    for (int k = 0; k * CLOCK_SYNC_MS * 1e-3 < seconds; k++) {
+        double t = k * CLOCK_SYNC_MS * 1e-3;
+        bus.sync(t);
+        for (double offset = 0.01; offset < CLOCK_SYNC_MS * 1e-3; offset += 0.02) {
+            if (t >= settle) {
+                double error = fabs(bus.error(t + offset));
+                sum += error;
+                worst = fmax(worst, error);
+                n++;
+            }
+        }
+    }
+    return {sum / n, worst};
+}
+
+void test_sync_frame_round_trips() {
+    uint8_t data[8];
+    encodeClockSync({2, 200, true, 0x89ABCDEF}, data);
+    const uint8_t expected[8] = {0x14, 2, 200, 1, 0xEF, 0xCD, 0xAB, 0x89};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data, 8);
+    ClockSyncFrame sync;
+    TEST_ASSERT_TRUE(decodeClockSync(data, sync));
+    TEST_ASSERT_EQUAL_UINT8(2, sync.position);
+    TEST_ASSERT_EQUAL_UINT8(200, sync.seq);
+    TEST_ASSERT_TRUE(sync.previousValid);
+    TEST_ASSERT_EQUAL_HEX32(0x89ABCDEF, sync.previousUs);
+
+    encodeClockSync({0, 0, false, 0}, data);
+    TEST_ASSERT_TRUE(decodeClockSync(data, sync));
+    TEST_ASSERT_FALSE(sync.previousValid);
+    data[0] = (CAN_PROTOCOL_VERSION << 4) | CAN_MSG_VOICE;
+    TEST_ASSERT_FALSE(decodeClockSync(data, sync));
+}
+
+void test_unlocked_until_the_first_sync() {
+    ClockSync clock;
+    TEST_ASSERT_FALSE(clock.locked(1000));
+    TEST_ASSERT_EQUAL_UINT32(1000, clock.masterTime(1000));
+    clock.receive(50000, 1000);
+    TEST_ASSERT_TRUE(clock.locked(1000));
+    TEST_ASSERT_EQUAL_UINT32(50000, clock.masterTime(1000));
+    TEST_ASSERT_EQUAL_UINT32(50500, clock.masterTime(1500));
+    TEST_ASSERT_EQUAL_UINT32(0, clock.steps());
+}
+
+void test_unlocks_after_the_timeout() {
+    ClockSync clock;
+    clock.receive(50000, 1000);
+    TEST_ASSERT_TRUE(clock.locked(1000 + CLOCK_SYNC_TIMEOUT_MS * 1000 - 1));
+    TEST_ASSERT_FALSE(clock.locked(1000 + CLOCK_SYNC_TIMEOUT_MS * 1000));
+    // The next sync after the gap takes the master time as it is
+    clock.receive(52000000, 1000 + 2 * CLOCK_SYNC_TIMEOUT_MS * 1000);
+    TEST_ASSERT_TRUE(clock.locked(1000 + 2 * CLOCK_SYNC_TIMEOUT_MS * 1000));
+    TEST_ASSERT_EQUAL_UINT32(52000000, clock.masterTime(1000 + 2 * CLOCK_SYNC_TIMEOUT_MS * 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, clock.steps());
+    clock.reset();
+    TEST_ASSERT_FALSE(clock.locked(0));
+}
+
+void test_master_jump_steps() {
+    ClockSync clock;
+    uint32_t local = 0;
+    uint32_t master = 7000000;
+    for (int i = 0; i < 20; i++) {
+        clock.receive(master, local);
+        local += CLOCK_SYNC_MS * 1000;
+        master += CLOCK_SYNC_MS * 1000;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, clock.steps());
+    master += CLOCK_SYNC_STEP_US + 1;
+    clock.receive(master, local);
+    TEST_ASSERT_EQUAL_UINT32(1, clock.steps());
+    TEST_ASSERT_EQUAL_UINT32(master, clock.masterTime(local));
+}
+
+void test_duplicate_syncs_are_skipped() {
+    ClockSync clock;
+    clock.receive(10000, 0);
+    clock.receive(10000 + CLOCK_SYNC_MS * 1000, CLOCK_SYNC_MS * 1000);
+    int32_t rate = clock.ratePpb();
+    clock.receive(10000 + CLOCK_SYNC_MS * 1000 + 100, CLOCK_SYNC_MS * 1000 + 10);
+    TEST_ASSERT_EQUAL_INT32(rate, clock.ratePpb());
+    TEST_ASSERT_EQUAL_UINT32(10000 + CLOCK_SYNC_MS * 1000 + 1000, clock.masterTime(CLOCK_SYNC_MS * 1000 + 1000));
+}
+
+void test_tracks_drift_in_both_directions() {
+    const double drifts[2] = {300, -300};
+    for (int i = 0; i < 2; i++) {
+        Bus bus(drifts[i], 30, 0.02);
+        Stats stats = run(bus, 600, 60);
+        TEST_ASSERT_LESS_OR_EQUAL(8, stats.mean);
+        TEST_ASSERT_LESS_OR_EQUAL(40, stats.worst);
+        // Master ticks per local tick - 1. Each sync moves the rate by the jitter over the
+        // interval times the frequency gain, about 5 ppm here, so it wanders around the drift.
+        double expectedPpb = (1 / (1 + drifts[i] * 1e-6) - 1) * 1e9;
+        TEST_ASSERT_INT32_WITHIN(20000, (int32_t)expectedPpb, bus.follower.ratePpb());
+        TEST_ASSERT_EQUAL_UINT32(0, bus.follower.steps());
+        TEST_ASSERT_TRUE(bus.follower.locked(bus.localUs(600)));
+    }
+}
+
+void test_heavy_jitter_and_loss_are_averaged_out() {
+    Bus bus(80, 100, 0.1);
+    Stats stats = run(bus, 600, 60);
+    TEST_ASSERT_LESS_OR_EQUAL(25, stats.mean);
+    TEST_ASSERT_LESS_OR_EQUAL(120, stats.worst);
+    TEST_ASSERT_EQUAL_UINT32(0, bus.follower.steps());
+}
+
+void test_reported_error_reflects_the_jitter() {
+    Bus quiet(100, 5, 0);
+    run(quiet, 120, 60);
+    Bus noisy(100, 100, 0);
+    run(noisy, 120, 60);
+    TEST_ASSERT_LESS_OR_EQUAL(10, quiet.follower.errorUs());
+    TEST_ASSERT_GREATER_THAN(quiet.follower.errorUs(), noisy.follower.errorUs());
+    TEST_ASSERT_LESS_OR_EQUAL(150, noisy.follower.errorUs());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sync_frame_round_trips);
+    RUN_TEST(test_unlocked_until_the_first_sync);
+    RUN_TEST(test_unlocks_after_the_timeout);
+    RUN_TEST(test_master_jump_steps);
+    RUN_TEST(test_duplicate_syncs_are_skipped);
+    RUN_TEST(test_tracks_drift_in_both_directions);
+    RUN_TEST(test_heavy_jitter_and_loss_are_averaged_out);
+    RUN_TEST(test_reported_error_reflects_the_jitter);
+    return UNITY_END();
+}
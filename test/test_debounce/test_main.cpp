@@ -0,0 +1,90 @@
+#include <unity.h>
+#include "debounce.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+// Feed a sample sequence for one input (bit 0) and count the debounced transitions
+static uint8_t feed(Debouncer& debouncer, const char* samples) {
+    uint8_t toggles = 0;
+    for (const char* s = samples; *s; s++) {
+        toggles += debouncer.update(*s == '1') != 0;
+    }
+    return toggles;
+}
+
+void test_bounce_is_a_single_transition() {
+    Debouncer debouncer(3, 0x1);
+    TEST_ASSERT_EQUAL(1, feed(debouncer, "1010111"));
+    TEST_ASSERT_EQUAL_HEX32(0x1, debouncer.state());
+    TEST_ASSERT_EQUAL(1, feed(debouncer, "0101000"));
+    TEST_ASSERT_EQUAL_HEX32(0x0, debouncer.state());
+}
+
+void test_changes_after_exactly_stable_samples() {
+    for (uint8_t samples = 1; samples <= Debouncer::MAX_SAMPLES; samples++) {
+        Debouncer debouncer(samples, 0x1);
+        for (uint8_t i = 1; i < samples; i++) {
+            TEST_ASSERT_EQUAL_HEX32(0, debouncer.update(1));
+        }
+        TEST_ASSERT_EQUAL_HEX32(0x1, debouncer.update(1));
+    }
+}
+
+void test_glitch_shorter_than_threshold_is_ignored() {
+    Debouncer debouncer(4, 0x1, 0x1);
+    TEST_ASSERT_EQUAL(0, feed(debouncer, "000100010001"));
+    TEST_ASSERT_EQUAL_HEX32(0x1, debouncer.state());
+}
+
+void test_inputs_are_filtered_independently() {
+    // Key 0 is stable from the start, key 1 bounces twice, key 2 never settles
+    Debouncer debouncer(3, 0x7);
+    const uint32_t raw[] = {0x1, 0x3, 0x5, 0x3, 0x7, 0x3, 0x7, 0x3};
+    uint32_t toggledAt[8];
+    for (uint8_t i = 0; i < 8; i++) {
+        toggledAt[i] = debouncer.update(raw[i]);
+    }
+    TEST_ASSERT_EQUAL_HEX32(0x1, toggledAt[2]);
+    TEST_ASSERT_EQUAL_HEX32(0x2, toggledAt[5]);
+    TEST_ASSERT_EQUAL_HEX32(0x3, debouncer.state());
+}
+
+void test_bits_outside_the_mask_pass_through() {
+    Debouncer debouncer(5, 0x0FF);
+    TEST_ASSERT_EQUAL_HEX32(0, debouncer.update(0xF0F));
+    TEST_ASSERT_EQUAL_HEX32(0, debouncer.state());
+    TEST_ASSERT_EQUAL_HEX32(0xF00, debouncer.merge(0xF0F));
+}
+
+void test_all_32_inputs_in_parallel() {
+    Debouncer debouncer(Debouncer::MAX_SAMPLES);
+    uint32_t toggled = 0;
+    for (uint8_t i = 0; i < Debouncer::MAX_SAMPLES; i++) {
+        toggled |= debouncer.update(0xFFFFFFFF);
+    }
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, toggled);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, debouncer.state());
+}
+
+void test_set_stable_samples_clamps_and_restarts() {
+    Debouncer debouncer(2, 0x1);
+    debouncer.update(1);
+    debouncer.setStableSamples(0);  // Clamped to 1, and the pending count is dropped
+    TEST_ASSERT_EQUAL_HEX32(0x1, debouncer.update(1));
+    debouncer.setStableSamples(200);  // Clamped to MAX_SAMPLES
+    TEST_ASSERT_EQUAL(0, feed(debouncer, "00000000000000"));
+    TEST_ASSERT_EQUAL(1, feed(debouncer, "0"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bounce_is_a_single_transition);
+    RUN_TEST(test_changes_after_exactly_stable_samples);
+    RUN_TEST(test_glitch_shorter_than_threshold_is_ignored);
+    RUN_TEST(test_inputs_are_filtered_independently);
+    RUN_TEST(test_bits_outside_the_mask_pass_through);
+    RUN_TEST(test_all_32_inputs_in_parallel);
+    RUN_TEST(test_set_stable_samples_clamps_and_restarts);
+    return UNITY_END();
+}
@@ -0,0 +1,103 @@
+#include <unity.h>
+#include "event_ring.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+void test_items_come_out_in_order() {
+    EventRing<uint32_t, 8, 1> ring;
+    uint32_t item;
+    TEST_ASSERT_TRUE(ring.empty(0));
+    TEST_ASSERT_FALSE(ring.pop(0, item));
+    for (uint32_t i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+    }
+    for (uint32_t i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(ring.pop(0, item));
+        TEST_ASSERT_EQUAL_UINT32(i, item);
+    }
+    TEST_ASSERT_TRUE(ring.empty(0));
+}
+
+void test_full_ring_drops_and_counts() {
+    EventRing<uint32_t, 4, 1> ring;
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+    }
+    TEST_ASSERT_FALSE(ring.push(4));
+    TEST_ASSERT_FALSE(ring.push(5));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.dropped());
+
+    // The queued items are untouched by the failed pushes
+    uint32_t item;
+    TEST_ASSERT_TRUE(ring.pop(0, item));
+    TEST_ASSERT_EQUAL_UINT32(0, item);
+    TEST_ASSERT_TRUE(ring.push(6));
+    const uint32_t expected[] = {1, 2, 3, 6};
+    for (uint32_t value : expected) {
+        TEST_ASSERT_TRUE(ring.pop(0, item));
+        TEST_ASSERT_EQUAL_UINT32(value, item);
+    }
+}
+
+void test_every_reader_sees_every_item() {
+    EventRing<uint32_t, 4, 2> ring;
+    uint32_t item;
+    TEST_ASSERT_TRUE(ring.push(10));
+    TEST_ASSERT_TRUE(ring.push(11));
+    TEST_ASSERT_TRUE(ring.pop(0, item));
+    TEST_ASSERT_TRUE(ring.pop(0, item));
+    TEST_ASSERT_TRUE(ring.empty(0));
+    TEST_ASSERT_FALSE(ring.empty(1));
+    TEST_ASSERT_TRUE(ring.pop(1, item));
+    TEST_ASSERT_EQUAL_UINT32(10, item);
+    TEST_ASSERT_TRUE(ring.pop(1, item));
+    TEST_ASSERT_EQUAL_UINT32(11, item);
+}
+
+void test_slowest_reader_holds_back_the_producer() {
+    EventRing<uint32_t, 4, 2> ring;
+    uint32_t item;
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+        TEST_ASSERT_TRUE(ring.pop(0, item));
+    }
+    // Reader 0 has drained everything, but reader 1 has not read anything yet
+    TEST_ASSERT_FALSE(ring.push(4));
+    TEST_ASSERT_TRUE(ring.pop(1, item));
+    TEST_ASSERT_EQUAL_UINT32(0, item);
+    TEST_ASSERT_TRUE(ring.push(4));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.dropped());
+}
+
+void test_wraps_around_many_times() {
+    struct Event { uint32_t time; uint8_t key; };
+    EventRing<Event, 16, 1> ring;
+    Event event;
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+        TEST_ASSERT_TRUE(ring.push({i, (uint8_t)(i % 12)}));
+        if (i % 3 != 0) {  // Consume a little slower than produced, then catch up
+            while (ring.pop(0, event)) {
+                TEST_ASSERT_EQUAL_UINT32(next, event.time);
+                TEST_ASSERT_EQUAL_UINT8(next % 12, event.key);
+                next++;
+            }
+        }
+    }
+    while (ring.pop(0, event)) {
+        next++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(1000, next);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.dropped());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_items_come_out_in_order);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_every_reader_sees_every_item);
+    RUN_TEST(test_slowest_reader_holds_back_the_producer);
+    RUN_TEST(test_wraps_around_many_times);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+#include <unity.h>
+#include "fft.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static int16_t re[1 << FFT_MAX_LOG2];
+static int16_t im[1 << FFT_MAX_LOG2];
+static double refRe[1 << FFT_MAX_LOG2];
+static double refIm[1 << FFT_MAX_LOG2];
+
+void setUp() { fftInit(); }
+void tearDown() {}
+
+// Direct DFT of the current input in double precision, divided by n like fft()
+static void referenceDft(uint8_t log2n) {
+    uint16_t n = 1 << log2n;
+    for (uint16_t k = 0; k < n; k++) {
+        double sumRe = 0;
+        double sumIm = 0;
+        for (uint16_t t = 0; t < n; t++) {
+            double angle = -2.0 * M_PI * k * t / n;
+            sumRe += re[t] * cos(angle) - im[t] * sin(angle);
+            sumIm += re[t] * sin(angle) + im[t] * cos(angle);
+        }
+        refRe[k] = sumRe / n;
+        refIm[k] = sumIm / n;
+    }
+}
+
+// Largest difference between fft() and the reference, in Q15 steps
+static double worstError(uint8_t log2n) {
+    referenceDft(log2n);
+    fft(re, im, log2n);
+    double worst = 0;
+    for (uint16_t k = 0; k < (1u << log2n); k++) {
+        worst = fmax(worst, fabs(re[k] - refRe[k]));
+        worst = fmax(worst, fabs(im[k] - refIm[k]));
+    }
+    return worst;
+}
+
+// Rounding loses at most about one step per stage
+static void assertMatchesReference(uint8_t log2n, const char* signal) {
+    double error = worstError(log2n);
+    char message[64];
+    snprintf(message, sizeof(message), "%s, %u points: error %.2f", signal, 1u << log2n, error);
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(log2n + 1, (int)ceil(error), message);
+}
+
+void test_impulse_is_flat() {
+    for (uint8_t log2n = 1; log2n <= FFT_MAX_LOG2; log2n++) {
+        for (uint16_t i = 0; i < (1u << log2n); i++) {
+            re[i] = i == 0 ? 32767 : 0;
+            im[i] = 0;
+        }
+        assertMatchesReference(log2n, "impulse");
+    }
+}
+
+void test_sines_match_the_reference_dft() {
+    for (uint8_t log2n = 4; log2n <= FFT_MAX_LOG2; log2n++) {
+        uint16_t n = 1 << log2n;
+        for (uint16_t bin = 1; bin < n / 2; bin += n / 16) {
+            for (uint16_t i = 0; i < n; i++) {
+                re[i] = (int16_t)lround(30000 * sin(2 * M_PI * bin * i / n + 0.3));
+                im[i] = 0;
+            }
+            assertMatchesReference(log2n, "sine");
+        }
+    }
+}
+
+void test_random_complex_input_matches_the_reference_dft() {
+    srand(1);
+    for (uint8_t log2n = 1; log2n <= FFT_MAX_LOG2; log2n++) {
+        for (uint8_t round = 0; round < 4; round++) {
+            for (uint16_t i = 0; i < (1u << log2n); i++) {
+                re[i] = (int16_t)(rand() % 65535 - 32767);
+                im[i] = (int16_t)(rand() % 65535 - 32767);
+            }
+            assertMatchesReference(log2n, "random");
+        }
+    }
+}
+
+void test_sine_peaks_in_its_bin() {
+    const uint8_t log2n = 7;  // The spectrum view: 128 samples, 64 bins
+    for (uint16_t i = 0; i < 128; i++) {
+        re[i] = (int16_t)lround(16000 * sin(2 * M_PI * 10 * i / 128));
+        im[i] = 0;
+    }
+    fftWindow(re, log2n);
+    fft(re, im, log2n);
+    // A sine of amplitude A gives A/2 in its bin, the Hann window halves that and puts
+    // half as much again in each neighbouring bin
+    TEST_ASSERT_INT_WITHIN(40, 4000, fftMagnitude(re[10], im[10]));
+    for (uint16_t k = 1; k < 64; k++) {
+        if (k < 9 || k > 11) {
+            TEST_ASSERT_LESS_OR_EQUAL(8, fftMagnitude(re[k], im[k]));  // Hann sidelobes and rounding
+        }
+    }
+}
+
+void test_magnitude_estimate_is_within_12_percent() {
+    for (int angle = 0; angle < 360; angle += 3) {
+        double a = angle * M_PI / 180;
+        int16_t x = (int16_t)lround(20000 * cos(a));
+        int16_t y = (int16_t)lround(20000 * sin(a));
+        TEST_ASSERT_INT_WITHIN(20000 * 12 / 100, 20000, fftMagnitude(x, y));
+    }
+}
+
+// Host timing of the spectrum view's transform. The target figure comes from TEST_FFT
+// (DWT cycle counter); this catches a change that makes the transform much slower.
+void test_benchmark_128_point_fft() {
+    const uint8_t log2n = 7;
+    const int rounds = 20000;
+    double worstUs = 0;
+    auto total = std::chrono::steady_clock::duration::zero();
+    for (int r = 0; r < rounds; r++) {
+        for (uint16_t i = 0; i < 128; i++) {
+            re[i] = (int16_t)((i * 977 + r) & 0x7FFF);
+            im[i] = 0;
+        }
+        auto start = std::chrono::steady_clock::now();
+        fftWindow(re, log2n);
+        fft(re, im, log2n);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        total += elapsed;
+        worstUs = fmax(worstUs, std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    double meanUs = std::chrono::duration<double, std::micro>(total).count() / rounds;
+    char message[96];
+    snprintf(message, sizeof(message), "128-point window + FFT on the host: mean %.2f us, worst %.2f us",
+             meanUs, worstUs);
+    TEST_MESSAGE(message);
+    // The display frame is 30 ms; even the host mean must stay far below 1% of it
+    TEST_ASSERT_LESS_THAN(300, (int)meanUs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_impulse_is_flat);
+    RUN_TEST(test_sines_match_the_reference_dft);
+    RUN_TEST(test_random_complex_input_matches_the_reference_dft);
+    RUN_TEST(test_sine_peaks_in_its_bin);
+    RUN_TEST(test_magnitude_estimate_is_within_12_percent);
+    RUN_TEST(test_benchmark_128_point_fft);
+    return UNITY_END();
+}
@@ -0,0 +1,334 @@
+#include <unity.h>
+#include "handshake.hpp"
+#include "can_protocol.hpp"
+#include <cstring>
+
+// A row of virtual modules. Each step is one 2 ms key scan of every module, from west to
+// east: a module reads its neighbours' handshake outputs as its inputs, and whatever it
+// broadcasts goes over the wire format to every other module at the next step.
+class Row {
+public:
+    static const uint8_t MAX = Handshake::MAX_MODULES;
+    static const uint32_t STEP_MS = 2;
+
+    uint32_t now = 0;
+    uint8_t size = 0;
+    uint8_t dropLastAnnouncements = 0;  // Lose this many announcements marked last
+    int8_t muted = -1;                  // Index of a module whose messages are lost
+
+    void reset() {
+        now = 0;
+        size = 0;
+        dropLastAnnouncements = 0;
+        muted = -1;
+        inboxCount = 0;
+        nextUid = 1;
+    }
+
+    // Power up a new module at `index`, shifting the modules east of it
+    void plug(uint8_t index) {
+        for (uint8_t i = size; i > index; i--) {
+            modules[i] = modules[i - 1];
+        }
+        modules[index] = &pool[nextUid % (2 * MAX)];
+        *modules[index] = Handshake();
+        modules[index]->begin(Handshake::hashUid(nextUid++, 0x5A5A, 0x1234), now);
+        size++;
+    }
+
+    void unplug(uint8_t index) {
+        for (uint8_t i = index; i + 1 < size; i++) {
+            modules[i] = modules[i + 1];
+        }
+        size--;
+    }
+
+    Handshake& at(uint8_t index) { return *modules[index]; }
+
+    void step() {
+        uint8_t frames[MAX][8];
+        uint8_t senders[MAX];
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < size; i++) {
+            for (uint8_t m = 0; m < inboxCount; m++) {
+                if (inboxSender[m] != modules[i]) {
+                    HandshakeMessage msg;
+                    TEST_ASSERT_TRUE(decodeHandshake(inbox[m], msg));
+                    modules[i]->receive(msg, now);
+                }
+            }
+            bool westIn = i > 0 && modules[i - 1]->eastOutput();
+            bool eastIn = i + 1 < size && modules[i + 1]->westOutput();
+            HandshakeMessage out;
+            if (modules[i]->update(now, westIn, eastIn, out)) {
+                if (out.kind == HANDSHAKE_ANNOUNCE && out.last && dropLastAnnouncements) {
+                    dropLastAnnouncements--;
+                    continue;
+                }
+                if (i == muted) {
+                    continue;
+                }
+                encodeHandshake(out, frames[count]);
+                senders[count++] = i;
+            }
+        }
+        for (uint8_t m = 0; m < count; m++) {
+            memcpy(inbox[m], frames[m], 8);
+            inboxSender[m] = modules[senders[m]];
+        }
+        inboxCount = count;
+        now += STEP_MS;
+    }
+
+    // Every module is complete, at its index in the row, and knows the module count
+    bool enumerated() {
+        for (uint8_t i = 0; i < size; i++) {
+            Handshake& module = at(i);
+            if (module.state() != Handshake::COMPLETE || module.position() != i || module.moduleCount() != size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Milliseconds until the row is enumerated, which must then hold for `holdMs`;
+    // UINT32_MAX if that does not happen within `limitMs`
+    uint32_t settle(uint32_t limitMs, uint32_t holdMs = 2 * HEARTBEAT_TIMEOUT_MS) {
+        uint32_t start = now;
+        uint32_t since = UINT32_MAX;
+        while (now - start < limitMs) {
+            step();
+            if (!enumerated()) {
+                since = UINT32_MAX;
+            } else if (since == UINT32_MAX) {
+                since = now;
+            } else if (now - since >= holdMs) {
+                return since - start;
+            }
+        }
+        return UINT32_MAX;
+    }
+
+private:
+    Handshake pool[2 * MAX];
+    Handshake* modules[MAX];
+    uint8_t inbox[MAX][8];
+    Handshake* inboxSender[MAX];
+    uint8_t inboxCount = 0;
+    uint32_t nextUid = 1;
+};
+
+static Row row;
+
+void setUp() { row.reset(); }
+void tearDown() {}
+
+void test_handshake_message_round_trips() {
+    const HandshakeKind kinds[] = {HANDSHAKE_ANNOUNCE, HANDSHAKE_HEARTBEAT, HANDSHAKE_RESTART};
+    for (HandshakeKind kind : kinds) {
+        HandshakeMessage msg = {0xDEADBEEF, 13, kind == HANDSHAKE_HEARTBEAT, kind};
+        HandshakeMessage decoded = {};
+        uint8_t data[8];
+        encodeHandshake(msg, data);
+        TEST_ASSERT_EQUAL_HEX8((CAN_PROTOCOL_VERSION << 4) | CAN_MSG_HANDSHAKE, data[0]);
+        TEST_ASSERT_TRUE(decodeHandshake(data, decoded));
+        TEST_ASSERT_EQUAL_HEX32(msg.uid, decoded.uid);
+        TEST_ASSERT_EQUAL_UINT8(msg.position, decoded.position);
+        TEST_ASSERT_EQUAL(msg.last, decoded.last);
+        TEST_ASSERT_EQUAL(msg.kind, decoded.kind);
+    }
+}
+
+void test_every_row_length_enumerates_at_boot() {
+    for (uint8_t n = 1; n <= Row::MAX; n++) {
+        row.reset();
+        for (uint8_t i = 0; i < n; i++) {
+            row.plug(i);
+        }
+        uint32_t ms = row.settle(5000);
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(HANDSHAKE_SETTLE_MS + n * (HANDSHAKE_RELEASE_MS + 2 * Row::STEP_MS), ms,
+                                          "row did not enumerate in time");
+        TEST_ASSERT_TRUE(row.at(0).isReceiver());
+        for (uint8_t i = 1; i < n; i++) {
+            TEST_ASSERT_FALSE(row.at(i).isReceiver());
+        }
+    }
+}
+
+// Every module of a row of `n` takes the octave east of its west neighbour, up to the
+// 9 octaves of the NoteMap
+void test_every_position_gets_its_octave() {
+    const uint8_t firstOctave[Row::MAX + 1] = {0, 4, 4, 4, 4, 4, 3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (uint8_t n = 1; n <= Row::MAX; n++) {
+        row.reset();
+        for (uint8_t i = 0; i < n; i++) {
+            row.plug(i);
+        }
+        TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(5000));
+        for (uint8_t i = 0; i < n; i++) {
+            uint8_t octave = row.at(i).octave();
+            TEST_ASSERT_EQUAL_UINT8(Handshake::octaveAt(i, n), octave);
+            TEST_ASSERT_LESS_THAN(KEYSTATE_OCTAVES, octave);
+            if (i < KEYSTATE_OCTAVES) {
+                TEST_ASSERT_EQUAL_UINT8(firstOctave[n] + i, octave);
+            } else {
+                TEST_ASSERT_EQUAL_UINT8(row.at(i - KEYSTATE_OCTAVES).octave(), octave);  // Wraps round
+            }
+        }
+    }
+}
+
+void test_every_module_learns_every_uid() {
+    for (uint8_t i = 0; i < 5; i++) {
+        row.plug(i);
+    }
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(5000));
+    for (uint8_t i = 0; i < 5; i++) {
+        for (uint8_t j = 0; j < 5; j++) {
+            TEST_ASSERT_EQUAL_HEX32(row.at(j).moduleUid(j), row.at(i).moduleUid(j));
+        }
+    }
+}
+
+void test_staggered_power_up() {
+    // Modules switched on one after another, east to west, 300 ms apart
+    for (uint8_t i = 0; i < 4; i++) {
+        row.plug(0);
+        for (uint32_t t = 0; t < 300; t += Row::STEP_MS) {
+            row.step();
+        }
+    }
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(5000));
+}
+
+void test_late_module_takes_the_next_position() {
+    for (uint8_t i = 0; i < 3; i++) {
+        row.plug(i);
+    }
+    // The east module boots while its west neighbour is already passing the token on
+    for (uint32_t t = 0; t < HANDSHAKE_SETTLE_MS + 10; t += Row::STEP_MS) {
+        row.step();
+    }
+    row.plug(3);
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(6000));
+    TEST_ASSERT_EQUAL_UINT8(4, row.at(3).moduleCount());
+}
+
+void test_lost_last_announcement_is_recovered() {
+    for (uint8_t i = 0; i < 4; i++) {
+        row.plug(i);
+    }
+    row.dropLastAnnouncements = 1;
+    uint32_t ms = row.settle(5000);
+    TEST_ASSERT_EQUAL_UINT8(0, row.dropLastAnnouncements);  // The loss did happen
+    // The eastmost module's first heartbeat tells the others the count
+    TEST_ASSERT_LESS_OR_EQUAL(HANDSHAKE_SETTLE_MS + 4 * (HANDSHAKE_RELEASE_MS + 2 * Row::STEP_MS) + HEARTBEAT_MS,
+                              ms);
+}
+
+// Hot-plugging: after a change the row must be enumerated again within a bounded time.
+// A change at either end is seen by the neighbour within HOTPLUG_DEBOUNCE_MS, then the
+// row settles again for HANDSHAKE_RESTART_SETTLE_MS and passes the token along.
+static uint32_t replugBound(uint8_t modules) {
+    return HOTPLUG_DEBOUNCE_MS + HANDSHAKE_RESTART_SETTLE_MS + modules * (HANDSHAKE_RELEASE_MS + 2 * Row::STEP_MS) +
+           4 * Row::STEP_MS;
+}
+
+static void bootRow(uint8_t modules) {
+    for (uint8_t i = 0; i < modules; i++) {
+        row.plug(i);
+    }
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(5000));
+}
+
+void test_unplugging_either_end_re_enumerates() {
+    bootRow(6);
+    row.unplug(5);
+    TEST_ASSERT_LESS_OR_EQUAL(replugBound(5), row.settle(3000));
+    TEST_ASSERT_EQUAL_UINT8(5, row.at(0).moduleCount());
+
+    // The old receiver leaves: its east neighbour takes over position 0
+    uint32_t uid = row.at(1).moduleUid(1);
+    row.unplug(0);
+    TEST_ASSERT_LESS_OR_EQUAL(replugBound(4), row.settle(3000));
+    TEST_ASSERT_TRUE(row.at(0).isReceiver());
+    TEST_ASSERT_EQUAL_HEX32(uid, row.at(0).moduleUid(0));
+}
+
+void test_plugging_in_at_either_end_re_enumerates() {
+    bootRow(3);
+    row.plug(3);
+    TEST_ASSERT_LESS_OR_EQUAL(replugBound(4), row.settle(3000));
+    row.plug(0);
+    TEST_ASSERT_LESS_OR_EQUAL(replugBound(5), row.settle(3000));
+    TEST_ASSERT_EQUAL_UINT8(5, row.at(4).moduleCount());
+}
+
+void test_a_module_can_be_swapped_in_the_middle() {
+    // Pushing the neighbours together at once leaves their inputs on, so the gap is only
+    // noticed when the heartbeats of the missing module stop
+    bootRow(5);
+    row.unplug(2);
+    TEST_ASSERT_LESS_OR_EQUAL(HEARTBEAT_TIMEOUT_MS + replugBound(4), row.settle(3000));
+    // A module swapped in the same way waits for a token nobody passes, then restarts
+    row.plug(2);
+    TEST_ASSERT_LESS_OR_EQUAL(HANDSHAKE_SETTLE_MS + HANDSHAKE_PLACED_TIMEOUT_MS + replugBound(5),
+                              row.settle(6000));
+}
+
+void test_a_full_row_re_enumerates_within_the_bound() {
+    bootRow(Row::MAX);
+    row.unplug(Row::MAX - 1);
+    uint32_t ms = row.settle(3000);
+    TEST_ASSERT_LESS_OR_EQUAL(replugBound(Row::MAX - 1), ms);
+    TEST_ASSERT_LESS_OR_EQUAL(500, ms);
+}
+
+void test_restart_bumps_every_epoch_once() {
+    bootRow(4);
+    uint32_t epochs[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        epochs[i] = row.at(i).epoch();
+    }
+    row.unplug(3);
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(3000));
+    // Both the module that noticed and the others restart, but only once each
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(epochs[i] + 1, row.at(i).epoch());
+    }
+}
+
+void test_silent_module_triggers_a_restart() {
+    bootRow(4);
+    uint32_t epoch = row.at(0).epoch();
+    uint32_t start = row.now;
+    row.muted = 2;  // Still wired, but its frames no longer reach the bus
+    while (row.at(0).epoch() == epoch && row.now - start < 2000) {
+        row.step();
+    }
+    // Its last heartbeat went out up to HEARTBEAT_MS before it fell silent
+    TEST_ASSERT_LESS_OR_EQUAL(HEARTBEAT_TIMEOUT_MS, row.now - start);
+    TEST_ASSERT_GREATER_OR_EQUAL(HEARTBEAT_TIMEOUT_MS - HEARTBEAT_MS, row.now - start);
+
+    // Once it is heard again the row comes back together
+    row.muted = -1;
+    TEST_ASSERT_NOT_EQUAL(UINT32_MAX, row.settle(6000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_handshake_message_round_trips);
+    RUN_TEST(test_every_row_length_enumerates_at_boot);
+    RUN_TEST(test_every_position_gets_its_octave);
+    RUN_TEST(test_every_module_learns_every_uid);
+    RUN_TEST(test_staggered_power_up);
+    RUN_TEST(test_late_module_takes_the_next_position);
+    RUN_TEST(test_lost_last_announcement_is_recovered);
+    RUN_TEST(test_unplugging_either_end_re_enumerates);
+    RUN_TEST(test_plugging_in_at_either_end_re_enumerates);
+    RUN_TEST(test_a_module_can_be_swapped_in_the_middle);
+    RUN_TEST(test_a_full_row_re_enumerates_within_the_bound);
+    RUN_TEST(test_restart_bumps_every_epoch_once);
+    RUN_TEST(test_silent_module_triggers_a_restart);
+    return UNITY_END();
+}
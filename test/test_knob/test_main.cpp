@@ -0,0 +1,104 @@
+#include <unity.h>
+#include "knob.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+// {B,A} states in clockwise order
+static const uint8_t CLOCKWISE[4] = {0b00, 0b01, 0b11, 0b10};
+
+// Turn `steps` detents (negative is anticlockwise), `intervalUs` apart. Returns the last time.
+static uint32_t turn(Knob& knob, uint8_t& phase, int32_t steps, uint32_t startUs, uint32_t intervalUs) {
+    uint32_t now = startUs;
+    for (int32_t i = 0; i < (steps < 0 ? -steps : steps); i++) {
+        phase = (phase + (steps < 0 ? 3 : 1)) & 3;
+        now += intervalUs;
+        knob.update(CLOCKWISE[phase], now);
+    }
+    return now;
+}
+
+void test_transition_table_is_gray_code() {
+    for (uint8_t prev = 0; prev < 4; prev++) {
+        for (uint8_t curr = 0; curr < 4; curr++) {
+            uint8_t changed = CLOCKWISE[prev] ^ CLOCKWISE[curr];
+            int8_t expected = changed == 0 ? 0 : changed == 3 ? Knob::IMPOSSIBLE : curr == ((prev + 1) & 3) ? +1 : -1;
+            TEST_ASSERT_EQUAL_INT8(expected, Knob::transition(CLOCKWISE[prev], CLOCKWISE[curr]));
+        }
+    }
+}
+
+void test_turns_are_counted_and_bounded() {
+    Knob knob(0, 8, 4);
+    uint8_t phase = 0;
+    uint32_t now = turn(knob, phase, 3, 1000000, 100000);
+    TEST_ASSERT_EQUAL_INT32(7, knob.value());
+    now = turn(knob, phase, 5, now, 100000);
+    TEST_ASSERT_EQUAL_INT32(8, knob.value());  // Held at the upper bound
+    now = turn(knob, phase, -2, now, 100000);
+    TEST_ASSERT_EQUAL_INT32(6, knob.value());  // Turning back moves at once
+    turn(knob, phase, -20, now, 100000);
+    TEST_ASSERT_EQUAL_INT32(0, knob.value());
+}
+
+void test_update_returns_the_applied_change() {
+    Knob knob(0, 1, 0);
+    TEST_ASSERT_EQUAL_INT32(1, knob.update(0b01, 1000000));
+    TEST_ASSERT_EQUAL_INT32(0, knob.update(0b11, 1100000));  // Clamped
+    TEST_ASSERT_EQUAL_INT32(0, knob.update(0b11, 1200000));  // No transition
+}
+
+void test_impossible_transition_continues_the_last_direction() {
+    Knob knob(-100, 100, 0);
+    TEST_ASSERT_EQUAL_INT32(0, knob.update(0b11, 1000000));  // No history: ignored
+    knob.update(0b10, 1100000);  // 11 -> 10 is clockwise
+    TEST_ASSERT_EQUAL_INT32(1, knob.value());
+    TEST_ASSERT_EQUAL_INT32(2, knob.update(0b01, 1200000));  // Skipped 00
+    TEST_ASSERT_EQUAL_INT32(3, knob.value());
+
+    knob.update(0b00, 1300000);  // 01 -> 00 is anticlockwise
+    TEST_ASSERT_EQUAL_INT32(-2, knob.update(0b11, 1400000));
+    TEST_ASSERT_EQUAL_INT32(0, knob.value());
+}
+
+void test_acceleration_scales_fast_turns_only() {
+    Knob knob(0, 1000, 0, 8);
+    uint8_t phase = 0;
+    uint32_t now = turn(knob, phase, 4, 1000000, Knob::ACCEL_WINDOW_US);
+    TEST_ASSERT_EQUAL_INT32(4, knob.value());  // Slow: one per detent
+
+    int32_t before = knob.value();
+    now = turn(knob, phase, 4, now, 0);
+    TEST_ASSERT_EQUAL_INT32(before + 4 * 8, knob.value());  // Back-to-back: full acceleration
+
+    before = knob.value();
+    now = turn(knob, phase, 1, now, Knob::ACCEL_WINDOW_US / 2);
+    TEST_ASSERT_EQUAL_INT32(before + 1 + 7 / 2, knob.value());  // Half the window: halfway
+
+    knob.setAcceleration(0);  // Treated as 1
+    before = knob.value();
+    turn(knob, phase, 4, now, 0);
+    TEST_ASSERT_EQUAL_INT32(before + 4, knob.value());
+}
+
+void test_limits_are_per_knob() {
+    Knob volume(0, 8, 8);
+    Knob cutoff(0, 127, 200);
+    TEST_ASSERT_EQUAL_INT32(8, volume.value());
+    TEST_ASSERT_EQUAL_INT32(127, cutoff.value());  // Initial value clamped
+    cutoff.setLimits(0, 63);
+    TEST_ASSERT_EQUAL_INT32(63, cutoff.value());
+    volume.setValue(-5);
+    TEST_ASSERT_EQUAL_INT32(0, volume.value());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_transition_table_is_gray_code);
+    RUN_TEST(test_turns_are_counted_and_bounded);
+    RUN_TEST(test_update_returns_the_applied_change);
+    RUN_TEST(test_impossible_transition_continues_the_last_direction);
+    RUN_TEST(test_acceleration_scales_fast_turns_only);
+    RUN_TEST(test_limits_are_per_knob);
+    return UNITY_END();
+}
@@ -0,0 +1,260 @@
+#include <unity.h>
+#include <cstring>
+#include "midi.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+struct Bytes {
+    uint8_t data[256];
+    uint32_t size = 0;
+
+    void add(const uint8_t* bytes, uint32_t n) {
+        TEST_ASSERT_LESS_OR_EQUAL(sizeof(data), size + n);
+        memcpy(data + size, bytes, n);
+        size += n;
+    }
+    // Variable-length quantity, as used for delta times and lengths in a standard MIDI file
+    void vlq(uint32_t value) {
+        uint8_t groups[5];
+        uint8_t n = 0;
+        groups[n++] = value & 0x7F;
+        while (value >>= 7) {
+            groups[n++] = (value & 0x7F) | 0x80;
+        }
+        while (n) {
+            data[size++] = groups[--n];
+        }
+    }
+};
+
+#define EVENT(track, delta, ...) do { \
+        const uint8_t bytes[] = {__VA_ARGS__}; \
+        (track).vlq(delta); \
+        (track).add(bytes, sizeof(bytes)); \
+    } while (0)
+
+static uint32_t readVlq(const Bytes& file, uint32_t& i) {
+    uint32_t value = 0;
+    uint8_t byte;
+    do {
+        byte = file.data[i++];
+        value = value << 7 | (byte & 0x7F);
+    } while (byte & 0x80);
+    return value;
+}
+
+// Plays a single-track standard MIDI file into `parser` at the time of each event, in us,
+// the way it would arrive on the serial port: meta events are not sent, SysEx is sent as
+// F0 and its data, and a clock byte is slipped into every message after its first byte.
+static uint8_t play(const Bytes& file, MidiParser& parser, KeyEvent* out, uint8_t capacity) {
+    TEST_ASSERT_EQUAL_MEMORY("MThd", file.data, 4);
+    uint32_t division = file.data[12] << 8 | file.data[13];
+    TEST_ASSERT_EQUAL_MEMORY("MTrk", file.data + 14, 4);
+    uint32_t i = 22;
+    uint32_t tempo = 500000;  // us per quarter note until a tempo event
+    uint64_t timeUs = 0;
+    uint8_t runningStatus = 0;
+    uint8_t count = 0;
+    KeyEvent event;
+    while (i < file.size) {
+        timeUs += (uint64_t)readVlq(file, i) * tempo / division;
+        uint32_t time = (uint32_t)timeUs;
+        uint8_t first = file.data[i];
+        if (first == 0xFF) {
+            uint8_t type = file.data[i + 1];
+            i += 2;
+            uint32_t length = readVlq(file, i);
+            if (type == 0x51) {
+                tempo = file.data[i] << 16 | file.data[i + 1] << 8 | file.data[i + 2];
+            }
+            if (type == 0x2F) {
+                break;
+            }
+            i += length;
+            continue;
+        }
+        if (first == 0xF0) {
+            i++;
+            uint32_t length = readVlq(file, i);
+            TEST_ASSERT_FALSE(parser.feed(0xF0, time, event));
+            for (uint32_t k = 0; k < length; k++) {
+                TEST_ASSERT_FALSE(parser.feed(file.data[i++], time, event));
+            }
+            continue;
+        }
+        uint8_t message[3];
+        uint8_t length = 0;
+        if (first & 0x80) {
+            runningStatus = first;
+            message[length++] = file.data[i++];
+        }
+        uint8_t type = runningStatus & 0xF0;
+        uint8_t dataBytes = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+        for (uint8_t k = 0; k < dataBytes; k++) {
+            message[length++] = file.data[i++];
+        }
+        for (uint8_t k = 0; k < length; k++) {
+            if (parser.feed(message[k], time, event)) {
+                TEST_ASSERT_LESS_THAN(capacity, count);
+                out[count++] = event;
+            }
+            if (k == 0) {
+                TEST_ASSERT_FALSE(parser.feed(0xF8, time, event));
+            }
+        }
+    }
+    return count;
+}
+
+static Bytes smf(const Bytes& track, uint16_t division) {
+    Bytes file;
+    const uint8_t header[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1,
+                              (uint8_t)(division >> 8), (uint8_t)division, 'M', 'T', 'r', 'k',
+                              (uint8_t)(track.size >> 24), (uint8_t)(track.size >> 16),
+                              (uint8_t)(track.size >> 8), (uint8_t)track.size};
+    file.add(header, sizeof(header));
+    file.add(track.data, track.size);
+    return file;
+}
+
+static void assertEvent(uint32_t time, uint8_t note, bool pressed, const KeyEvent& event) {
+    TEST_ASSERT_EQUAL_UINT32(time, event.time);
+    TEST_ASSERT_EQUAL_UINT8(note, event.octave * 12 + event.key);
+    TEST_ASSERT_EQUAL_UINT8(pressed, event.pressed);
+    TEST_ASSERT_EQUAL_UINT8(0, event.module);
+}
+
+void test_file_plays_with_its_timing() {
+    Bytes track;
+    EVENT(track, 0, 0xFF, 0x51, 3, 0x07, 0xA1, 0x20);  // 120 bpm
+    EVENT(track, 0, 0xC0, 5);                           // Program change
+    EVENT(track, 0, 0x90, 60, 100);
+    EVENT(track, 0, 64, 100);                           // Running status
+    EVENT(track, 240, 0xE0, 0, 64);                     // Pitch bend
+    EVENT(track, 240, 0x90, 60, 0);                     // Velocity 0 releases
+    EVENT(track, 0, 0x80, 64, 64);
+    EVENT(track, 0, 0xF0, 3, 0x7E, 0x01, 0xF7);         // SysEx
+    EVENT(track, 0, 0xFF, 0x51, 3, 0x0F, 0x42, 0x40);  // 60 bpm
+    EVENT(track, 480, 0x93, 11, 100);                   // Below the range, channel 4
+    EVENT(track, 0, 120, 100);                          // Above the range
+    EVENT(track, 0, 119, 100);                          // B8, the top note
+    EVENT(track, 960, 12, 90);                          // C0, the bottom note
+    EVENT(track, 0, 0xFF, 0x2F, 0);
+
+    MidiParser parser;
+    KeyEvent events[8];
+    TEST_ASSERT_EQUAL_UINT8(6, play(smf(track, 480), parser, events, 8));
+    assertEvent(0, 48, true, events[0]);
+    assertEvent(0, 52, true, events[1]);
+    assertEvent(500000, 48, false, events[2]);
+    assertEvent(500000, 52, false, events[3]);
+    assertEvent(1500000, 107, true, events[4]);
+    assertEvent(3500000, 0, true, events[5]);
+}
+
+void test_system_messages_cancel_running_status() {
+    MidiParser parser;
+    KeyEvent event;
+    TEST_ASSERT_FALSE(parser.feed(0x90, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_TRUE(parser.feed(100, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(0xF0, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(0xF7, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(100, 0, event));
+    // Song position is system common too
+    TEST_ASSERT_FALSE(parser.feed(0x90, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(0xF2, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(100, 0, event));
+}
+
+void test_real_time_bytes_keep_running_status() {
+    MidiParser parser;
+    KeyEvent event;
+    TEST_ASSERT_FALSE(parser.feed(0x80, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(0xFE, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(62, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(0xFA, 0, event));
+    TEST_ASSERT_TRUE(parser.feed(0, 9, event));
+    assertEvent(9, 50, false, event);
+    TEST_ASSERT_FALSE(parser.feed(0xFC, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(63, 0, event));
+    TEST_ASSERT_TRUE(parser.feed(0, 10, event));
+    assertEvent(10, 51, false, event);
+}
+
+void test_data_before_any_status_is_ignored() {
+    MidiParser parser;
+    KeyEvent event;
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(100, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(0x91, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_TRUE(parser.feed(100, 0, event));
+    parser.reset();
+    TEST_ASSERT_FALSE(parser.feed(60, 0, event));
+    TEST_ASSERT_FALSE(parser.feed(100, 0, event));
+}
+
+void test_writer_uses_running_status_and_refreshes_it() {
+    MidiWriter writer(3);
+    const KeyEvent events[6] = {
+        {1000, 4, 0, 1, 0},
+        {1000, 4, 4, 1, 0},
+        {1000, 4, 7, 1, 0},
+        {200000, 4, 0, 0, 0},
+        {200000 + MIDI_RUNNING_STATUS_MS * 1000, 4, 4, 0, 0},  // After a gap: status again
+        {200000 + MIDI_RUNNING_STATUS_MS * 1000, 8, 11, 1, 0},
+    };
+    // C4 is MIDI 60
+    const uint8_t expected[] = {0x92, 60, MIDI_VELOCITY, 64, MIDI_VELOCITY, 67, MIDI_VELOCITY, 60, 0,
+                                0x92, 64, 0, 119, MIDI_VELOCITY};
+    Bytes stream;
+    uint8_t bytes[3];
+    for (uint8_t i = 0; i < 6; i++) {
+        stream.add(bytes, writer.encode(events[i], bytes));
+    }
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected), stream.size);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, stream.data, sizeof(expected));
+
+    // And the parser reads it back
+    MidiParser parser;
+    KeyEvent event;
+    uint8_t count = 0;
+    for (uint32_t i = 0; i < stream.size; i++) {
+        if (parser.feed(stream.data[i], 0, event)) {
+            TEST_ASSERT_EQUAL_UINT8(events[count].octave, event.octave);
+            TEST_ASSERT_EQUAL_UINT8(events[count].key, event.key);
+            TEST_ASSERT_EQUAL_UINT8(events[count].pressed, event.pressed);
+            count++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(6, count);
+}
+
+void test_writer_reset_and_range() {
+    MidiWriter writer(16);
+    uint8_t bytes[3];
+    KeyEvent event = {0, 4, 0, 1, 0};
+    TEST_ASSERT_EQUAL_UINT8(3, writer.encode(event, bytes));
+    TEST_ASSERT_EQUAL_HEX8(0x9F, bytes[0]);
+    TEST_ASSERT_EQUAL_UINT8(2, writer.encode(event, bytes));
+    writer.reset();  // That message was not sent
+    TEST_ASSERT_EQUAL_UINT8(3, writer.encode(event, bytes));
+    KeyEvent beyond = {0, 9, 0, 1, 0};
+    TEST_ASSERT_EQUAL_UINT8(0, writer.encode(beyond, bytes));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_file_plays_with_its_timing);
+    RUN_TEST(test_system_messages_cancel_running_status);
+    RUN_TEST(test_real_time_bytes_keep_running_status);
+    RUN_TEST(test_data_before_any_status_is_ignored);
+    RUN_TEST(test_writer_uses_running_status_and_refreshes_it);
+    RUN_TEST(test_writer_reset_and_range);
+    return UNITY_END();
+}
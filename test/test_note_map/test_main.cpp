@@ -0,0 +1,114 @@
+#include <unity.h>
+#include "note_map.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+void test_empty_map() {
+    NoteMap map;
+    TEST_ASSERT_TRUE(map.empty());
+    TEST_ASSERT_EQUAL_INT(-1, map.highest());
+    for (uint8_t note = 0; note < NoteMap::NOTES; note++) {
+        TEST_ASSERT_FALSE(map.held(note));
+        TEST_ASSERT_EQUAL_HEX16(0, map.owners(note));
+    }
+}
+
+void test_shared_note_sounds_until_the_last_owner_releases() {
+    NoteMap map;
+    TEST_ASSERT_TRUE(map.press(1, 50));
+    TEST_ASSERT_FALSE(map.press(2, 50));
+    TEST_ASSERT_FALSE(map.press(2, 50));  // Repeated press from the same module
+    TEST_ASSERT_EQUAL_HEX16(0x0006, map.owners(50));
+    TEST_ASSERT_FALSE(map.release(1, 50));
+    TEST_ASSERT_TRUE(map.held(50));
+    TEST_ASSERT_FALSE(map.release(1, 50));  // Already released by this module
+    TEST_ASSERT_TRUE(map.release(2, 50));
+    TEST_ASSERT_FALSE(map.held(50));
+    TEST_ASSERT_TRUE(map.empty());
+}
+
+void test_release_from_a_non_owner_is_ignored() {
+    NoteMap map;
+    map.press(3, 20);
+    TEST_ASSERT_FALSE(map.release(4, 20));
+    TEST_ASSERT_TRUE(map.held(20));
+    TEST_ASSERT_FALSE(map.release(4, 21));
+}
+
+void test_out_of_range_is_ignored() {
+    NoteMap map;
+    TEST_ASSERT_FALSE(map.press(0, NoteMap::NOTES));
+    TEST_ASSERT_FALSE(map.press(NoteMap::MODULES, 10));
+    TEST_ASSERT_FALSE(map.release(0, NoteMap::NOTES));
+    TEST_ASSERT_FALSE(map.held(NoteMap::NOTES));
+    TEST_ASSERT_EQUAL_HEX16(0, map.owners(255));
+    TEST_ASSERT_TRUE(map.empty());
+}
+
+void test_every_note_and_word_boundary() {
+    NoteMap map;
+    for (uint8_t note = 0; note < NoteMap::NOTES; note++) {
+        TEST_ASSERT_TRUE(map.press(note % NoteMap::MODULES, note));
+        TEST_ASSERT_EQUAL_INT(note, map.highest());
+    }
+    for (uint8_t note = 0; note < NoteMap::NOTES; note++) {
+        TEST_ASSERT_TRUE(map.held(note));
+        TEST_ASSERT_EQUAL_HEX16(1 << (note % NoteMap::MODULES), map.owners(note));
+    }
+    for (int note = NoteMap::NOTES - 1; note > 0; note--) {
+        TEST_ASSERT_TRUE(map.release(note % NoteMap::MODULES, note));
+        TEST_ASSERT_EQUAL_INT(note - 1, map.highest());
+    }
+    TEST_ASSERT_TRUE(map.release(0, 0));
+    TEST_ASSERT_TRUE(map.empty());
+}
+
+void test_release_module_keeps_shared_notes() {
+    NoteMap map;
+    map.press(3, 10);
+    map.press(4, 10);
+    map.press(3, 60);
+    map.press(3, 107);
+    map.press(5, 31);
+    map.press(5, 32);
+    TEST_ASSERT_EQUAL_UINT8(3, map.count(3));
+
+    uint8_t out[NoteMap::NOTES];
+    TEST_ASSERT_EQUAL_UINT8(2, map.releaseModule(3, out));
+    TEST_ASSERT_EQUAL_UINT8(60, out[0]);
+    TEST_ASSERT_EQUAL_UINT8(107, out[1]);
+    TEST_ASSERT_TRUE(map.held(10));
+    TEST_ASSERT_EQUAL_HEX16(1 << 4, map.owners(10));
+    TEST_ASSERT_FALSE(map.held(60));
+    TEST_ASSERT_FALSE(map.held(107));
+    TEST_ASSERT_EQUAL_UINT8(0, map.count(3));
+    TEST_ASSERT_EQUAL_INT(32, map.highest());
+
+    TEST_ASSERT_EQUAL_UINT8(2, map.releaseModule(5));
+    TEST_ASSERT_EQUAL_UINT8(1, map.releaseModule(4));
+    TEST_ASSERT_EQUAL_UINT8(0, map.releaseModule(4));
+    TEST_ASSERT_TRUE(map.empty());
+}
+
+void test_clear() {
+    NoteMap map;
+    map.press(0, 0);
+    map.press(15, 107);
+    map.clear();
+    TEST_ASSERT_TRUE(map.empty());
+    TEST_ASSERT_EQUAL_HEX16(0, map.owners(107));
+    TEST_ASSERT_TRUE(map.press(15, 107));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_map);
+    RUN_TEST(test_shared_note_sounds_until_the_last_owner_releases);
+    RUN_TEST(test_release_from_a_non_owner_is_ignored);
+    RUN_TEST(test_out_of_range_is_ignored);
+    RUN_TEST(test_every_note_and_word_boundary);
+    RUN_TEST(test_release_module_keeps_shared_notes);
+    RUN_TEST(test_clear);
+    return UNITY_END();
+}
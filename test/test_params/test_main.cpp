@@ -0,0 +1,93 @@
+#include <unity.h>
+#include "params.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+void test_starts_at_the_initial_values() {
+    ParamRegistry registry;
+    ParamSnapshot snapshot;
+    TEST_ASSERT_TRUE(registry.trySnapshot(snapshot));
+    for (uint8_t i = 0; i < PARAM_COUNT; i++) {
+        TEST_ASSERT_EQUAL_INT32(ParamRegistry::info((ParamId)i).initial, snapshot[(ParamId)i]);
+        TEST_ASSERT_EQUAL_INT32(snapshot[(ParamId)i], registry.get((ParamId)i));
+    }
+}
+
+void test_set_clamps_to_the_range() {
+    ParamRegistry registry;
+    TEST_ASSERT_TRUE(registry.set(PARAM_CUTOFF, -20));
+    TEST_ASSERT_EQUAL_INT32(0, registry.get(PARAM_CUTOFF));
+    TEST_ASSERT_TRUE(registry.set(PARAM_WAVEFORM, 100));
+    TEST_ASSERT_EQUAL_INT32(WAVE_COUNT - 1, registry.get(PARAM_WAVEFORM));
+    TEST_ASSERT_FALSE(registry.set(PARAM_WAVEFORM, 200));  // Clamps to the same value
+}
+
+struct Change {
+    uint8_t count;
+    ParamId id;
+    int32_t value;
+    ParamSnapshot seen;  // What a reader gets from inside the listener
+    ParamRegistry* registry;
+};
+
+static void recordChange(ParamId id, int32_t value, void* context) {
+    Change* change = static_cast<Change*>(context);
+    change->count++;
+    change->id = id;
+    change->value = value;
+    TEST_ASSERT_TRUE(change->registry->trySnapshot(change->seen));
+}
+
+void test_listeners_run_after_the_value_is_published() {
+    ParamRegistry registry;
+    Change first = {};
+    Change second = {};
+    first.registry = second.registry = &registry;
+    TEST_ASSERT_TRUE(registry.addListener(recordChange, &first));
+    TEST_ASSERT_TRUE(registry.addListener(recordChange, &second));
+
+    TEST_ASSERT_TRUE(registry.set(PARAM_OCTAVE, 6));
+    TEST_ASSERT_FALSE(registry.set(PARAM_OCTAVE, 6));  // Unchanged: nobody is told
+    Change* changes[] = {&first, &second};
+    for (Change* change : changes) {
+        TEST_ASSERT_EQUAL_UINT8(1, change->count);
+        TEST_ASSERT_EQUAL(PARAM_OCTAVE, change->id);
+        TEST_ASSERT_EQUAL_INT32(6, change->value);
+        TEST_ASSERT_EQUAL_INT32(6, change->seen[PARAM_OCTAVE]);
+    }
+}
+
+void test_listener_slots_are_bounded() {
+    ParamRegistry registry;
+    Change change = {};
+    change.registry = &registry;
+    for (uint8_t i = 0; i < ParamRegistry::MAX_LISTENERS; i++) {
+        TEST_ASSERT_TRUE(registry.addListener(recordChange, &change));
+    }
+    TEST_ASSERT_FALSE(registry.addListener(recordChange, &change));
+    registry.set(PARAM_VOLUME, 3);
+    TEST_ASSERT_EQUAL_UINT8(ParamRegistry::MAX_LISTENERS, change.count);
+}
+
+void test_snapshot_holds_every_value_of_the_last_writes() {
+    ParamRegistry registry;
+    for (int32_t i = 0; i < 1000; i++) {
+        registry.set(PARAM_VOLUME, i % 9);
+        registry.set(PARAM_CUTOFF, i % 128);
+        ParamSnapshot snapshot;
+        registry.snapshot(snapshot);  // Returns at once when no write is in progress
+        TEST_ASSERT_EQUAL_INT32(i % 9, snapshot[PARAM_VOLUME]);
+        TEST_ASSERT_EQUAL_INT32(i % 128, snapshot[PARAM_CUTOFF]);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_at_the_initial_values);
+    RUN_TEST(test_set_clamps_to_the_range);
+    RUN_TEST(test_listeners_run_after_the_value_is_published);
+    RUN_TEST(test_listener_slots_are_bounded);
+    RUN_TEST(test_snapshot_holds_every_value_of_the_last_writes);
+    return UNITY_END();
+}
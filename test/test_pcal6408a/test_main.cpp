@@ -0,0 +1,172 @@
+#include <unity.h>
+#include "pcal6408a.hpp"
+#include "knob.hpp"
+
+// In-memory PCAL6408A on a mock bus. Models what the driver relies on: polarity
+// inversion, input latching and the interrupt output, which is cleared by reading the
+// input port. The I2C address can be made to NACK.
+class MockPcal6408a : public I2CBus {
+public:
+    uint8_t regs[256] = {};
+    uint8_t writes[16][2] = {};  // {register, value} in the order written
+    uint8_t writeCount = 0;
+    uint8_t address = PCAL6408A::ADDRESS;
+    bool present = true;
+
+    MockPcal6408a() {
+        regs[PCAL6408A::CONFIGURATION] = 0xFF;   // Power-on defaults
+        regs[PCAL6408A::PULL_SELECT] = 0xFF;
+        regs[PCAL6408A::INTERRUPT_MASK] = 0xFF;
+    }
+
+    bool writeRegister(uint8_t addr, uint8_t reg, uint8_t value) override {
+        if (!present || addr != address) {
+            return false;
+        }
+        if (writeCount < 16) {
+            writes[writeCount][0] = reg;
+            writes[writeCount][1] = value;
+            writeCount++;
+        }
+        regs[reg] = value;
+        return true;
+    }
+
+    bool readRegister(uint8_t addr, uint8_t reg, uint8_t& value) override {
+        if (!present || addr != address) {
+            return false;
+        }
+        if (reg == PCAL6408A::INPUT_PORT) {
+            value = latchValid ? latched : inputs();
+            lastRead = pins;
+            latchValid = false;
+            interrupt = false;
+            return true;
+        }
+        value = regs[reg];
+        return true;
+    }
+
+    // Drive the pins (1 = high). The knob contacts pull a pin low when closed.
+    void setPins(uint8_t value) {
+        uint8_t changed = (pins ^ value) & ~regs[PCAL6408A::INTERRUPT_MASK];
+        pins = value;
+        if (changed && !latchValid && (regs[PCAL6408A::INPUT_LATCH] & changed)) {
+            latched = inputs();  // Held until the input port is read
+            latchValid = true;
+        }
+        if ((pins ^ lastRead) & ~regs[PCAL6408A::INTERRUPT_MASK]) {
+            interrupt = true;
+        }
+    }
+
+    bool interruptAsserted() const { return interrupt; }
+
+private:
+    uint8_t inputs() const { return pins ^ regs[PCAL6408A::POLARITY_INVERSION]; }
+
+    uint8_t pins = 0xFF;  // Open contacts, pulled up
+    uint8_t lastRead = 0xFF;
+    uint8_t latched = 0;
+    bool latchValid = false;
+    bool interrupt = false;
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_begin_configures_inputs_pulls_latch_and_interrupts() {
+    MockPcal6408a device;
+    PCAL6408A expander(device);
+    TEST_ASSERT_TRUE(expander.begin());
+
+    // The direction and pulls are set before the interrupt is unmasked
+    const uint8_t expected[][2] = {
+        {PCAL6408A::CONFIGURATION, 0xFF},
+        {PCAL6408A::PULL_SELECT, 0xFF},
+        {PCAL6408A::PULL_ENABLE, 0xFF},
+        {PCAL6408A::POLARITY_INVERSION, 0xFF},
+        {PCAL6408A::INPUT_LATCH, 0xFF},
+        {PCAL6408A::INTERRUPT_MASK, 0x00},
+    };
+    TEST_ASSERT_EQUAL_UINT8(6, device.writeCount);
+    TEST_ASSERT_EQUAL_MEMORY(expected, device.writes, sizeof(expected));
+    TEST_ASSERT_FALSE(device.interruptAsserted());
+}
+
+void test_missing_device_fails_begin() {
+    MockPcal6408a device;
+    device.present = false;
+    PCAL6408A expander(device);
+    TEST_ASSERT_FALSE(expander.begin());
+
+    MockPcal6408a other;
+    other.address = 0x20;
+    PCAL6408A wrongAddress(other);
+    TEST_ASSERT_FALSE(wrongAddress.begin());
+    TEST_ASSERT_EQUAL_UINT8(0, other.writeCount);
+}
+
+void test_closed_contacts_read_as_one() {
+    MockPcal6408a device;
+    PCAL6408A expander(device);
+    expander.begin();
+    uint8_t value;
+    TEST_ASSERT_TRUE(expander.readInputs(value));
+    TEST_ASSERT_EQUAL_HEX8(0x00, value);
+
+    device.setPins(0xFF & ~0x05);  // Knob 0 A and knob 1 A closed
+    TEST_ASSERT_TRUE(device.interruptAsserted());
+    TEST_ASSERT_TRUE(expander.readInputs(value));
+    TEST_ASSERT_EQUAL_HEX8(0x05, value);
+    TEST_ASSERT_FALSE(device.interruptAsserted());  // Reading the inputs clears it
+}
+
+void test_latch_holds_a_pulse_until_read() {
+    MockPcal6408a device;
+    PCAL6408A expander(device);
+    expander.begin();
+    device.setPins(0xFE);
+    device.setPins(0xFF);  // Gone again before the read
+    TEST_ASSERT_TRUE(device.interruptAsserted());
+    uint8_t value;
+    expander.readInputs(value);
+    TEST_ASSERT_EQUAL_HEX8(0x01, value);
+    expander.readInputs(value);
+    TEST_ASSERT_EQUAL_HEX8(0x00, value);
+}
+
+// A fast turn of knob 3: one read per interrupt, as knobExpanderTask does, loses no steps
+void test_reading_on_interrupt_keeps_every_step_of_a_fast_turn() {
+    static const uint8_t CLOCKWISE[4] = {0b00, 0b01, 0b11, 0b10};
+    MockPcal6408a device;
+    PCAL6408A expander(device);
+    expander.begin();
+    Knob knob(0, 1000, 0);
+
+    uint32_t now = 1000000;
+    uint8_t reads = 0;
+    for (uint8_t step = 1; step <= 40; step++) {
+        uint8_t state = CLOCKWISE[step & 3];
+        device.setPins(~(state << 6));  // Knob 3 on P6 (A) and P7 (B), active low
+        now += 2000;                    // 2 ms per detent, faster than a 50 ms scan
+        if (device.interruptAsserted()) {
+            uint8_t value;
+            TEST_ASSERT_TRUE(expander.readInputs(value));
+            knob.update(value >> 6, now);
+            reads++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(40, reads);
+    TEST_ASSERT_EQUAL_INT32(40, knob.value());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_configures_inputs_pulls_latch_and_interrupts);
+    RUN_TEST(test_missing_device_fails_begin);
+    RUN_TEST(test_closed_contacts_read_as_one);
+    RUN_TEST(test_latch_holds_a_pulse_until_read);
+    RUN_TEST(test_reading_on_interrupt_keeps_every_step_of_a_fast_turn);
+    return UNITY_END();
+}
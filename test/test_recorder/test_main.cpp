@@ -0,0 +1,232 @@
+#include <unity.h>
+#include "recorder.hpp"
+
+// Two instances so a playback can be recorded again; each is 4 KB, so keep them static
+static Recorder take;
+static Recorder copy;
+
+void setUp() {}
+void tearDown() {}
+
+static KeyEvent keyEvent(uint32_t time, uint8_t note, bool pressed, uint8_t module = 0) {
+    return {time, (uint8_t)(note / 12), (uint8_t)(note % 12), (uint8_t)pressed, module};
+}
+
+static void assertSameEvent(const KeyEvent& expected, const KeyEvent& actual) {
+    TEST_ASSERT_EQUAL_UINT8(expected.octave, actual.octave);
+    TEST_ASSERT_EQUAL_UINT8(expected.key, actual.key);
+    TEST_ASSERT_EQUAL_UINT8(expected.pressed, actual.pressed);
+    TEST_ASSERT_EQUAL_UINT8(expected.module, actual.module);
+}
+
+void test_event_encoding_round_trips() {
+    const uint32_t deltas[] = {0, 1, 15, 16, 2047, 2048, 262143, 262144, 0x1FFFFFFF};
+    const uint8_t sizes[] = {2, 2, 2, 3, 3, 4, 4, 5, 6};
+    uint8_t bytes[Recorder::MAX_EVENT_BYTES];
+    for (uint8_t i = 0; i < sizeof(deltas) / sizeof(deltas[0]); i++) {
+        for (uint8_t note = 0; note < 108; note += 7) {
+            KeyEvent event = keyEvent(0, note, note & 1, note % 8);
+            TEST_ASSERT_EQUAL_UINT8(sizes[i], Recorder::encode(bytes, deltas[i], event));
+            uint32_t delta;
+            KeyEvent decoded;
+            TEST_ASSERT_EQUAL_UINT8(sizes[i], Recorder::decode(bytes, delta, decoded));
+            TEST_ASSERT_EQUAL_UINT32(deltas[i], delta);
+            assertSameEvent(event, decoded);
+        }
+    }
+}
+
+// A short phrase with a chord, notes from two modules and sub-millisecond timestamps
+static const uint32_t START_US = 1000000;
+static const KeyEvent PHRASE[] = {
+    keyEvent(START_US + 10250, 48, true),
+    keyEvent(START_US + 10900, 52, true),
+    keyEvent(START_US + 11000, 55, true, 1),
+    keyEvent(START_US + 250400, 48, false),
+    keyEvent(START_US + 250400, 52, false),
+    keyEvent(START_US + 251000, 55, false, 1),
+    keyEvent(START_US + 400000, 60, true),
+    keyEvent(START_US + 1900000, 60, false),  // 1.9 s after the start: a 2-byte varint
+};
+static const uint8_t PHRASE_LENGTH = sizeof(PHRASE) / sizeof(PHRASE[0]);
+
+static void recordPhrase(uint32_t endUs) {
+    take.record(START_US);
+    for (const KeyEvent& event : PHRASE) {
+        TEST_ASSERT_TRUE(take.capture(event));
+    }
+    take.play(endUs);
+}
+
+void test_playback_reproduces_the_take() {
+    const uint32_t endUs = START_US + 2000000;
+    recordPhrase(endUs);
+    TEST_ASSERT_EQUAL(Recorder::PLAYING, take.state());
+    TEST_ASSERT_EQUAL_UINT32(2000, take.loopMs());
+
+    KeyEvent out[4];
+    uint8_t played = 0;
+    for (uint32_t t = endUs; t < endUs + 2000000; t += 1000) {
+        uint8_t count = take.poll(t, out, 4);
+        for (uint8_t i = 0; i < count; i++, played++) {
+            assertSameEvent(PHRASE[played], out[i]);
+            uint32_t offsetMs = (PHRASE[played].time - START_US) / 1000;
+            TEST_ASSERT_EQUAL_UINT32(endUs + offsetMs * 1000, out[i].time);
+            TEST_ASSERT_LESS_OR_EQUAL(1000, t - out[i].time);  // Due at most one poll ago
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(PHRASE_LENGTH, played);
+}
+
+void test_recording_the_playback_is_bit_exact() {
+    const uint32_t endUs = START_US + 2000000;
+    recordPhrase(endUs);
+
+    // Feed one pass of the loop back in, as scanKeysTask would with live keys
+    copy.record(endUs);
+    KeyEvent out[4];
+    for (uint32_t t = endUs; t < endUs + 2000000; t += 1000) {
+        uint8_t count = take.poll(t, out, 4);
+        for (uint8_t i = 0; i < count; i++) {
+            TEST_ASSERT_TRUE(copy.capture(out[i]));
+        }
+    }
+    copy.play(endUs + 2000000);
+
+    TEST_ASSERT_EQUAL_UINT32(take.size(), copy.size());
+    TEST_ASSERT_EQUAL_UINT32(take.loopMs(), copy.loopMs());
+    TEST_ASSERT_EQUAL_MEMORY(take.bytes(), copy.bytes(), take.size());
+    // 2 bytes per event, plus one more varint byte for each of the 3 gaps of 16 ms or more
+    TEST_ASSERT_EQUAL_UINT32(2 * PHRASE_LENGTH + 3, take.size());
+}
+
+void test_loop_repeats_with_the_loop_length() {
+    const uint32_t endUs = START_US + 2000000;
+    recordPhrase(endUs);
+    KeyEvent out[4];
+    uint8_t played = 0;
+    for (uint32_t t = endUs; t < endUs + 3 * 2000000; t += 5000) {
+        uint8_t count = take.poll(t, out, 4);
+        for (uint8_t i = 0; i < count; i++, played++) {
+            const KeyEvent& expected = PHRASE[played % PHRASE_LENGTH];
+            uint32_t pass = played / PHRASE_LENGTH;
+            assertSameEvent(expected, out[i]);
+            TEST_ASSERT_EQUAL_UINT32(endUs + pass * 2000000 + (expected.time - START_US) / 1000 * 1000,
+                                     out[i].time);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(3 * PHRASE_LENGTH, played);
+}
+
+void test_stopping_mid_take_releases_held_notes() {
+    take.record(0);
+    for (uint8_t note = 0; note < 20; note++) {
+        TEST_ASSERT_TRUE(take.capture(keyEvent(1000 + note, note, true)));
+    }
+    take.play(100000);  // Closing the take appends the 20 releases
+    KeyEvent out[8];
+    uint8_t pressed = 0;
+    for (uint32_t t = 100000; t < 150000; t += 2000) {
+        pressed += take.poll(t, out, 8);
+    }
+    TEST_ASSERT_EQUAL_UINT8(20, pressed);
+
+    // Stopping while all 20 are held: the releases that do not fit come from poll()
+    uint8_t released = take.stop(150000, out, 8);
+    TEST_ASSERT_EQUAL_UINT8(8, released);
+    TEST_ASSERT_EQUAL(Recorder::IDLE, take.state());
+    for (uint8_t i = 0; i < released; i++) {
+        TEST_ASSERT_EQUAL_UINT8(0, out[i].pressed);
+    }
+    take.record(152000);  // Starting a new take must not lose them
+    for (uint8_t i = 0; i < 5; i++) {
+        released += take.poll(152000 + i * 2000, out, 8);
+    }
+    TEST_ASSERT_EQUAL_UINT8(20, released);
+}
+
+void test_overdub_merges_into_the_next_pass() {
+    const uint32_t endUs = START_US + 2000000;
+    recordPhrase(endUs);
+    KeyEvent out[4];
+    for (uint32_t t = endUs; t <= endUs + 1000000; t += 1000) {
+        take.poll(t, out, 4);
+    }
+    take.overdub();
+    TEST_ASSERT_EQUAL(Recorder::OVERDUBBING, take.state());
+    TEST_ASSERT_TRUE(take.capture(keyEvent(endUs + 1000000, 64, true)));
+    TEST_ASSERT_TRUE(take.capture(keyEvent(endUs + 1200000, 64, false)));
+    take.play(0);  // Back to plain playback
+    TEST_ASSERT_EQUAL(Recorder::PLAYING, take.state());
+
+    // Second pass: the phrase plus the overdubbed note at 1.0 s and 1.2 s
+    uint8_t played = 0;
+    bool sawPress = false;
+    bool sawRelease = false;
+    for (uint32_t t = endUs + 1001000; t < endUs + 4000000; t += 1000) {
+        uint8_t count = take.poll(t, out, 4);
+        for (uint8_t i = 0; i < count; i++) {
+            if (out[i].octave * 12 + out[i].key == 64) {
+                uint32_t offset = out[i].time - (endUs + 2000000);
+                TEST_ASSERT_EQUAL_UINT32(out[i].pressed ? 1000000 : 1200000, offset);
+                sawPress |= out[i].pressed;
+                sawRelease |= !out[i].pressed;
+            } else {
+                played++;
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(sawPress);
+    TEST_ASSERT_TRUE(sawRelease);
+    TEST_ASSERT_EQUAL_UINT8(PHRASE_LENGTH + 1, played);  // Rest of pass 1 and all of pass 2
+}
+
+void test_full_buffer_keeps_room_for_releases() {
+    take.record(0);
+    uint32_t time = 0;
+    for (uint8_t note = 0; note < 20; note++) {
+        TEST_ASSERT_TRUE(take.capture(keyEvent(time += 20000, note, true)));
+    }
+    // Repeat one note until a press no longer fits, 3 bytes per event
+    uint32_t stored = 0;
+    while (take.capture(keyEvent(time += 20000, 60, (stored & 1) == 0))) {
+        stored++;
+    }
+    TEST_ASSERT_TRUE(take.overflowed());
+    TEST_ASSERT_EQUAL_UINT32(0, stored & 1);  // Only a press is refused
+    TEST_ASSERT_GREATER_THAN(1000, stored);
+
+    // The 20 held notes can still be released
+    for (uint8_t note = 0; note < 20; note++) {
+        TEST_ASSERT_TRUE(take.capture(keyEvent(time += 20000, note, false)));
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(RECORDER_BYTES, take.size());
+    take.play(time + 1000);
+    TEST_ASSERT_EQUAL(Recorder::PLAYING, take.state());
+
+    uint8_t held[108] = {};
+    uint32_t played = 0;
+    KeyEvent out[8];
+    for (uint32_t t = time + 1000; t <= 2 * (time + 1000); t += 50000) {
+        uint8_t count = take.poll(t, out, 8);
+        for (uint8_t i = 0; i < count; i++, played++) {
+            held[out[i].octave * 12 + out[i].key] = out[i].pressed;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(40 + stored, played);
+    for (uint8_t note = 0; note < 108; note++) {
+        TEST_ASSERT_EQUAL_UINT8(0, held[note]);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_event_encoding_round_trips);
+    RUN_TEST(test_playback_reproduces_the_take);
+    RUN_TEST(test_recording_the_playback_is_bit_exact);
+    RUN_TEST(test_loop_repeats_with_the_loop_length);
+    RUN_TEST(test_stopping_mid_take_releases_held_notes);
+    RUN_TEST(test_overdub_merges_into_the_next_pass);
+    RUN_TEST(test_full_buffer_keeps_room_for_releases);
+    return UNITY_END();
+}
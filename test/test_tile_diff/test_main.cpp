@@ -0,0 +1,139 @@
+#include <unity.h>
+#include "tile_diff.hpp"
+#include <cstdio>
+#include <cstring>
+
+// 128x32 frame in the U8g2 full-buffer layout: one byte is 8 vertical pixels
+static uint8_t frame[DISPLAY_TILES_X * DISPLAY_TILES_Y * 8];
+static TileDiff tileDiff;
+static TileRun runs[TileDiff::MAX_RUNS];
+
+static void fillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, bool on) {
+    for (uint8_t i = x; i < x + w; i++) {
+        for (uint8_t j = y; j < y + h; j++) {
+            uint8_t& byte = frame[(j / 8) * 128 + i];
+            byte = on ? byte | (1 << (j & 7)) : byte & ~(1 << (j & 7));
+        }
+    }
+}
+
+// Stand-in for a line of text: a different dot pattern for every value
+static void drawText(uint8_t x, uint8_t y, uint8_t w, uint32_t value) {
+    fillRect(x, y, w, 8, false);
+    for (uint8_t i = 0; i < w; i++) {
+        if ((value * 2654435761u >> (i % 32)) & 1) {
+            fillRect(x + i, y + 1 + i % 6, 1, 2, true);
+        }
+    }
+}
+
+// Bytes on the bus for the next frame, after one complete frame has been sent
+static uint32_t sendBytes() {
+    uint8_t count = tileDiff.diff(frame, runs);
+    return TileDiff::transferBytes(runs, count);
+}
+
+// The status screen from display.cpp: title, key bitmap, parameter with meter, notes, CAN state
+static void drawStatus(uint16_t keys, uint8_t volume) {
+    drawText(2, 2, 30, 1);
+    drawText(2, 12, 56, keys);
+    drawText(2, 22, 30, 100 + volume);
+    fillRect(46, 24, 12, 6, false);
+    fillRect(46, 24, 12, 1, true);
+    fillRect(46, 29, 12, 1, true);
+    fillRect(47, 25, volume * 10 / 8, 4, true);
+    drawText(60, 22, 68, keys + 7);
+    drawText(70, 2, 40, 2);
+    drawText(70, 12, 40, 3);
+}
+
+void setUp() {
+    memset(frame, 0, sizeof(frame));
+    tileDiff.invalidate();
+}
+
+void tearDown() {}
+
+void test_first_frame_is_sent_in_full() {
+    uint8_t count = tileDiff.diff(frame, runs);
+    TEST_ASSERT_EQUAL_UINT8(DISPLAY_TILES_Y, count);
+    for (uint8_t y = 0; y < DISPLAY_TILES_Y; y++) {
+        TEST_ASSERT_EQUAL_UINT8(0, runs[y].x);
+        TEST_ASSERT_EQUAL_UINT8(y, runs[y].y);
+        TEST_ASSERT_EQUAL_UINT8(DISPLAY_TILES_X, runs[y].width);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4 * (TileDiff::RUN_OVERHEAD + 128), TileDiff::transferBytes(runs, count));
+}
+
+void test_unchanged_frame_sends_nothing() {
+    drawStatus(0x000, 8);
+    sendBytes();
+    drawStatus(0x000, 8);  // Redrawn, but the same pixels
+    TEST_ASSERT_EQUAL_UINT32(0, sendBytes());
+}
+
+void test_adjacent_changed_tiles_form_one_run() {
+    sendBytes();
+    fillRect(20, 9, 20, 3, true);  // Tiles 2-4 of row 1
+    fillRect(100, 0, 1, 1, true);  // Tile 12 of row 0
+    uint8_t count = tileDiff.diff(frame, runs);
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+    TEST_ASSERT_EQUAL_UINT8(12, runs[0].x);
+    TEST_ASSERT_EQUAL_UINT8(0, runs[0].y);
+    TEST_ASSERT_EQUAL_UINT8(1, runs[0].width);
+    TEST_ASSERT_EQUAL_UINT8(2, runs[1].x);
+    TEST_ASSERT_EQUAL_UINT8(1, runs[1].y);
+    TEST_ASSERT_EQUAL_UINT8(3, runs[1].width);
+}
+
+void test_worst_case_fits_max_runs() {
+    sendBytes();
+    for (uint8_t x = 0; x < 128; x += 16) {
+        for (uint8_t y = 0; y < 32; y += 8) {
+            fillRect(x, y, 1, 1, true);  // Every other tile
+        }
+    }
+    uint8_t count = tileDiff.diff(frame, runs);
+    TEST_ASSERT_EQUAL_UINT8(TileDiff::MAX_RUNS, count);
+}
+
+// Bytes per frame for the usual changes on the status screen
+void test_typical_status_frames_send_a_fraction_of_the_screen() {
+    const uint32_t fullFrame = 4 * (TileDiff::RUN_OVERHEAD + 128);
+    drawStatus(0x000, 8);
+    TEST_ASSERT_EQUAL_UINT32(fullFrame, sendBytes());
+
+    // One key: the key bitmap and the note list change
+    drawStatus(0x001, 8);
+    uint32_t keyBytes = sendBytes();
+    // A chord: the same areas
+    drawStatus(0x091, 8);
+    uint32_t chordBytes = sendBytes();
+    // A volume step: the parameter text and the meter
+    drawStatus(0x091, 7);
+    uint32_t volumeBytes = sendBytes();
+    // Nothing changed
+    drawStatus(0x091, 7);
+    uint32_t idleBytes = sendBytes();
+
+    char message[96];
+    snprintf(message, sizeof(message), "bytes per frame: full %u, key %u, chord %u, volume %u, idle %u",
+             (unsigned)fullFrame, (unsigned)keyBytes, (unsigned)chordBytes, (unsigned)volumeBytes,
+             (unsigned)idleBytes);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_OR_EQUAL(fullFrame / 2, keyBytes);
+    TEST_ASSERT_LESS_OR_EQUAL(fullFrame / 2, chordBytes);
+    TEST_ASSERT_LESS_OR_EQUAL(fullFrame / 4, volumeBytes);
+    TEST_ASSERT_EQUAL_UINT32(0, idleBytes);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_is_sent_in_full);
+    RUN_TEST(test_unchanged_frame_sends_nothing);
+    RUN_TEST(test_adjacent_changed_tiles_form_one_run);
+    RUN_TEST(test_worst_case_fits_max_runs);
+    RUN_TEST(test_typical_status_frames_send_a_fraction_of_the_screen);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <unity.h>
+#include "can_protocol.hpp"
+#include "voice_alloc.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+// A stack where every module keeps its own allocator, as on the hardware. Assignments
+// travel in the CAN wire format and reach every module, the sender included.
+static const uint8_t STACK = 4;
+static VoiceAllocator views[STACK];
+static uint8_t rendering[STACK];
+
+static void resetStack() {
+    for (uint8_t module = 0; module < STACK; module++) {
+        views[module].reset();
+        rendering[module] = 0;
+    }
+}
+
+static uint8_t press(uint8_t origin, uint8_t note) {
+    VoiceAssignment assign = {origin, views[origin].choose(origin, STACK), note};
+    uint8_t data[8];
+    encodeVoiceAssignment(assign, data);
+    for (uint8_t module = 0; module < STACK; module++) {
+        VoiceAssignment received;
+        TEST_ASSERT_TRUE(decodeVoiceAssignment(data, received));
+        views[module].assigned(received.target);
+    }
+    rendering[assign.target]++;
+    return assign.target;
+}
+
+// Every module sends its key state, carrying its load
+static void reportAll() {
+    for (uint8_t module = 0; module < STACK; module++) {
+        uint8_t data[8];
+        encodeKeyState({module, 4, 0, rendering[module], 0, 0}, data);
+        KeyStateFrame frame;
+        TEST_ASSERT_TRUE(decodeKeyState(data, frame));
+        for (uint8_t view = 0; view < STACK; view++) {
+            views[view].report(frame.module, frame.load);
+        }
+    }
+}
+
+static void assertViewsAgree() {
+    for (uint8_t view = 0; view < STACK; view++) {
+        for (uint8_t module = 0; module < STACK; module++) {
+            TEST_ASSERT_EQUAL_UINT8(rendering[module], views[view].load(module));
+        }
+    }
+}
+
+void test_assignment_round_trips() {
+    uint8_t data[8];
+    encodeVoiceAssignment({15, 7, 107}, data);
+    const uint8_t expected[8] = {0x13, 0xF7, 107, 0, 0, 0, 0, 0};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data, 8);
+    VoiceAssignment assign;
+    TEST_ASSERT_TRUE(decodeVoiceAssignment(data, assign));
+    TEST_ASSERT_EQUAL_UINT8(15, assign.origin);
+    TEST_ASSERT_EQUAL_UINT8(7, assign.target);
+    TEST_ASSERT_EQUAL_UINT8(107, assign.note);
+
+    encodeKeyState({0, 4, 0, 0, 0, 0}, data);
+    TEST_ASSERT_FALSE(decodeVoiceAssignment(data, assign));
+}
+
+void test_ties_go_to_the_origin_then_east() {
+    VoiceAllocator alloc;
+    TEST_ASSERT_EQUAL_UINT8(2, alloc.choose(2, 4));
+    alloc.report(2, 1);
+    TEST_ASSERT_EQUAL_UINT8(3, alloc.choose(2, 4));
+    alloc.report(3, 1);
+    TEST_ASSERT_EQUAL_UINT8(0, alloc.choose(2, 4));  // Wraps round to position 0
+    alloc.report(0, 1);
+    TEST_ASSERT_EQUAL_UINT8(1, alloc.choose(2, 4));
+    alloc.report(1, 1);
+    TEST_ASSERT_EQUAL_UINT8(2, alloc.choose(2, 4));
+}
+
+void test_lowest_load_wins() {
+    VoiceAllocator alloc;
+    const uint8_t loads[5] = {3, 5, 2, 4, 2};
+    for (uint8_t module = 0; module < 5; module++) {
+        alloc.report(module, loads[module]);
+    }
+    TEST_ASSERT_EQUAL_UINT8(2, alloc.choose(0, 5));
+    TEST_ASSERT_EQUAL_UINT8(4, alloc.choose(3, 5));
+    TEST_ASSERT_EQUAL_UINT8(2, alloc.choose(2, 5));
+    // Modules east of the stack do not count
+    TEST_ASSERT_EQUAL_UINT8(2, alloc.choose(0, 3));
+}
+
+void test_outside_the_stack_the_origin_renders() {
+    VoiceAllocator alloc;
+    alloc.report(5, 9);
+    TEST_ASSERT_EQUAL_UINT8(5, alloc.choose(5, 4));
+    TEST_ASSERT_EQUAL_UINT8(0, alloc.choose(0, 0));
+    TEST_ASSERT_EQUAL_UINT8(0xFF, alloc.load(VoiceAllocator::MODULES));
+}
+
+void test_estimate_saturates_and_report_replaces_it() {
+    VoiceAllocator alloc;
+    for (int i = 0; i < 300; i++) {
+        alloc.assigned(2);
+    }
+    TEST_ASSERT_EQUAL_UINT8(255, alloc.load(2));
+    alloc.report(2, 3);
+    TEST_ASSERT_EQUAL_UINT8(3, alloc.load(2));
+    alloc.assigned(VoiceAllocator::MODULES);  // Ignored
+    alloc.reset();
+    TEST_ASSERT_EQUAL_UINT8(0, alloc.load(2));
+}
+
+void test_chord_spreads_before_any_report() {
+    resetStack();
+    const uint8_t expected[STACK] = {1, 2, 3, 0};
+    for (uint8_t i = 0; i < STACK; i++) {
+        TEST_ASSERT_EQUAL_UINT8(expected[i], press(1, 60 + i));
+    }
+    assertViewsAgree();
+}
+
+void test_views_agree_across_origins_and_reports() {
+    resetStack();
+    for (uint8_t i = 0; i < 4; i++) {
+        press(1, 60 + i);
+    }
+    reportAll();
+    TEST_ASSERT_EQUAL_UINT8(3, press(3, 70));  // All equal: the origin renders
+    reportAll();
+    TEST_ASSERT_EQUAL_UINT8(0, press(3, 71));  // Module 3 is busier: east, wrapping round
+    press(0, 72);
+    press(2, 73);
+    assertViewsAgree();
+    reportAll();
+    assertViewsAgree();
+}
+
+void test_polyphony_scales_with_the_stack() {
+    resetStack();
+    for (uint8_t i = 0; i < 4 * STACK; i++) {
+        press(i % STACK, 48 + i);
+        if (i % 3 == 2) {
+            reportAll();
+        }
+    }
+    for (uint8_t module = 0; module < STACK; module++) {
+        TEST_ASSERT_EQUAL_UINT8(4, rendering[module]);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_assignment_round_trips);
+    RUN_TEST(test_ties_go_to_the_origin_then_east);
+    RUN_TEST(test_lowest_load_wins);
+    RUN_TEST(test_outside_the_stack_the_origin_renders);
+    RUN_TEST(test_estimate_saturates_and_report_replaces_it);
+    RUN_TEST(test_chord_spreads_before_any_report);
+    RUN_TEST(test_views_agree_across_origins_and_reports);
+    RUN_TEST(test_polyphony_scales_with_the_stack);
+    return UNITY_END();
+}
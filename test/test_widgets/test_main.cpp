@@ -0,0 +1,251 @@
+#include <unity.h>
+#include "widgets.hpp"
+#include <cstdio>
+#include <cstring>
+
+// Golden images: '#' is a lit pixel, '.' a dark one. They were drawn with the host font
+// from lib/u8g2_host and checked by eye; the target's fonts differ, the layout does not.
+static u8g2_t u8g2;
+
+void setUp() { u8g2_SetupHost(&u8g2); }
+void tearDown() {}
+
+static bool pixel(uint8_t x, uint8_t y) {
+    return (u8g2_GetBufferPtr(&u8g2)[(y / 8) * U8G2_HOST_WIDTH + x] >> (y & 7)) & 1;
+}
+
+// Compare the frame inside `area` with `rows`, one string per pixel row
+static void assertImage(Rect area, const char* const* rows) {
+    char actual[U8G2_HOST_WIDTH + 1];
+    char message[16];
+    for (uint8_t y = 0; y < area.h; y++) {
+        for (uint8_t x = 0; x < area.w; x++) {
+            actual[x] = pixel(area.x + x, area.y + y) ? '#' : '.';
+        }
+        actual[area.w] = '\0';
+        snprintf(message, sizeof(message), "row %u", y);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(rows[y], actual, message);
+    }
+}
+
+void test_label_golden() {
+    Label label({2, 2, 40, 7}, u8g2_font_host_3x5, "Vol: 8");
+    TEST_ASSERT_TRUE(label.render(&u8g2));
+    static const char* const GOLDEN[] = {
+        "............................................",
+        "............................................",
+        "..#.#..#..#...........###...................",
+        "..#.#.#.#.#....#......#.#...................",
+        "..#.#.#.#.#...........###...................",
+        "..#.#.#.#.#....#......#.#...................",
+        "...#...#..###.........###...................",
+        "............................................",
+        "............................................",
+    };
+    assertImage({0, 0, 44, 9}, GOLDEN);
+}
+
+void test_label_is_clipped_to_its_rectangle() {
+    Label label({0, 0, 20, 7}, u8g2_font_host_3x5, "CLIPPED");
+    label.render(&u8g2);
+    static const char* const GOLDEN[] = {
+        ".##.#...###.##..##............",
+        "#...#....#..#.#.#.#...........",
+        "#...#....#..##..##............",
+        "#...#....#..#...#.............",
+        ".##.###.###.#...#.............",
+        "..............................",
+        "..............................",
+    };
+    assertImage({0, 0, 30, 7}, GOLDEN);
+}
+
+void test_new_text_erases_the_old() {
+    Label label({0, 0, 16, 5}, u8g2_font_host_3x5, "888");
+    label.render(&u8g2);
+    label.setText("1");
+    TEST_ASSERT_TRUE(label.render(&u8g2));
+    static const char* const GOLDEN[] = {
+        ".#..............",
+        "##..............",
+        ".#..............",
+        ".#..............",
+        "###.............",
+    };
+    assertImage({0, 0, 16, 5}, GOLDEN);
+}
+
+void test_meter_golden() {
+    Meter meter({1, 1, 12, 6});
+    meter.setValue(5, 10);
+    meter.render(&u8g2);
+    static const char* const GOLDEN[] = {
+        "..............",
+        ".############.",
+        ".######.....#.",
+        ".######.....#.",
+        ".######.....#.",
+        ".######.....#.",
+        ".############.",
+        "..............",
+    };
+    assertImage({0, 0, 14, 8}, GOLDEN);
+}
+
+void test_note_list_golden() {
+    NoteList notes({0, 0, 40, 6}, u8g2_font_host_3x5);
+    notes.render(&u8g2);
+    static const char* const EMPTY[] = {
+        "##...#......##...#..###.###.............",
+        "#.#.#.#.....#.#.#.#..#..#...............",
+        "#.#.#.#.....#.#.#.#..#..##..............",
+        "#.#.#.#.....#.#.#.#..#..#...............",
+        "#.#..#......#.#..#...#..###.............",
+        "........................................",
+    };
+    assertImage({0, 0, 40, 6}, EMPTY);
+
+    notes.setKeys(0x092);  // C#, E, G
+    notes.render(&u8g2);
+    static const char* const CHORD[] = {
+        ".##.#.#....###.....##...................",
+        "#...###....#......#.....................",
+        "#...#.#....##.....#.#...................",
+        "#...###....#......#.#...................",
+        ".##.#.#....###.....##...................",
+        "........................................",
+    };
+    assertImage({0, 0, 40, 6}, CHORD);
+}
+
+static const char* const VIEWS[] = {"Status", "Scope", "Spectrum", "CAN"};
+
+void test_menu_golden() {
+    Menu menu({0, 0, 36, 21}, u8g2_font_host_3x5, 7);
+    menu.setItems(VIEWS, 4);
+    menu.render(&u8g2);
+    static const char* const TOP[] = {
+        "####################################",
+        "##..#...##.##...#.#.##..############",
+        "#.####.##.#.##.##.#.#.##############",
+        "##.###.##...##.##.#.##.#############",
+        "###.##.##.#.##.##.#.###.############",
+        "#..###.##.#.##.##...#..#############",
+        "####################################",
+        "....................................",
+        "..##..##..#..##..###................",
+        ".#...#...#.#.#.#.#..................",
+        "..#..#...#.#.##..##.................",
+        "...#.#...#.#.#...#..................",
+        ".##...##..#..#...###................",
+        "....................................",
+        "....................................",
+        "..##.##..###..##.###.##..#.#.#.#....",
+        ".#...#.#.#...#....#..#.#.#.#.###....",
+        "..#..##..##..#....#..##..#.#.###....",
+        "...#.#...#...#....#..#.#.#.#.#.#....",
+        ".##..#...###..##..#..#.#.###.#.#....",
+        "....................................",
+    };
+    assertImage({0, 0, 36, 21}, TOP);
+
+    // Three rows fit: selecting the fourth item scrolls by one
+    menu.move(3);
+    TEST_ASSERT_EQUAL_UINT8(3, menu.selected());
+    TEST_ASSERT_TRUE(menu.render(&u8g2));
+    static const char* const SCROLLED[] = {
+        "....................................",
+        "..##..##..#..##..###................",
+        ".#...#...#.#.#.#.#..................",
+        "..#..#...#.#.##..##.................",
+        "...#.#...#.#.#...#..................",
+        ".##...##..#..#...###................",
+        "....................................",
+        "....................................",
+        "..##.##..###..##.###.##..#.#.#.#....",
+        ".#...#.#.#...#....#..#.#.#.#.###....",
+        "..#..##..##..#....#..##..#.#.###....",
+        "...#.#...#...#....#..#.#.#.#.#.#....",
+        ".##..#...###..##..#..#.#.###.#.#....",
+        "....................................",
+        "####################################",
+        "##..##.##..#########################",
+        "#.###.#.#.#.########################",
+        "#.###...#.#.########################",
+        "#.###.#.#.#.########################",
+        "##..#.#.#.#.########################",
+        "####################################",
+    };
+    assertImage({0, 0, 36, 21}, SCROLLED);
+}
+
+void test_menu_selection_is_clamped_and_only_redrawn_on_change() {
+    Menu menu({0, 0, 36, 14}, u8g2_font_host_3x5, 7);
+    menu.setItems(VIEWS, 4);
+    menu.render(&u8g2);
+    menu.move(-1);
+    TEST_ASSERT_EQUAL_UINT8(0, menu.selected());
+    TEST_ASSERT_FALSE(menu.render(&u8g2));
+    menu.select(100);
+    TEST_ASSERT_EQUAL_UINT8(3, menu.selected());
+    TEST_ASSERT_TRUE(menu.render(&u8g2));
+    menu.move(-1);  // Still in view: no scrolling, but the highlight moves
+    TEST_ASSERT_EQUAL_UINT8(2, menu.selected());
+    TEST_ASSERT_TRUE(menu.render(&u8g2));
+    menu.setItems(VIEWS, 2);  // New items start at the top
+    TEST_ASSERT_EQUAL_UINT8(0, menu.selected());
+    TEST_ASSERT_TRUE(menu.render(&u8g2));
+}
+
+void test_only_dirty_widgets_are_redrawn() {
+    Label label({0, 0, 40, 7}, u8g2_font_host_3x5, "Keys:");
+    Meter meter({0, 8, 20, 6});
+    NoteList notes({0, 16, 60, 7}, u8g2_font_host_3x5);
+    Screen screen;
+    screen.add(label);
+    screen.add(meter);
+    screen.add(notes);
+    TEST_ASSERT_EQUAL_UINT8(3, screen.render(&u8g2));
+    TEST_ASSERT_EQUAL_UINT8(0, screen.render(&u8g2));
+
+    label.setText("Keys:");   // Same text
+    meter.setValue(20, 10);   // Clamped to full
+    meter.setValue(30, 10);   // Still full
+    TEST_ASSERT_EQUAL_UINT8(1, screen.render(&u8g2));
+    notes.setKeys(0xF001);    // Only the 12 key bits count
+    notes.setKeys(0x0001);
+    TEST_ASSERT_EQUAL_UINT8(1, screen.render(&u8g2));
+
+    screen.invalidate();
+    TEST_ASSERT_EQUAL_UINT8(3, screen.render(&u8g2));
+}
+
+void test_rendering_leaves_the_rest_of_the_frame_alone() {
+    memset(u8g2_GetBufferPtr(&u8g2), 0xFF, U8G2_HOST_WIDTH * U8G2_HOST_HEIGHT / 8);
+    Rect area = {30, 5, 40, 12};
+    Label label(area, u8g2_font_host_3x5, "A long line of text");
+    label.render(&u8g2);
+    for (uint8_t y = 0; y < U8G2_HOST_HEIGHT; y++) {
+        for (uint8_t x = 0; x < U8G2_HOST_WIDTH; x++) {
+            bool inside = x >= area.x && x < area.x + area.w && y >= area.y && y < area.y + area.h;
+            if (!inside) {
+                TEST_ASSERT_TRUE(pixel(x, y));
+            }
+        }
+    }
+    TEST_ASSERT_FALSE(pixel(area.x, area.y + 6));  // Erased below the text
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_label_golden);
+    RUN_TEST(test_label_is_clipped_to_its_rectangle);
+    RUN_TEST(test_new_text_erases_the_old);
+    RUN_TEST(test_meter_golden);
+    RUN_TEST(test_note_list_golden);
+    RUN_TEST(test_menu_golden);
+    RUN_TEST(test_menu_selection_is_clamped_and_only_redrawn_on_change);
+    RUN_TEST(test_only_dirty_widgets_are_redrawn);
+    RUN_TEST(test_rendering_leaves_the_rest_of_the_frame_alone);
+    return UNITY_END();
+}
@@ -0,0 +1,69 @@
+// Turns the '@' lines printed by traceDrainTask into a readable timeline.
+//
+//   g++ -std=c++14 -Isrc tools/trace_decode.cpp -o trace_decode
+//   ./trace_decode [cpu_mhz] < capture.txt
+//
+// Other serial output in the capture is ignored. Each record is printed with its time
+// since the first record; an END record also shows the time since its BEGIN.
+
+#include "trace.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    double cpuMhz = argc > 1 ? atof(argv[1]) : 80.0;
+
+    char line[256];
+    bool first = true;
+    uint32_t lastCycles = 0;
+    uint64_t now = 0;                               // Unwrapped cycle count
+    uint64_t begin[TRACE_EVENT_COUNT / 2] = {};     // Last BEGIN of each span
+    bool open[TRACE_EVENT_COUNT / 2] = {};
+    uint32_t expectedSeq = 0;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        unsigned long seq, cycles;
+        unsigned event, arg;
+        if (sscanf(line, TRACE_LINE_FORMAT, &seq, &cycles, &event, &arg) != 4) {
+            continue;
+        }
+        if (first) {
+            lastCycles = cycles;
+            first = false;
+        } else if (event != TRACE_LOST && seq != expectedSeq) {
+            printf("            -- %lu records missing from the capture --\n", seq - expectedSeq);
+        }
+        expectedSeq = seq + 1;
+
+        // The counter wraps every 2^32 cycles; records arrive in order, so take the short way
+        now += (int32_t)((uint32_t)cycles - lastCycles);
+        lastCycles = cycles;
+        double us = now / cpuMhz;
+
+        if (event >= TRACE_EVENT_COUNT) {
+            printf("%12.2f us  unknown event %u  arg=%u\n", us, event, arg);
+            continue;
+        }
+        if (event == TRACE_LOST) {
+            printf("%12.2f us  -- %u records overwritten before they were printed --\n", us, arg);
+            for (bool& o : open) o = false;
+            continue;
+        }
+
+        const char* name = TRACE_EVENT_NAMES[event];
+        if (event < TRACE_CAN_RX_ISR_BEGIN) {
+            printf("%12.2f us  %-12s arg=%u\n", us, name, arg);
+        } else if ((event & 1) == 0) {
+            begin[event / 2] = now;
+            open[event / 2] = true;
+            printf("%12.2f us  %-12s begin  arg=%u\n", us, name, arg);
+        } else if (open[event / 2]) {
+            open[event / 2] = false;
+            printf("%12.2f us  %-12s end    arg=%u  took %.2f us\n", us, name, arg,
+                   (now - begin[event / 2]) / cpuMhz);
+        } else {
+            printf("%12.2f us  %-12s end    arg=%u\n", us, name, arg);
+        }
+    }
+    return 0;
+}